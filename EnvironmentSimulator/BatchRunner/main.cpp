@@ -0,0 +1,381 @@
+/*
+ * esmini - Environment Simulator Minimalistic
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application runs a batch of scenarios headless, decoupled from realtime, using a pool of
+  * worker threads. Each run is performed by a separate ScenarioEngine instance. Road networks are
+  * loaded once and shared, read-only, by all runs referring to the same OpenDRIVE file.
+  *
+  * The batch file lists one run per line: the OpenSCENARIO filename optionally followed by
+  * global parameter values to override, e.g.:
+  *   ../resources/xosc/cut-in.xosc $HostVehicle=car_blue $EgoStartS=30
+  * Empty lines and lines starting with '#' are ignored.
+  *
+  * Outcome and timing of each run is written to a summary file in CSV format.
+  */
+
+#include <fstream>
+#include <sstream>
+#include <map>
+
+#include "ScenarioEngine.hpp"
+#include "RoadManager.hpp"
+#include "CommonMini.hpp"
+
+using namespace scenarioengine;
+
+#define DEFAULT_TIMESTEP 0.05
+#define DEFAULT_MAX_TIME 300.0
+#define DEFAULT_SUMMARY_FILENAME "batch_summary.csv"
+
+typedef enum
+{
+	RUN_NOT_STARTED,
+	RUN_COMPLETED,  // scenario ended by itself
+	RUN_TIMEOUT,    // max simulation time reached
+	RUN_ERROR       // failed to load or initialize
+} RunOutcome;
+
+typedef struct
+{
+	std::string filename;
+	std::vector<std::pair<std::string, std::string>> parameters;
+	RunOutcome outcome;
+	double sim_time;
+	int n_steps;
+	__int64 wall_time;  // ms
+} BatchRun;
+
+typedef struct
+{
+	std::vector<BatchRun> *runs;
+	size_t next_run;
+	SE_Mutex mutex;
+	double timestep;
+	double max_time;
+	bool event_driven;
+	std::map<std::string, roadmanager::OpenDrive*> odr_cache;  // loaded road networks by filename
+	SE_Mutex odr_mutex;
+} BatchQueue;
+
+static const char *OutcomeToStr(RunOutcome outcome)
+{
+	switch (outcome)
+	{
+	case RUN_COMPLETED: return "completed";
+	case RUN_TIMEOUT: return "timeout";
+	case RUN_ERROR: return "error";
+	default: return "not_started";
+	}
+}
+
+static int ReadBatchFile(std::string filename, std::vector<BatchRun> &runs)
+{
+	std::ifstream file(filename);
+	std::string line;
+
+	if (!file.is_open())
+	{
+		LOG("Failed to open batch file %s", filename.c_str());
+		return -1;
+	}
+
+	while (std::getline(file, line))
+	{
+		std::istringstream iss(line);
+		std::string token;
+		BatchRun run;
+
+		if (!(iss >> run.filename) || run.filename[0] == '#')
+		{
+			continue;
+		}
+
+		while (iss >> token)
+		{
+			size_t pos = token.find('=');
+			if (pos == std::string::npos || pos == 0)
+			{
+				LOG("Invalid parameter assignment \"%s\" for %s - expected name=value", token.c_str(), run.filename.c_str());
+				return -1;
+			}
+			run.parameters.push_back(std::make_pair(token.substr(0, pos), token.substr(pos + 1)));
+		}
+
+		run.outcome = RUN_NOT_STARTED;
+		run.sim_time = 0.0;
+		run.n_steps = 0;
+		run.wall_time = 0;
+		runs.push_back(run);
+	}
+
+	return 0;
+}
+
+static roadmanager::OpenDrive *GetSharedOpenDrive(BatchQueue *queue, std::string scenario_filename)
+{
+	pugi::xml_document doc;
+
+	if (!doc.load_file(scenario_filename.c_str()))
+	{
+		return 0;
+	}
+
+	std::string odr_filename = doc.child("OpenSCENARIO").child("RoadNetwork").child("LogicFile").attribute("filepath").value();
+	if (odr_filename == "" || odr_filename[0] == '$')
+	{
+		// No road network or parameterized filename, leave to the scenario engine to resolve
+		return 0;
+	}
+	odr_filename = CombineDirectoryPathAndFilepath(DirNameOf(scenario_filename), odr_filename);
+
+	queue->odr_mutex.Lock();
+
+	roadmanager::OpenDrive *odr = 0;
+	std::map<std::string, roadmanager::OpenDrive*>::iterator it = queue->odr_cache.find(odr_filename);
+	if (it != queue->odr_cache.end())
+	{
+		odr = it->second;
+	}
+	else
+	{
+		odr = new roadmanager::OpenDrive;
+		if (!odr->LoadOpenDriveFile(odr_filename.c_str()))
+		{
+			delete odr;
+			odr = 0;
+		}
+		queue->odr_cache[odr_filename] = odr;
+	}
+
+	queue->odr_mutex.Unlock();
+
+	return odr;
+}
+
+static void ExecuteRun(BatchQueue *queue, BatchRun &run)
+{
+	ScenarioEngine *scenarioEngine = new ScenarioEngine();
+	__int64 start_time = SE_getSystemTime();
+
+	try
+	{
+		scenarioEngine->SetOpenDrive(GetSharedOpenDrive(queue, run.filename));
+		scenarioEngine->SetEventDriven(queue->event_driven);
+		for (size_t i = 0; i < run.parameters.size(); i++)
+		{
+			scenarioEngine->SetParameterValue(run.parameters[i].first, run.parameters[i].second);
+		}
+		scenarioEngine->InitScenario(run.filename, DEFAULT_HEADSTART_TIME);
+
+		scenarioEngine->step(0.0, true);
+
+		while (!scenarioEngine->GetQuitFlag() && scenarioEngine->getSimulationTime() < queue->max_time)
+		{
+			scenarioEngine->step(queue->timestep);
+			run.n_steps++;
+		}
+
+		run.outcome = scenarioEngine->GetQuitFlag() ? RUN_COMPLETED : RUN_TIMEOUT;
+		run.sim_time = scenarioEngine->getSimulationTime();
+	}
+	catch (const std::exception& e)
+	{
+		LOG("%s: %s", run.filename.c_str(), e.what());
+		run.outcome = RUN_ERROR;
+	}
+
+	run.wall_time = SE_getSystemTime() - start_time;
+
+	delete scenarioEngine;
+}
+
+static void WorkerThread(void *args)
+{
+	BatchQueue *queue = (BatchQueue*)args;
+	roadmanager::OpenDrive odr;
+
+	// Any road network not shared will be loaded into a thread specific instance
+	roadmanager::Position::SetThreadOpenDrive(&odr);
+
+	for (;;)
+	{
+		queue->mutex.Lock();
+		size_t run_idx = queue->next_run++;
+		queue->mutex.Unlock();
+
+		if (run_idx >= queue->runs->size())
+		{
+			break;
+		}
+
+		ExecuteRun(queue, (*queue->runs)[run_idx]);
+	}
+
+	roadmanager::Position::SetThreadOpenDrive(0);
+}
+
+static int WriteSummary(std::string filename, std::vector<BatchRun> &runs)
+{
+	std::ofstream file(filename);
+
+	if (!file.is_open())
+	{
+		LOG("Failed to open summary file %s", filename.c_str());
+		return -1;
+	}
+
+	file << "run, scenario, parameters, outcome, sim_time, steps, wall_time_ms" << std::endl;
+
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		file << i << ", " << runs[i].filename << ", ";
+		for (size_t j = 0; j < runs[i].parameters.size(); j++)
+		{
+			file << (j > 0 ? " " : "") << runs[i].parameters[j].first << "=" << runs[i].parameters[j].second;
+		}
+		file << ", " << OutcomeToStr(runs[i].outcome) << ", " << runs[i].sim_time << ", " <<
+			runs[i].n_steps << ", " << runs[i].wall_time << std::endl;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	SE_Options opt;
+	std::string arg_str;
+	std::vector<BatchRun> runs;
+	BatchQueue queue;
+	int n_threads = 1;
+	std::string summary_filename = DEFAULT_SUMMARY_FILENAME;
+
+	queue.timestep = DEFAULT_TIMESTEP;
+	queue.max_time = DEFAULT_MAX_TIME;
+	queue.event_driven = false;
+	queue.next_run = 0;
+	queue.runs = &runs;
+
+	// use common options parser to manage the program arguments
+	opt.AddOption("batch", "Batch file listing scenarios and parameter values, one run per line", "filename");
+	opt.AddOption("threads", "Number of scenarios to run in parallel (default = 1)", "number");
+	opt.AddOption("timestep", "Fixed simulation timestep (default = 0.05)", "timestep");
+	opt.AddOption("max_time", "Simulation time after which a run is aborted (default = 300)", "time");
+	opt.AddOption("summary", "Outcome and timing per run (default = batch_summary.csv)", "filename");
+	opt.AddOption("odr_cache", "Folder for compiled road networks, speeding up subsequent loads", "dirname");
+	opt.AddOption("event_driven", "Evaluate only live acts and events of the story, faster for large storyboards");
+	opt.AddOption("seed", "Seed of random choices, same for all runs. Outcome is independent of number of threads (default = time)", "number");
+
+	if (argc < 2)
+	{
+		opt.PrintUsage();
+		return -1;
+	}
+
+	opt.ParseArgs(&argc, argv);
+
+	if (argc > 1)
+	{
+		opt.PrintArgs(argc, argv, "Unrecognized arguments:");
+		opt.PrintUsage();
+		return -1;
+	}
+
+	if ((arg_str = opt.GetOptionArg("batch")) == "")
+	{
+		printf("Missing batch file argument\n");
+		opt.PrintUsage();
+		return -1;
+	}
+
+	if (ReadBatchFile(arg_str, runs) != 0)
+	{
+		return -1;
+	}
+
+	if ((arg_str = opt.GetOptionArg("threads")) != "")
+	{
+		n_threads = MAX(1, atoi(arg_str.c_str()));
+	}
+
+	if ((arg_str = opt.GetOptionArg("timestep")) != "")
+	{
+		queue.timestep = atof(arg_str.c_str());
+		if (queue.timestep <= 0.0)
+		{
+			printf("Invalid timestep %s\n", arg_str.c_str());
+			return -1;
+		}
+	}
+
+	if ((arg_str = opt.GetOptionArg("max_time")) != "")
+	{
+		queue.max_time = atof(arg_str.c_str());
+	}
+
+	if ((arg_str = opt.GetOptionArg("summary")) != "")
+	{
+		summary_filename = arg_str;
+	}
+
+	if ((arg_str = opt.GetOptionArg("odr_cache")) != "")
+	{
+		roadmanager::OpenDrive::SetCacheDir(arg_str);
+	}
+
+	queue.event_driven = opt.GetOptionSet("event_driven");
+
+	if ((arg_str = opt.GetOptionArg("seed")) != "")
+	{
+		SE_Random::SetGlobalSeed((unsigned int)strtoul(arg_str.c_str(), 0, 10));
+	}
+	printf("Random seed %u\n", SE_Random::GetGlobalSeed());
+
+	n_threads = MIN(n_threads, (int)runs.size());
+	printf("Running %d scenarios on %d threads\n", (int)runs.size(), n_threads);
+
+	__int64 start_time = SE_getSystemTime();
+
+	std::vector<SE_Thread> threads(n_threads);
+	for (int i = 0; i < n_threads; i++)
+	{
+		threads[i].Start(WorkerThread, &queue);
+	}
+	for (int i = 0; i < n_threads; i++)
+	{
+		threads[i].Wait();
+	}
+
+	int n_completed = 0;
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		if (runs[i].outcome == RUN_COMPLETED)
+		{
+			n_completed++;
+		}
+	}
+
+	printf("%d of %d scenarios completed in %.2f s\n", n_completed, (int)runs.size(),
+		0.001 * (SE_getSystemTime() - start_time));
+
+	for (std::map<std::string, roadmanager::OpenDrive*>::iterator it = queue.odr_cache.begin(); it != queue.odr_cache.end(); it++)
+	{
+		delete it->second;
+	}
+
+	if (WriteSummary(summary_filename, runs) != 0)
+	{
+		return -1;
+	}
+
+	return n_completed == (int)runs.size() ? 0 : 1;
+}
@@ -13,6 +13,7 @@
 #include <stdarg.h> 
 #include <stdio.h>
 #include <iostream>
+#include <time.h>
 
 #include "CommonMini.hpp"
 
@@ -431,8 +432,8 @@ Logger::~Logger()
 
 void Logger::Log(char const* file, char const* func, int line, char const* format, ...)
 {
-	static char complete_entry[2048];
-	static char message[1024];
+	char complete_entry[2048];
+	char message[1024];
 
 	va_list args;
 	va_start(args, format);
@@ -444,6 +445,8 @@ void Logger::Log(char const* file, char const* func, int line, char const* forma
 	strncpy(complete_entry, message, 1024);
 #endif
 
+	mutex_.Lock();
+
 	if (file_.is_open())
 	{
 		file_ << complete_entry << std::endl;
@@ -455,14 +458,18 @@ void Logger::Log(char const* file, char const* func, int line, char const* forma
 		callback_(complete_entry);
 	}
 
+	mutex_.Unlock();
+
 	va_end(args);
 }
 
 void Logger::SetCallback(FuncPtr callback)
 {
-	callback_ = callback;
+	char message[1024];
 
-	static char message[1024];
+	mutex_.Lock();
+
+	callback_ = callback;
 
 	snprintf(message, 1024, "esmini GIT REV: %s", esmini_git_rev());
 	callback_(message);
@@ -472,6 +479,8 @@ void Logger::SetCallback(FuncPtr callback)
 	callback_(message);
 	snprintf(message, 1024, "esmini BUILD VERSION: %s", esmini_build_version());
 	callback_(message);
+
+	mutex_.Unlock();
 }
 
 Logger& Logger::Inst()
@@ -549,6 +558,154 @@ void SE_Mutex::Unlock()
 }
 
 
+SE_TaskPool::SE_TaskPool() : func_(0), arg_(0), n_tasks_(0), next_task_(0), batch_(0), first_batch_(0), n_workers_done_(0), quit_(false)
+{
+}
+
+SE_TaskPool::~SE_TaskPool()
+{
+	Stop();
+}
+
+void SE_TaskPool::Start(int n_workers)
+{
+	Stop();
+
+#if (defined WINVER && WINVER == _WIN32_WINNT_WIN7)
+	if (n_workers > 0)
+	{
+		LOG("Task pool not supported on this platform, running tasks in sequence");
+	}
+#else
+	quit_ = false;
+	first_batch_ = batch_;
+	for (int i = 0; i < n_workers; i++)
+	{
+		worker_.push_back(new SE_Thread);
+		worker_.back()->Start(WorkerThread, this);
+	}
+#endif
+}
+
+void SE_TaskPool::Stop()
+{
+#if (defined WINVER && WINVER == _WIN32_WINNT_WIN7)
+
+#else
+	if (worker_.size() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			quit_ = true;
+		}
+		start_cond_.notify_all();
+
+		for (size_t i = 0; i < worker_.size(); i++)
+		{
+			worker_[i]->Wait();
+			delete worker_[i];
+		}
+		worker_.clear();
+	}
+#endif
+}
+
+void SE_TaskPool::RunTasks()
+{
+	int i;
+	while ((i = next_task_++) < n_tasks_)
+	{
+		func_(i, arg_);
+	}
+}
+
+void SE_TaskPool::Run(void(*func)(int, void*), int n_tasks, void *arg)
+{
+	if (worker_.size() == 0 || n_tasks < 2)
+	{
+		for (int i = 0; i < n_tasks; i++)
+		{
+			func(i, arg);
+		}
+		return;
+	}
+
+#if (defined WINVER && WINVER == _WIN32_WINNT_WIN7)
+
+#else
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		func_ = func;
+		arg_ = arg;
+		n_tasks_ = n_tasks;
+		next_task_ = 0;
+		n_workers_done_ = 0;
+		batch_++;
+	}
+	start_cond_.notify_all();
+
+	RunTasks();
+
+	// Wait for workers to finish their last task
+	std::unique_lock<std::mutex> lock(mutex_);
+	done_cond_.wait(lock, [this] { return n_workers_done_ == (int)worker_.size(); });
+#endif
+}
+
+void SE_TaskPool::WorkerThread(void *args)
+{
+#if (defined WINVER && WINVER == _WIN32_WINNT_WIN7)
+	(void)args;
+#else
+	SE_TaskPool *pool = (SE_TaskPool*)args;
+	int batch = pool->first_batch_;
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(pool->mutex_);
+			pool->start_cond_.wait(lock, [pool, batch] { return pool->quit_ || pool->batch_ != batch; });
+			if (pool->quit_)
+			{
+				return;
+			}
+			batch = pool->batch_;
+		}
+
+		pool->RunTasks();
+
+		{
+			std::lock_guard<std::mutex> lock(pool->mutex_);
+			pool->n_workers_done_++;
+		}
+		pool->done_cond_.notify_one();
+	}
+#endif
+}
+
+static unsigned int &GlobalSeed()
+{
+	// Initialized on first use, also when called during static initialization of other modules
+	static unsigned int seed = (unsigned int)time(0);
+	return seed;
+}
+
+void SE_Random::SetGlobalSeed(unsigned int seed)
+{
+	GlobalSeed() = seed;
+}
+
+unsigned int SE_Random::GetGlobalSeed()
+{
+	return GlobalSeed();
+}
+
+void SE_Random::Seed(unsigned int seed, unsigned long long stream_id)
+{
+	key_ = Hash(Hash(seed) ^ stream_id);
+	counter_ = 0;
+}
+
 void SE_Option::Usage()
 {
 	printf("  %s%s %s", OPT_PREFIX, opt_str_.c_str(), (opt_arg_ != "") ? std::string('<'+ opt_arg_ +'>').c_str() : "");
@@ -151,6 +151,8 @@ void SwapByteOrder(unsigned char *buf, int data_type_size, int buf_size);
 #else
 	#include <thread>
 	#include <mutex>
+	#include <condition_variable>
+	#include <atomic>
 #endif
 
 class SE_Thread
@@ -190,6 +192,113 @@ private:
 #endif
 };
 
+/**
+  A set of worker threads executing batches of independent tasks. The calling thread takes part 
+  in the work, so with n workers up to n + 1 tasks run in parallel. Without workers, or where 
+  threads are not supported, tasks run in sequence on the calling thread.
+*/
+class SE_TaskPool
+{
+public:
+	SE_TaskPool();
+	~SE_TaskPool();
+
+	/**
+	  Launch worker threads, replacing any running ones
+	  @param n_workers Number of threads in addition to the calling one, 0 for sequential execution
+	*/
+	void Start(int n_workers);
+
+	/**
+	  Stop and join all worker threads
+	*/
+	void Stop();
+
+	/**
+	  Execute func(i, arg) for i = 0 .. n_tasks - 1 and return when all calls are done. Tasks are 
+	  picked in order but may finish in any order, so each task should write to its own output.
+	  @param func Task function, receiving task index and the arg pointer
+	  @param n_tasks Number of tasks
+	  @param arg Passed to each call, typically pointing to the data shared by all tasks
+	*/
+	void Run(void(*func)(int, void*), int n_tasks, void *arg);
+
+	int GetNumberOfWorkers() { return (int)worker_.size(); }
+
+private:
+	std::vector<SE_Thread*> worker_;
+	void(*func_)(int, void*);
+	void *arg_;
+	int n_tasks_;
+#if (defined WINVER && WINVER == _WIN32_WINNT_WIN7)
+	int next_task_;
+#else
+	std::atomic<int> next_task_;
+	std::mutex mutex_;
+	std::condition_variable start_cond_;
+	std::condition_variable done_cond_;
+#endif
+	int batch_;  // incremented for each batch, signals workers to start
+	int first_batch_;  // batch counter when workers were launched
+	int n_workers_done_;
+	bool quit_;
+
+	static void WorkerThread(void *args);
+	void RunTasks();
+};
+
+
+/**
+  Counter based random number stream. Each number is a hash of the stream key and a counter, so a stream
+  depends on the global seed and its stream id only. Give each entity or subsystem its own stream, then
+  the sequence it draws is the same from run to run regardless of what other streams draw or in what
+  order threads execute.
+*/
+class SE_Random
+{
+public:
+	SE_Random(unsigned long long stream_id = 0) { Seed(GetGlobalSeed(), stream_id); }
+
+	/**
+	  Set the global seed of all streams seeded hereafter. Default is the time at program start.
+	  Call it before loading any scenario, and reuse the seed to reproduce a run.
+	*/
+	static void SetGlobalSeed(unsigned int seed);
+	static unsigned int GetGlobalSeed();
+
+	/**
+	  Restart the stream
+	  @param seed Global seed, see SetGlobalSeed
+	  @param stream_id Identifies the stream, e.g. entity id
+	*/
+	void Seed(unsigned int seed, unsigned long long stream_id);
+
+	unsigned long long Get() { return Hash(key_ ^ Hash(counter_++)); }
+
+	/**
+	  @return Random number in [0, 1)
+	*/
+	double GetReal() { return (Get() >> 11) * (1.0 / 9007199254740992.0); }
+
+	/**
+	  @return Random integer in [0, n - 1]
+	*/
+	int GetInt(int n) { return (int)(GetReal() * n); }
+
+private:
+	unsigned long long key_;
+	unsigned long long counter_;
+
+	static unsigned long long Hash(unsigned long long x)
+	{
+		// splitmix64 finalizer
+		x += 0x9E3779B97F4A7C15ULL;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+		return x ^ (x >> 31);
+	}
+};
+
 
 std::vector<std::string> SplitString(const std::string &s, char separator);
 std::string DirNameOf(const std::string& fname);
@@ -197,7 +306,7 @@ std::string FileNameOf(const std::string& fname);
 std::string FileNameWithoutExtOf(const std::string& fname);
 
 
-// Global Logger class
+// Global Logger class, thread safe
 class Logger
 {
 public:
@@ -215,6 +324,7 @@ private:
 	FuncPtr callback_;
 
 	std::ofstream file_;
+	SE_Mutex mutex_;  // serialize log entries from multiple threads
 };
 
 // Argument parser 
@@ -0,0 +1,257 @@
+/*
+ * esmini - Environment Simulator Minimalistic
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application measures parallel stepping of objects (ScenarioEngine::SetObjectThreads). A scenario of
+  * a number of vehicles, spread over the roads of a road network, is generated and written to fleet.xosc.
+  * Each vehicle has init actions changing its speed and lane offset. The scenario is stepped a number of
+  * times by 1, 2, 4 and so on up to the given number of threads. Time per step and a checksum of all object
+  * states are reported. Returns 0 if the checksums of all thread counts are equal.
+  */
+
+#include <fstream>
+#include "ScenarioEngine.hpp"
+#include "CommonMini.hpp"
+
+using namespace scenarioengine;
+
+#define DEFAULT_N_VEHICLES 2000
+#define DEFAULT_N_STEPS 100
+#define DEFAULT_MAX_THREADS 32
+#define DEFAULT_TIMESTEP 0.05
+#define DEFAULT_ODR_FILENAME "../resources/xodr/multi_intersections.xodr"
+#define RANDOM_SEED 0  // junction choices
+#define MIN_ROAD_LENGTH 20.0  // m
+#define VEHICLE_SPACING 6.0  // m, along each lane
+
+typedef struct
+{
+	int road_id;
+	int lane_id;
+	double s;
+} Placement;
+
+static void WriteVehicle(std::ofstream &file, int idx, Placement &placement)
+{
+	file << "<Private entityRef=\"Vehicle" << idx << "\">\n";
+	file << "<PrivateAction><TeleportAction><Position><LanePosition roadId=\"" << placement.road_id << "\" laneId=\"" <<
+		placement.lane_id << "\" offset=\"0\" s=\"" << placement.s << "\"/></Position></TeleportAction></PrivateAction>\n";
+	file << "<PrivateAction><LongitudinalAction><SpeedAction><SpeedActionDynamics dynamicsShape=\"sinusoidal\" value=\"" <<
+		2 + idx % 4 << "\" dynamicsDimension=\"time\"/><SpeedActionTarget><AbsoluteTargetSpeed value=\"" << 8 + idx % 7 <<
+		"\"/></SpeedActionTarget></SpeedAction></LongitudinalAction></PrivateAction>\n";
+	file << "<PrivateAction><LateralAction><LaneOffsetAction continuous=\"false\"><LaneOffsetActionDynamics maxLateralAcc=\"0.5\" "
+		"dynamicsShape=\"sinusoidal\"/><LaneOffsetTarget><AbsoluteTargetLaneOffset value=\"0.4\"/></LaneOffsetTarget></LaneOffsetAction>"
+		"</LateralAction></PrivateAction>\n";
+	file << "</Private>\n";
+}
+
+static void WriteScenario(std::ofstream &file, std::string odr_filename, std::vector<Placement> &placements)
+{
+	file << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<OpenSCENARIO>\n";
+	file << "<FileHeader revMajor=\"0\" revMinor=\"9\" date=\"2020-01-01T10:00:00\" description=\"fleetbench\" author=\"esmini\"/>\n";
+	file << "<ParameterDeclarations/>\n";
+	file << "<RoadNetwork><LogicFile filepath=\"" << odr_filename << "\"/></RoadNetwork>\n";
+	file << "<Entities>\n";
+	for (size_t i = 0; i < placements.size(); i++)
+	{
+		file << "<ScenarioObject name=\"Vehicle" << i << "\"><Vehicle name=\"car\" vehicleCategory=\"car\">"
+			"<BoundingBox><Center x=\"1.4\" y=\"0.0\" z=\"0.9\"/><Dimensions width=\"2.0\" length=\"5.0\" height=\"1.8\"/></BoundingBox>"
+			"<Performance maxSpeed=\"69\" maxDeceleration=\"30\"/>"
+			"<Axles><FrontAxle maxSteering=\"30\" wheelDiameter=\"0.8\" trackWidth=\"1.68\" positionX=\"2.98\" positionZ=\"0.4\"/>"
+			"<RearAxle maxSteering=\"30\" wheelDiameter=\"0.8\" trackWidth=\"1.68\" positionX=\"0\" positionZ=\"0.4\"/></Axles>"
+			"<Properties/></Vehicle></ScenarioObject>\n";
+	}
+	file << "</Entities>\n";
+	file << "<Storyboard>\n<Init><Actions>\n";
+	for (size_t i = 0; i < placements.size(); i++)
+	{
+		WriteVehicle(file, (int)i, placements[i]);
+	}
+	file << "</Actions></Init>\n<Story name=\"Story\"/>\n<StopTrigger/>\n</Storyboard>\n</OpenSCENARIO>\n";
+}
+
+// Vehicles spread over the driving lanes of all roads outside junctions
+static int PlaceVehicles(std::string odr_filename, int n_vehicles, std::vector<Placement> &placements)
+{
+	if (!roadmanager::Position::LoadOpenDrive(odr_filename.c_str()))
+	{
+		printf("Failed to load %s\n", odr_filename.c_str());
+		return -1;
+	}
+
+	roadmanager::OpenDrive *odr = roadmanager::Position::GetDefaultOpenDrive();
+	std::vector<roadmanager::Road*> roads;
+
+	for (int i = 0; i < odr->GetNumOfRoads(); i++)
+	{
+		roadmanager::Road *road = odr->GetRoadByIdx(i);
+		if (road->GetJunction() == -1 && road->GetLength() > MIN_ROAD_LENGTH && road->GetNumberOfDrivingLanes(0) > 0)
+		{
+			roads.push_back(road);
+		}
+	}
+
+	if (roads.size() == 0)
+	{
+		printf("No roads outside junctions in %s\n", odr_filename.c_str());
+		return -1;
+	}
+
+	for (int i = 0; i < n_vehicles; i++)
+	{
+		roadmanager::Road *road = roads[i % roads.size()];
+		int slot = i / (int)roads.size();
+		int n_lanes = road->GetNumberOfDrivingLanes(0);
+		Placement placement;
+
+		placement.road_id = road->GetId();
+		placement.lane_id = road->GetDrivingLaneByIdx(0, slot % n_lanes)->GetId();
+		placement.s = MIN_ROAD_LENGTH / 4 + fmod((slot / n_lanes) * VEHICLE_SPACING, road->GetLength() - MIN_ROAD_LENGTH / 2);
+		placements.push_back(placement);
+	}
+
+	return 0;
+}
+
+// Run the scenario, returning time per step in ms and a checksum of the object states
+static int Run(std::string osc_filename, int n_threads, int n_steps, double dt, double &step_time, double &checksum)
+{
+	ScenarioEngine *scenarioEngine = 0;
+
+	try
+	{
+		scenarioEngine = new ScenarioEngine(osc_filename, 0.0);
+	}
+	catch (const std::exception& e)
+	{
+		printf("Failed to load %s: %s\n", osc_filename.c_str(), e.what());
+		return -1;
+	}
+
+	scenarioEngine->SetObjectThreads(n_threads);
+	scenarioEngine->step(0.0, true);
+
+	__int64 start_time = SE_getSystemTime();
+	for (int i = 0; i < n_steps; i++)
+	{
+		scenarioEngine->step(dt);
+	}
+	step_time = (double)(SE_getSystemTime() - start_time) / n_steps;
+
+	checksum = 0.0;
+	for (size_t i = 0; i < scenarioEngine->entities.object_.size(); i++)
+	{
+		Object *obj = scenarioEngine->entities.object_[i];
+		roadmanager::Position *pos = &obj->pos_;
+
+		checksum += (i + 1) * (pos->GetX() + 3 * pos->GetY() + 5 * pos->GetH() + 7 * pos->GetOffset() + 11 * pos->GetTrackId() +
+			13 * obj->speed_ + 17 * obj->odometer_);
+	}
+
+	delete scenarioEngine;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	SE_Options opt;
+	std::string arg_str;
+	std::string odr_filename = DEFAULT_ODR_FILENAME;
+	std::string osc_filename = "fleet.xosc";
+	int n_vehicles = DEFAULT_N_VEHICLES;
+	int n_steps = DEFAULT_N_STEPS;
+	int max_threads = DEFAULT_MAX_THREADS;
+	double dt = DEFAULT_TIMESTEP;
+	std::vector<Placement> placements;
+
+	// use common options parser to manage the program arguments
+	opt.AddOption("vehicles", "Number of vehicles (default = 2000)", "number");
+	opt.AddOption("steps", "Number of steps per run (default = 100)", "number");
+	opt.AddOption("threads", "Max number of threads, runs are made for 1, 2, 4 and so on up to this (default = 32)", "number");
+	opt.AddOption("odr", "OpenDRIVE file, relative to current directory (default = " DEFAULT_ODR_FILENAME ")", "filename");
+	opt.AddOption("timestep", "Fixed simulation timestep (default = 0.05)", "timestep");
+
+	opt.ParseArgs(&argc, argv);
+
+	if (argc > 1)
+	{
+		opt.PrintArgs(argc, argv, "Unrecognized arguments:");
+		opt.PrintUsage();
+		return -1;
+	}
+
+	if ((arg_str = opt.GetOptionArg("vehicles")) != "")
+	{
+		n_vehicles = MAX(1, atoi(arg_str.c_str()));
+	}
+	if ((arg_str = opt.GetOptionArg("steps")) != "")
+	{
+		n_steps = MAX(1, atoi(arg_str.c_str()));
+	}
+	if ((arg_str = opt.GetOptionArg("threads")) != "")
+	{
+		max_threads = MAX(1, atoi(arg_str.c_str()));
+	}
+	if ((arg_str = opt.GetOptionArg("odr")) != "")
+	{
+		odr_filename = arg_str;
+	}
+	if ((arg_str = opt.GetOptionArg("timestep")) != "")
+	{
+		dt = atof(arg_str.c_str());
+	}
+
+	if (PlaceVehicles(odr_filename, n_vehicles, placements) != 0)
+	{
+		return -1;
+	}
+
+	std::ofstream file(osc_filename);
+	WriteScenario(file, odr_filename, placements);
+	file.close();
+
+	printf("Generated %s, %d vehicles, %d steps per run\n", osc_filename.c_str(), n_vehicles, n_steps);
+
+	// Same random junction choices in all runs
+	SE_Random::SetGlobalSeed(RANDOM_SEED);
+
+	double ref_checksum = 0.0;
+	double ref_step_time = 0.0;
+	int n_differing = 0;
+
+	for (int n_threads = 1; n_threads <= max_threads; n_threads *= 2)
+	{
+		double step_time;
+		double checksum;
+
+		if (Run(osc_filename, n_threads, n_steps, dt, step_time, checksum) != 0)
+		{
+			return -1;
+		}
+
+		if (n_threads == 1)
+		{
+			ref_checksum = checksum;
+			ref_step_time = step_time;
+		}
+		else if (checksum != ref_checksum)
+		{
+			n_differing++;
+		}
+
+		printf("%2d threads: %.2f ms per step (%.2fx), checksum %.10e%s\n", n_threads, step_time, ref_step_time / MAX(step_time, SMALL_NUMBER),
+			checksum, checksum == ref_checksum ? "" : " differs");
+	}
+
+	return n_differing > 0 ? -1 : 0;
+}
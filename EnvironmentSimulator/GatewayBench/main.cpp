@@ -0,0 +1,163 @@
+/*
+ * esmini - Environment Simulator Minimalistic
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application measures object state reporting to the ScenarioGateway (ScenarioGateway::reportObject),
+  * as done by external traffic simulators each frame. A number of objects are registered, then reported a
+  * number of frames by each kind of position: road coordinates, world coordinates and a Position object.
+  * Time per frame is reported. Finally each object is looked up by id, checking that its state is the one
+  * of the last report. Returns 0 if all states are correct.
+  */
+
+#include <vector>
+#include "ScenarioGateway.hpp"
+#include "CommonMini.hpp"
+
+using namespace scenarioengine;
+
+#define DEFAULT_N_OBJECTS 10000
+#define DEFAULT_N_FRAMES 20
+#define DEFAULT_ODR_FILENAME "../resources/xodr/straight_500m.xodr"
+#define FRAME_TIME 0.05  // s
+#define ROAD_ID 1
+#define LANE_ID -1
+
+typedef enum
+{
+	REPORT_ROAD_POS,
+	REPORT_WORLD_POS,
+	REPORT_POSITION
+} ReportKind;
+
+static const char *report_kind_name[] = { "road", "world", "position" };
+
+// Speed is unique per object and frame, identifying the report
+static double GetSpeed(int id, int frame)
+{
+	return id + 1e-3 * frame;
+}
+
+static void Report(ScenarioGateway &gateway, std::vector<std::string> &names, std::vector<roadmanager::Position> &positions,
+	ReportKind kind, int frame)
+{
+	for (int i = 0; i < (int)names.size(); i++)
+	{
+		roadmanager::Position &pos = positions[i];
+
+		if (kind == REPORT_ROAD_POS)
+		{
+			gateway.reportObject(i, names[i], 0, 2, frame * FRAME_TIME, GetSpeed(i, frame), 0, 0, ROAD_ID, LANE_ID, pos.GetOffset(),
+				pos.GetS());
+		}
+		else if (kind == REPORT_WORLD_POS)
+		{
+			gateway.reportObject(i, names[i], 0, 2, frame * FRAME_TIME, GetSpeed(i, frame), 0, 0, pos.GetX(), pos.GetY(), pos.GetZ(),
+				pos.GetH(), pos.GetP(), pos.GetR());
+		}
+		else
+		{
+			gateway.reportObject(i, names[i], 0, 2, frame * FRAME_TIME, GetSpeed(i, frame), 0, 0, &pos);
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	SE_Options opt;
+	std::string arg_str;
+	std::string odr_filename = DEFAULT_ODR_FILENAME;
+	int n_objects = DEFAULT_N_OBJECTS;
+	int n_frames = DEFAULT_N_FRAMES;
+	ScenarioGateway gateway;
+	std::vector<std::string> names;
+	std::vector<roadmanager::Position> positions;
+	int frame = 0;
+	int n_failed = 0;
+
+	// use common options parser to manage the program arguments
+	opt.AddOption("objects", "Number of objects (default = 10000)", "number");
+	opt.AddOption("frames", "Number of frames per kind of position (default = 20)", "number");
+	opt.AddOption("odr", "OpenDRIVE file, with a road of id 1 (default = " DEFAULT_ODR_FILENAME ")", "filename");
+
+	opt.ParseArgs(&argc, argv);
+
+	if (argc > 1)
+	{
+		opt.PrintArgs(argc, argv, "Unrecognized arguments:");
+		opt.PrintUsage();
+		return -1;
+	}
+
+	if ((arg_str = opt.GetOptionArg("objects")) != "")
+	{
+		n_objects = MAX(1, atoi(arg_str.c_str()));
+	}
+	if ((arg_str = opt.GetOptionArg("frames")) != "")
+	{
+		n_frames = MAX(1, atoi(arg_str.c_str()));
+	}
+	if ((arg_str = opt.GetOptionArg("odr")) != "")
+	{
+		odr_filename = arg_str;
+	}
+
+	if (!roadmanager::Position::LoadOpenDrive(odr_filename.c_str()))
+	{
+		printf("Failed to load %s\n", odr_filename.c_str());
+		return -1;
+	}
+
+	roadmanager::Road *road = roadmanager::Position::GetDefaultOpenDrive()->GetRoadById(ROAD_ID);
+	if (road == 0)
+	{
+		printf("No road of id %d in %s\n", ROAD_ID, odr_filename.c_str());
+		return -1;
+	}
+
+	// Objects spread along the road, names long enough not to fit small string buffers
+	for (int i = 0; i < n_objects; i++)
+	{
+		names.push_back("external_traffic_object_" + std::to_string(i));
+		positions.push_back(roadmanager::Position(ROAD_ID, LANE_ID, road->GetLength() * i / n_objects, 0.0));
+	}
+
+	__int64 start_time = SE_getSystemTime();
+	Report(gateway, names, positions, REPORT_ROAD_POS, frame++);
+	printf("Registered %d objects in %.2f ms\n", gateway.getNumberOfObjects(), (double)(SE_getSystemTime() - start_time));
+
+	for (int kind = REPORT_ROAD_POS; kind <= REPORT_POSITION; kind++)
+	{
+		start_time = SE_getSystemTime();
+		for (int i = 0; i < n_frames; i++)
+		{
+			Report(gateway, names, positions, (ReportKind)kind, frame++);
+		}
+		double frame_time = (double)(SE_getSystemTime() - start_time) / n_frames;
+
+		printf("%-8s position: %.2f ms per frame, %.3f us per object\n", report_kind_name[kind], frame_time, 1e3 * frame_time / n_objects);
+	}
+
+	for (int i = 0; i < n_objects; i++)
+	{
+		ObjectState *state = gateway.getObjectStatePtrById(i);
+
+		if (state == 0 || state->state_.id != i || names[i].compare(0, NAME_LEN - 1, state->state_.name) != 0 ||
+			state->state_.speed != (float)GetSpeed(i, frame - 1))
+		{
+			n_failed++;
+		}
+	}
+
+	printf("%d objects of %d with incorrect state\n", n_failed, n_objects);
+
+	return n_failed > 0 || gateway.getNumberOfObjects() != n_objects ? -1 : 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * esmini - Environment Simulator Minimalistic
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application stresses the instance API of the ScenarioEngineDLL. First a reference run of the
+  * scenario is made by a single instance. Then a number of instances are stepped concurrently, one
+  * thread each, and finally one instance is stepped by all threads at once. Object states must match
+  * the reference run after every step, respectively after the last one. Returns 0 if all runs match.
+  */
+
+#include <string.h>
+#include <vector>
+#include "scenarioenginedll.hpp"
+#include "CommonMini.hpp"
+
+#define DEFAULT_N_INSTANCES 8
+#define DEFAULT_N_STEPS 1000
+#define DEFAULT_TIMESTEP 0.05
+#define MAX_OBJECTS 100
+
+typedef std::vector<SE_ScenarioObjectState> StepStates;
+
+typedef struct
+{
+	void *handle;
+	int n_steps;
+	float dt;
+	const std::vector<StepStates> *reference;
+	int n_diff;  // number of steps not matching the reference
+} InstanceRun;
+
+static int GetStates(void *handle, StepStates &states)
+{
+	int n_objects = MAX_OBJECTS;
+
+	states.resize(MAX_OBJECTS);
+	if (SE_GetObjectStatesInstance(handle, &n_objects, &states[0]) != 0)
+	{
+		return -1;
+	}
+	states.resize(n_objects);
+
+	return 0;
+}
+
+static bool EqualStates(const StepStates &a, const StepStates &b)
+{
+	return a.size() == b.size() && (a.size() == 0 || memcmp(&a[0], &b[0], a.size() * sizeof(SE_ScenarioObjectState)) == 0);
+}
+
+// Step an instance of its own, comparing states with the reference after each step
+static void StepInstance(void *arg)
+{
+	InstanceRun *run = (InstanceRun*)arg;
+	StepStates states;
+
+	for (int i = 0; i < run->n_steps; i++)
+	{
+		if (SE_StepInstance(run->handle, run->dt) != 0 || GetStates(run->handle, states) != 0 ||
+			!EqualStates(states, (*run->reference)[i]))
+		{
+			run->n_diff++;
+		}
+	}
+}
+
+// Step an instance shared with other threads. States are fetched concurrently but not compared,
+// since the number of steps taken by the other threads is unknown.
+static void StepSharedInstance(void *arg)
+{
+	InstanceRun *run = (InstanceRun*)arg;
+	StepStates states;
+
+	for (int i = 0; i < run->n_steps; i++)
+	{
+		if (SE_StepInstance(run->handle, run->dt) != 0 || GetStates(run->handle, states) != 0)
+		{
+			run->n_diff++;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	SE_Options opt;
+	std::string arg_str;
+	std::string osc_filename;
+	int n_instances = DEFAULT_N_INSTANCES;
+	int n_steps = DEFAULT_N_STEPS;
+	float dt = (float)DEFAULT_TIMESTEP;
+	std::vector<StepStates> reference;
+	int n_failed = 0;
+
+	// use common options parser to manage the program arguments
+	opt.AddOption("osc", "OpenSCENARIO file to run", "filename");
+	opt.AddOption("instances", "Number of instances, and threads, to run concurrently (default = 8)", "number");
+	opt.AddOption("steps", "Number of steps per run (default = 1000)", "number");
+	opt.AddOption("timestep", "Fixed simulation timestep (default = 0.05)", "timestep");
+
+	if (argc < 2)
+	{
+		opt.PrintUsage();
+		return -1;
+	}
+
+	opt.ParseArgs(&argc, argv);
+
+	if ((osc_filename = opt.GetOptionArg("osc")) == "")
+	{
+		printf("Missing OpenSCENARIO file\n");
+		opt.PrintUsage();
+		return -1;
+	}
+	if ((arg_str = opt.GetOptionArg("instances")) != "")
+	{
+		n_instances = MAX(1, atoi(arg_str.c_str()));
+	}
+	if ((arg_str = opt.GetOptionArg("steps")) != "")
+	{
+		n_steps = MAX(1, atoi(arg_str.c_str()));
+	}
+	n_instances = MIN(n_instances, n_steps);
+	if ((arg_str = opt.GetOptionArg("timestep")) != "")
+	{
+		dt = (float)atof(arg_str.c_str());
+	}
+
+	// Reference run, single instance in the main thread
+	void *handle = SE_InitInstance(osc_filename.c_str(), 0, 0, 0);
+	if (handle == 0)
+	{
+		printf("Failed to load %s\n", osc_filename.c_str());
+		return -1;
+	}
+
+	reference.resize(n_steps);
+	for (int i = 0; i < n_steps; i++)
+	{
+		if (SE_StepInstance(handle, dt) != 0 || GetStates(handle, reference[i]) != 0)
+		{
+			printf("Reference run failed at step %d\n", i);
+			SE_CloseInstance(handle);
+			return -1;
+		}
+	}
+	SE_CloseInstance(handle);
+
+	// Concurrent instances, one thread each
+	std::vector<InstanceRun> runs(n_instances);
+	std::vector<SE_Thread> threads(n_instances);
+	double start_time = SE_getSystemTime();
+
+	for (int i = 0; i < n_instances; i++)
+	{
+		runs[i].handle = SE_InitInstance(osc_filename.c_str(), 0, 0, 0);
+		runs[i].n_steps = n_steps;
+		runs[i].dt = dt;
+		runs[i].reference = &reference;
+		runs[i].n_diff = 0;
+	}
+	for (int i = 0; i < n_instances; i++)
+	{
+		threads[i].Start(StepInstance, &runs[i]);
+	}
+	for (int i = 0; i < n_instances; i++)
+	{
+		threads[i].Wait();
+	}
+
+	// Instances must not be closed while other threads are calling them, see SE_CloseInstance
+	for (int i = 0; i < n_instances; i++)
+	{
+		SE_CloseInstance(runs[i].handle);
+		if (runs[i].n_diff > 0)
+		{
+			n_failed++;
+		}
+	}
+
+	printf("%d instances, %d steps each in %.2f s: %d instances differ from reference run\n", n_instances, n_steps,
+		1e-3 * (SE_getSystemTime() - start_time), n_failed);
+
+	// One instance shared by all threads, steps spread between them
+	int n_shared_steps = n_steps / n_instances;
+	int n_shared_errors = 0;
+	StepStates states;
+
+	handle = SE_InitInstance(osc_filename.c_str(), 0, 0, 0);
+	for (int i = 0; i < n_instances; i++)
+	{
+		runs[i].handle = handle;
+		runs[i].n_steps = n_shared_steps;
+		runs[i].n_diff = 0;
+		threads[i].Start(StepSharedInstance, &runs[i]);
+	}
+	for (int i = 0; i < n_instances; i++)
+	{
+		threads[i].Wait();
+		n_shared_errors += runs[i].n_diff;
+	}
+
+	if (GetStates(handle, states) != 0 || !EqualStates(states, reference[n_instances * n_shared_steps - 1]))
+	{
+		n_shared_errors++;
+	}
+	SE_CloseInstance(handle);
+
+	printf("1 instance, %d steps by %d threads: %s\n", n_instances * n_shared_steps, n_instances,
+		n_shared_errors > 0 ? "differs from reference run" : "same as reference run");
+
+	return n_failed > 0 || n_shared_errors > 0 ? -1 : 0;
+}
@@ -0,0 +1,291 @@
+/* 
+ * esmini - Environment Simulator Minimalistic 
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * 
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application measures the world to road coordinate lookup (Position::SetInertiaPos). Random points 
+  * are resolved using the geometry grid, then again with the grid cleared, i.e. checking all roads. The 
+  * two lookups must give the same road position. Points are sampled close to the roads, and uniformly 
+  * within the extent of the road network. Road coordinate operations are measured as well, setting random
+  * lane positions (Position::SetLanePos) and moving them along the roads (Position::MoveAlongS). Either an
+  * OpenDRIVE file is loaded, or a synthetic network consisting of rows of chained straight roads is generated.
+  */
+
+#include <chrono>
+#include <fstream>
+#include <vector>
+#include "RoadManager.hpp"
+#include "CommonMini.hpp"
+
+using namespace roadmanager;
+
+#define DEFAULT_N_POINTS 100000
+#define SYNTHETIC_ROAD_LENGTH 100.0  // m
+#define SYNTHETIC_ROW_DIST 50.0  // m
+#define SYNTHETIC_ROW_SIZE 100  // roads
+#define N_MOVES 10  // per lane position
+#define MOVE_DIST 5.0  // m
+
+typedef struct
+{
+	double x;
+	double y;
+	double h;
+} Point;
+
+typedef struct
+{
+	int road_id;
+	int lane_id;
+	double s;
+} Result;
+
+static double GetTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void WriteSyntheticRoad(std::ofstream &file, int n_roads)
+{
+	file << "<?xml version=\"1.0\" standalone=\"yes\"?>\n<OpenDRIVE>\n";
+	file << "<header revMajor=\"1\" revMinor=\"4\" name=\"synthetic\" version=\"1.00\"/>\n";
+
+	for (int i = 0; i < n_roads; i++)
+	{
+		int row = i / SYNTHETIC_ROW_SIZE;
+		int col = i % SYNTHETIC_ROW_SIZE;
+
+		file << "<road name=\"r" << i << "\" length=\"" << SYNTHETIC_ROAD_LENGTH << "\" id=\"" << i << "\" junction=\"-1\"><link>";
+		if (col > 0)
+		{
+			file << "<predecessor elementType=\"road\" elementId=\"" << i - 1 << "\" contactPoint=\"end\"/>";
+		}
+		if (col < SYNTHETIC_ROW_SIZE - 1 && i + 1 < n_roads)
+		{
+			file << "<successor elementType=\"road\" elementId=\"" << i + 1 << "\" contactPoint=\"start\"/>";
+		}
+		file << "</link>\n<planView><geometry s=\"0\" x=\"" << col * SYNTHETIC_ROAD_LENGTH << "\" y=\"" << row * SYNTHETIC_ROW_DIST <<
+			"\" hdg=\"0\" length=\"" << SYNTHETIC_ROAD_LENGTH << "\"><line/></geometry></planView>\n";
+		file << "<elevationProfile/><lateralProfile/><lanes><laneSection s=\"0\">\n";
+		file << "<left><lane id=\"1\" type=\"driving\" level=\"false\"><link><predecessor id=\"1\"/><successor id=\"1\"/></link>"
+			"<width sOffset=\"0\" a=\"3.5\" b=\"0\" c=\"0\" d=\"0\"/></lane></left>\n";
+		file << "<center><lane id=\"0\" type=\"driving\" level=\"false\"/></center>\n";
+		file << "<right><lane id=\"-1\" type=\"driving\" level=\"false\"><link><predecessor id=\"-1\"/><successor id=\"-1\"/></link>"
+			"<width sOffset=\"0\" a=\"3.5\" b=\"0\" c=\"0\" d=\"0\"/></lane></right>\n";
+		file << "</laneSection></lanes></road>\n";
+	}
+
+	file << "</OpenDRIVE>\n";
+}
+
+static double Lookup(std::vector<Point> &points, std::vector<Result> &results)
+{
+	double start_time = GetTime();
+
+	results.resize(points.size());
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		Position pos;
+		pos.SetInertiaPos(points[i].x, points[i].y, 0, points[i].h, 0, 0);
+		results[i].road_id = pos.GetTrackId();
+		results[i].lane_id = pos.GetLaneId();
+		results[i].s = pos.GetS();
+	}
+
+	return GetTime() - start_time;
+}
+
+static void Run(const char *label, std::vector<Point> &points)
+{
+	OpenDrive *odr = Position::GetDefaultOpenDrive();
+	double margin = odr->GetGeometryGrid()->GetMargin();  // as built when loading the road network
+	std::vector<Result> grid_results;
+	std::vector<Result> all_results;
+	int n_diff = 0;
+
+	double grid_time = Lookup(points, grid_results);
+
+	odr->GetGeometryGrid()->Clear();
+	double all_time = Lookup(points, all_results);
+	odr->GetGeometryGrid()->Build(odr, margin);
+
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		if (grid_results[i].road_id != all_results[i].road_id || grid_results[i].lane_id != all_results[i].lane_id ||
+			fabs(grid_results[i].s - all_results[i].s) > SMALL_NUMBER)
+		{
+			n_diff++;
+		}
+	}
+
+	printf("%-8s %d points: grid %.2f us, all roads %.2f us per lookup (%.1fx), %d differing results\n", label, (int)points.size(),
+		1e6 * grid_time / points.size(), 1e6 * all_time / points.size(), all_time / MAX(grid_time, SMALL_NUMBER), n_diff);
+}
+
+// Random lane positions, then moved along the road network
+static void RunLanePos(int n_points)
+{
+	OpenDrive *odr = Position::GetDefaultOpenDrive();
+	std::vector<Position> positions(n_points);
+	std::vector<int> road_id(n_points);
+	std::vector<int> lane_id(n_points);
+	std::vector<double> s(n_points);
+	SE_Random rand;
+	double checksum = 0.0;
+
+	rand.Seed(1, 0);
+
+	for (int i = 0; i < n_points; i++)
+	{
+		Road *road = odr->GetRoadByIdx(rand.GetInt(odr->GetNumOfRoads()));
+		road_id[i] = road->GetId();
+		s[i] = rand.GetReal() * road->GetLength();
+
+		int n_lanes = road->GetNumberOfDrivingLanes(s[i]);
+		lane_id[i] = n_lanes > 0 ? road->GetDrivingLaneByIdx(s[i], rand.GetInt(n_lanes))->GetId() : 0;
+	}
+
+	double start_time = GetTime();
+	for (int i = 0; i < n_points; i++)
+	{
+		positions[i].SetLanePos(road_id[i], lane_id[i], s[i], 0.0);
+	}
+	double set_time = GetTime() - start_time;
+
+	for (int i = 0; i < n_points; i++)
+	{
+		checksum += positions[i].GetX() + positions[i].GetY();
+	}
+
+	start_time = GetTime();
+	for (int i = 0; i < N_MOVES; i++)
+	{
+		for (int j = 0; j < n_points; j++)
+		{
+			positions[j].MoveAlongS(MOVE_DIST);
+		}
+	}
+	double move_time = GetTime() - start_time;
+
+	for (int i = 0; i < n_points; i++)
+	{
+		checksum += positions[i].GetX() + positions[i].GetY();
+	}
+
+	printf("%-8s %d points: SetLanePos %.2f us, MoveAlongS %.2f us per call, checksum %.6f\n", "lanepos", n_points,
+		1e6 * set_time / n_points, 1e6 * move_time / (N_MOVES * n_points), checksum);
+}
+
+int main(int argc, char *argv[])
+{
+	SE_Options opt;
+	std::string arg_str;
+	int n_points = DEFAULT_N_POINTS;
+
+	// use common options parser to manage the program arguments
+	opt.AddOption("odr", "OpenDRIVE file to load", "filename");
+	opt.AddOption("synthetic", "Generate a road network of this number of chained straight roads, written to synthetic.xodr", "number");
+	opt.AddOption("points", "Number of random points of each kind (default = 100000)", "number");
+
+	if (argc < 2)
+	{
+		opt.PrintUsage();
+		return -1;
+	}
+
+	opt.ParseArgs(&argc, argv);
+
+	if (argc > 1)
+	{
+		opt.PrintArgs(argc, argv, "Unrecognized arguments:");
+		opt.PrintUsage();
+		return -1;
+	}
+
+	if ((arg_str = opt.GetOptionArg("points")) != "")
+	{
+		n_points = atoi(arg_str.c_str());
+	}
+
+	std::string odr_filename = opt.GetOptionArg("odr");
+	if ((arg_str = opt.GetOptionArg("synthetic")) != "")
+	{
+		odr_filename = "synthetic.xodr";
+		std::ofstream file(odr_filename);
+		WriteSyntheticRoad(file, atoi(arg_str.c_str()));
+	}
+
+	if (odr_filename == "")
+	{
+		printf("Missing odr or synthetic argument\n");
+		opt.PrintUsage();
+		return -1;
+	}
+
+	double start_time = GetTime();
+	if (!Position::LoadOpenDrive(odr_filename.c_str()))
+	{
+		printf("Failed to load %s\n", odr_filename.c_str());
+		return -1;
+	}
+	OpenDrive *odr = Position::GetDefaultOpenDrive();
+	printf("Loaded %s, %d roads, in %.2f s\n", odr_filename.c_str(), odr->GetNumOfRoads(), GetTime() - start_time);
+
+	if (odr->GetNumOfRoads() == 0)
+	{
+		return -1;
+	}
+
+	// Random points close to the roads, and within extent of the road network
+	std::vector<Point> near_points;
+	std::vector<Point> area_points;
+	SE_Random rand;
+	double x_min = LARGE_NUMBER;
+	double y_min = LARGE_NUMBER;
+	double x_max = -LARGE_NUMBER;
+	double y_max = -LARGE_NUMBER;
+
+	rand.Seed(0, 0);
+
+	for (int i = 0; i < n_points; i++)
+	{
+		Road *road = odr->GetRoadByIdx(rand.GetInt(odr->GetNumOfRoads()));
+		Position pos;
+		Point point;
+
+		pos.SetTrackPos(road->GetId(), rand.GetReal() * road->GetLength(), (2 * rand.GetReal() - 1) * 2 * MAX_TRACK_DIST);
+		point.x = pos.GetX();
+		point.y = pos.GetY();
+		point.h = 2 * M_PI * rand.GetReal();
+		near_points.push_back(point);
+
+		x_min = MIN(x_min, point.x);
+		y_min = MIN(y_min, point.y);
+		x_max = MAX(x_max, point.x);
+		y_max = MAX(y_max, point.y);
+	}
+
+	for (int i = 0; i < n_points; i++)
+	{
+		Point point;
+
+		point.x = x_min + rand.GetReal() * (x_max - x_min);
+		point.y = y_min + rand.GetReal() * (y_max - y_min);
+		point.h = 2 * M_PI * rand.GetReal();
+		area_points.push_back(point);
+	}
+
+	Run("near", near_points);
+	Run("area", area_points);
+	RunLanePos(n_points);
+
+	return 0;
+}
@@ -48,7 +48,7 @@ int main(int argc, char *argv[])
 
 	Position* pos = new Position();
 	double step_length_target = 1;
-	OpenDrive *od = Position::GetOpenDrive();
+	OpenDrive *od = Position::GetDefaultOpenDrive();
 
 	for (int r = 0; r < od->GetNumOfRoads(); r++)
 	{
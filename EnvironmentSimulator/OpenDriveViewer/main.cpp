@@ -21,7 +21,6 @@
   * Red line is the reference lane, blue lines shows drivable lanes. Non-drivable lanes are currently not indicated. 
   */
 
-#include <random>
 #include <iostream>
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -43,7 +42,7 @@ static const double stepSize = 0.01;
 static const double maxStepSize = 0.1;
 static const double minStepSize = 0.01;
 static const bool freerun = true;
-static std::mt19937 mt_rand;
+static SE_Random traffic_rand;  // placement of cars, each car has its own stream for route choices
 static double density = DEFAULT_DENSITY;
 static double speed = DEFAULT_SPEED;
 static int first_car_in_focus = -1;
@@ -100,10 +99,10 @@ int SetupCars(roadmanager::OpenDrive *odrManager, viewer::Viewer *viewer)
 		if (road->GetLength() > ROAD_MIN_LENGTH)
 		{
 			// Populate road lanes with vehicles at some random distances
-			for (double s = 10; s < road->GetLength() - average_distance; s += average_distance + (0.2 * average_distance * mt_rand()) / (mt_rand.max)())
+			for (double s = 10; s < road->GetLength() - average_distance; s += average_distance + 0.2 * average_distance * traffic_rand.GetReal())
 			{
 				// Pick lane by random
-				int lane_idx = ((double)road->GetNumberOfDrivingLanes(s) * mt_rand()) / (mt_rand.max)();
+				int lane_idx = traffic_rand.GetInt(road->GetNumberOfDrivingLanes(s));
 				roadmanager::Lane *lane = road->GetDrivingLaneByIdx(s, lane_idx);
 				if (lane == 0)
 				{
@@ -120,7 +119,7 @@ int SetupCars(roadmanager::OpenDrive *odrManager, viewer::Viewer *viewer)
 				}
 
 				// randomly choose model
-				int carModelID = (double(sizeof(carModelsFiles_) / sizeof(carModelsFiles_[0])) * mt_rand()) / (mt_rand.max)();
+				int carModelID = traffic_rand.GetInt(sizeof(carModelsFiles_) / sizeof(carModelsFiles_[0]));
 				LOG("Adding car of model %d to road nr %d (road id %d s %.2f lane id %d), ", carModelID, r, road->GetId(), s, lane->GetId());
 
 				Car *car_ = new Car;
@@ -131,6 +130,7 @@ int SetupCars(roadmanager::OpenDrive *odrManager, viewer::Viewer *viewer)
 				car_->s_init = s;
 				car_->pos = new roadmanager::Position(odrManager->GetRoadByIdx(r)->GetId(), lane->GetId(), s, 0);
 				car_->pos->SetHeadingRelative(lane->GetId() < 0 ? 0 : M_PI);
+				car_->pos->SetRandomStream(1 + cars.size());
 
 				if ((car_->model = viewer->AddCar(carModelsFiles_[carModelID], false, osg::Vec3(0.5, 0.5, 0.5), false)) == 0)
 				{
@@ -189,8 +189,6 @@ int main(int argc, char** argv)
 	// Use logger callback
 	Logger::Inst().SetCallback(log_callback);
 
-	mt_rand.seed(time(0));
-
 	// use an ArgumentParser object to manage the program arguments.
     osg::ArgumentParser arguments(&argc,argv);	
 
@@ -201,6 +199,7 @@ int main(int argc, char** argv)
 	arguments.getApplicationUsage()->addCommandLineOption("--model <filename>", "3D model filename");
 	arguments.getApplicationUsage()->addCommandLineOption("--density <number>", "density (cars / 100 m)", std::to_string((long long) (DEFAULT_DENSITY)));
 	arguments.getApplicationUsage()->addCommandLineOption("--speed <number>", "speed (km/h)", std::to_string((long long) (DEFAULT_SPEED)));
+	arguments.getApplicationUsage()->addCommandLineOption("--seed <number>", "Random seed, reuse to reproduce traffic (default = time)");
 
 	if (arguments.argc() < 2)
 	{
@@ -221,6 +220,14 @@ int main(int argc, char** argv)
 	printf("speed: %.2f\n", speed);
 	speed /= 3.6;
 
+	unsigned int seed;
+	if (arguments.read("--seed", seed))
+	{
+		SE_Random::SetGlobalSeed(seed);
+	}
+	printf("seed: %u\n", SE_Random::GetGlobalSeed());
+	traffic_rand.Seed(SE_Random::GetGlobalSeed(), 0);
+
 	roadmanager::Position *lane_pos = new roadmanager::Position();
 	roadmanager::Position *track_pos = new roadmanager::Position();
 
@@ -231,7 +238,7 @@ int main(int argc, char** argv)
 			printf("Failed to load ODR %s\n", odrFilename.c_str());
 			return -1;
 		}
-		roadmanager::OpenDrive *odrManager = roadmanager::Position::GetOpenDrive();
+		roadmanager::OpenDrive *odrManager = roadmanager::Position::GetDefaultOpenDrive();
 
 		viewer::Viewer *viewer = new viewer::Viewer(
 			odrManager,
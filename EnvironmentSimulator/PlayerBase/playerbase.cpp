@@ -49,10 +49,12 @@ ScenarioPlayer::ScenarioPlayer(int &argc, char *argv[]) :
 	headless = false;
 	launch_server = false;
 	fixed_timestep_ = -1.0;
-	viewer_ = 0;
+	time_stamp_ = 0;
 #ifdef _SCENARIO_VIEWER
+	viewer_ = 0;
 	viewerState_ = ViewerState::VIEWER_STATE_NOT_STARTED;
 	trail_dt = TRAIL_DOTS_DT;
+	last_dot_time_ = LARGE_NUMBER;
 #else
 	trail_dt = 0;
 #endif
@@ -65,8 +67,7 @@ ScenarioPlayer::ScenarioPlayer(int &argc, char *argv[]) :
 
 ScenarioPlayer::~ScenarioPlayer()
 {
-	if (launch_server && (scenarioEngine->entities.object_[0]->GetControl() == Object::Control::EXTERNAL ||
-		scenarioEngine->entities.object_[0]->GetControl() == Object::Control::HYBRID_EXTERNAL))
+	if (launch_server)
 	{
 		StopServer();
 	}
@@ -85,6 +86,11 @@ ScenarioPlayer::~ScenarioPlayer()
 		}
 #endif
 	}
+
+	for (size_t i = 0; i < sensor.size(); i++)
+	{
+		delete sensor[i];
+	}
 	delete scenarioEngine;
 }
 
@@ -105,11 +111,10 @@ void ScenarioPlayer::Frame(double timestep_s)
 
 void ScenarioPlayer::Frame()
 {
-	static __int64 time_stamp = 0;
 	double dt;
 	if ((dt = GetFixedTimestep()) < 0.0)
 	{
-		Frame(SE_getSimTimeStep(time_stamp, minStepSize, maxStepSize));
+		Frame(SE_getSimTimeStep(time_stamp_, minStepSize, maxStepSize));
 	}
 	else
 	{
@@ -117,16 +122,42 @@ void ScenarioPlayer::Frame()
 	}
 }
 
+static void UpdateSensor(int index, void *args)
+{
+	ScenarioPlayer *player = (ScenarioPlayer*)args;
+
+	player->sensor[index]->Update(&player->sensor_grid);
+	//LOG("sensor identified %d objects", player->sensor[index]->nObj_);
+}
+
+void ScenarioPlayer::SetSensorThreads(int n_threads)
+{
+	sensor_pool.Start(MAX(0, n_threads - 1));
+	LOG("Update sensors using %d thread%s", sensor_pool.GetNumberOfWorkers() + 1, sensor_pool.GetNumberOfWorkers() > 0 ? "s" : "");
+}
+
 void ScenarioPlayer::ScenarioFrame(double timestep_s)
 {
-	for (size_t i = 0; i < sensor.size(); i++)
+	if (sensor.size() > 0)
 	{
-		sensor[i]->Update();
-		//LOG("sensor identified %d objects", sensor[i]->nObj_);
+		// Cells sized by sensor range, so each sensor only needs to look into a few of them
+		double max_range = 0;
+		for (size_t i = 0; i < sensor.size(); i++)
+		{
+			max_range = MAX(max_range, sensor[i]->far_);
+		}
+		sensor_grid.Build(&scenarioEngine->entities, max_range);
 	}
 
+	sensor_pool.Run(UpdateSensor, (int)sensor.size(), this);
+
 	mutex.Lock();
 
+	if (launch_server)
+	{
+		ReportServerStates();
+	}
+
 	scenarioEngine->step(timestep_s);
 
 	//LOG("%d %d %.2f h: %.5f road_h %.5f h_relative_road %.5f",
@@ -148,13 +179,17 @@ void ScenarioPlayer::ScenarioFrame(double timestep_s)
 #ifdef _SCENARIO_VIEWER
 void ScenarioPlayer::ViewerFrame()
 {
-	static double last_dot_time = scenarioEngine->getSimulationTime();
+	if (last_dot_time_ > scenarioEngine->getSimulationTime())
+	{
+		// first frame
+		last_dot_time_ = scenarioEngine->getSimulationTime();
+	}
 
 	bool add_dot = false;
-	if (scenarioEngine->getSimulationTime() - last_dot_time > trail_dt)
+	if (scenarioEngine->getSimulationTime() - last_dot_time_ > trail_dt)
 	{
 		add_dot = true;
-		last_dot_time = scenarioEngine->getSimulationTime();
+		last_dot_time_ = scenarioEngine->getSimulationTime();
 	}
 
 	mutex.Lock();
@@ -216,7 +251,7 @@ void ScenarioPlayer::ViewerFrame()
 	}
 
 	// Update info text 
-	static char str_buf[128];
+	char str_buf[128];
 	snprintf(str_buf, sizeof(str_buf), "%.2fs %.2fkm/h", scenarioEngine->getSimulationTime(), 
 		3.6 * scenarioEngine->entities.object_[viewer_->currentCarInFocus_]->speed_);
 	viewer_->SetInfoText(str_buf);
@@ -247,7 +282,7 @@ int ScenarioPlayer::InitViewer()
 	// Create viewer
 	osg::ArgumentParser arguments(&argc_, argv_);
 	viewer_ = new viewer::Viewer(
-		roadmanager::Position::GetOpenDrive(),
+		scenarioEngine->getRoadManager(),
 		scenarioEngine->getSceneGraphFilename().c_str(),
 		scenarioEngine->getScenarioFilename().c_str(),
 		arguments, &opt);
@@ -380,12 +415,14 @@ void ScenarioPlayer::AddObjectSensor(int object_index, double x, double y, doubl
 void ScenarioPlayer::ShowObjectSensors(bool mode)
 {
 	// Switch on sensor visualization as defult when sensors are added
+#ifdef _SCENARIO_VIEWER
 	if (viewer_)
 	{
 		mutex.Lock();
 		viewer_->ShowObjectSensors(mode);
 		mutex.Unlock();
 	}
+#endif
 }
 
 int ScenarioPlayer::Init()
@@ -399,6 +436,7 @@ int ScenarioPlayer::Init()
 	opt.AddOption("osc", "OpenSCENARIO filename", "filename");
 	opt.AddOption("control", "Ego control (\"osc\", \"internal\", \"external\", \"hybrid\"", "mode");
 	opt.AddOption("record", "Record position data into a file for later replay", "filename");
+	opt.AddOption("shm", "Publish object states into named shared memory for local consumers", "name");
 	opt.AddOption("info_text", "Show info text HUD (\"on\" (default), \"off\") (toggle during simulation by press 't') ", "mode");
 	opt.AddOption("trails", "Show trails (\"on\" (default), \"off\") (toggle during simulation by press 't') ", "mode");
 	opt.AddOption("sensors", "Show sensor frustums (\"on\", \"off\" (default)) (toggle during simulation by press 'r') ", "mode");
@@ -407,8 +445,14 @@ int ScenarioPlayer::Init()
 	opt.AddOption("threads", "Run viewer in a separate thread, parallel to scenario engine");
 	opt.AddOption("headless", "Run without viewer");
 	opt.AddOption("server", "Launch server to receive state of external Ego simulator");
+	opt.AddOption("server_log_interval", "Time between logged summaries of data received by server (default = 1, 0 = off)", "seconds");
 	opt.AddOption("fixed_timestep", "Run simulation decoupled from realtime, with specified timesteps", "timestep");
 	opt.AddOption("ghost_headstart", "Launch Ego ghost at specified headstart time", "time");
+	opt.AddOption("odr_cache", "Folder for compiled road networks, speeding up subsequent loads", "dirname");
+	opt.AddOption("event_driven", "Evaluate only live acts and events of the story, faster for large storyboards");
+	opt.AddOption("sensor_threads", "Number of threads updating sensors in parallel (default = 1)", "number");
+	opt.AddOption("object_threads", "Number of threads stepping objects in parallel (default = 1)", "number");
+	opt.AddOption("seed", "Seed of random choices, e.g. at junctions. Reuse the logged seed to reproduce a run (default = time)", "number");
 
 	if (argc_ < 3)
 	{
@@ -458,6 +502,22 @@ int ScenarioPlayer::Init()
 		LOG("Run simulation decoupled from realtime, with fixed timestep: %.2f", GetFixedTimestep());
 	}
 	
+	if ((arg_str = opt.GetOptionArg("sensor_threads")) != "")
+	{
+		SetSensorThreads(atoi(arg_str.c_str()));
+	}
+
+	if ((arg_str = opt.GetOptionArg("odr_cache")) != "")
+	{
+		roadmanager::OpenDrive::SetCacheDir(arg_str);
+		LOG("Use road network cache folder %s", arg_str.c_str());
+	}
+
+	if ((arg_str = opt.GetOptionArg("seed")) != "")
+	{
+		SE_Random::SetGlobalSeed((unsigned int)strtoul(arg_str.c_str(), 0, 10));
+	}
+
 	double ghost_headstart = GHOST_HEADSTART;
 	if ((arg_str = opt.GetOptionArg("ghost_headstart")) != "")
 	{
@@ -486,6 +546,17 @@ int ScenarioPlayer::Init()
 		return -1;
 	}
 
+	if (opt.GetOptionSet("event_driven"))
+	{
+		scenarioEngine->SetEventDriven(true);
+		LOG("Event driven story evaluation");
+	}
+
+	if ((arg_str = opt.GetOptionArg("object_threads")) != "")
+	{
+		scenarioEngine->SetObjectThreads(atoi(arg_str.c_str()));
+	}
+
 	// Fetch scenario gateway and OpenDRIVE manager objects
 	scenarioGateway = scenarioEngine->getScenarioGateway();
 	odr_manager = scenarioEngine->getRoadManager();
@@ -497,6 +568,12 @@ int ScenarioPlayer::Init()
 		scenarioGateway->RecordToFile(arg_str, scenarioEngine->getOdrFilename(), scenarioEngine->getSceneGraphFilename());
 	}
 
+	// Share object states with other processes?
+	if ((arg_str = opt.GetOptionArg("shm")) != "")
+	{
+		scenarioGateway->PublishToSharedMemory(arg_str);
+	}
+
 	// Step scenario engine - zero time - just to reach and report init state of all vehicles
 	scenarioEngine->step(0.0, true);
 
@@ -541,11 +618,32 @@ int ScenarioPlayer::Init()
 		return -1;
 	}
 
-	if (launch_server && (scenarioEngine->entities.object_[0]->GetControl() == Object::Control::EXTERNAL ||
-		scenarioEngine->entities.object_[0]->GetControl() == Object::Control::HYBRID_EXTERNAL))
+	if (launch_server)
 	{
-		// Launch UDP server to receive external Ego state
-		StartServer(scenarioEngine);
+		// Only needed if there are any externally controlled objects
+		launch_server = false;
+		for (size_t i = 0; i < scenarioEngine->entities.object_.size(); i++)
+		{
+			if (scenarioEngine->entities.object_[i]->GetControl() == Object::Control::EXTERNAL ||
+				scenarioEngine->entities.object_[i]->GetControl() == Object::Control::HYBRID_EXTERNAL)
+			{
+				launch_server = true;
+				break;
+			}
+		}
+	}
+
+	if (launch_server)
+	{
+		double log_interval = DEFAULT_SERVER_LOG_INTERVAL;
+
+		if ((arg_str = opt.GetOptionArg("server_log_interval")) != "")
+		{
+			log_interval = atof(arg_str.c_str());
+		}
+
+		// Launch UDP server to receive states of external objects
+		StartServer(scenarioEngine, log_interval);
 	}
 
 	return 0;
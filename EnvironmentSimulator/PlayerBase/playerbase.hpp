@@ -52,6 +52,12 @@ public:
 	void ShowObjectSensors(bool mode);
 	void AddObjectSensor(int object_index, double pos_x, double pos_y, double pos_z, double heading, 
 		double near, double far, double fovH, int maxObj);
+	/**
+	Update sensors in parallel. Each sensor writes its own object list, so results don't depend on 
+	the number of threads.
+	@param n_threads Number of threads, including the one calling Frame(). 1 for sequential updates.
+	*/
+	void SetSensorThreads(int n_threads);
 	void SetFixedTimestep(double timestep) { fixed_timestep_ = timestep; }
 	double GetFixedTimestep() { return fixed_timestep_; }
 
@@ -61,12 +67,15 @@ public:
 	viewer::Viewer *viewer_;
 	std::vector<viewer::SensorViewFrustum*> sensorFrustum;
 	ViewerState viewerState_;
+	double last_dot_time_;
 	int InitViewer();
 	void CloseViewer();
 	void ViewerFrame();
 #endif
 	roadmanager::OpenDrive *odr_manager;
 	std::vector<ObjectSensor*> sensor;
+	ObjectGrid sensor_grid;  // object positions, hashed once per frame for all sensors to look up
+	SE_TaskPool sensor_pool;
 	const double maxStepSize;
 	const double minStepSize;
 	SE_Options opt;
@@ -83,6 +92,7 @@ private:
 	bool headless;
 	bool launch_server;
 	double fixed_timestep_;
+	__int64 time_stamp_;  // system time of previous frame
 	int& argc_;
 	char** argv_;
 };
\ No newline at end of file
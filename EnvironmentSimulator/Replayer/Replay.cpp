@@ -17,8 +17,12 @@
 using namespace scenarioengine;
 
 
-Replay::Replay(std::string filename) : time_(0.0), index_(0)
+Replay::Replay(std::string filename) : version_(0), data_start_(0), data_end_(0), time_(0.0), start_time_(0.0), stop_time_(0.0)
 {
+	ReplayFileHeader file_header;
+
+	current_.offset = -1;
+
 	file_.open(filename, std::ofstream::binary);
 	if (file_.fail())
 	{
@@ -26,52 +30,308 @@ Replay::Replay(std::string filename) : time_(0.0), index_(0)
 		throw std::invalid_argument(std::string("Cannot open file: ") + filename);
 	}
 
-	file_.read((char*)&header_, sizeof(header_));
-	LOG("Recording %s opened. odr: %s model: %s", filename.c_str(), header_.odr_filename, header_.model_filename);
+	file_.seekg(0, std::ios::end);
+	data_end_ = file_.tellg();
+	file_.seekg(0);
+
+	file_.read((char*)&file_header, sizeof(file_header));
+	if (!file_.fail() && strncmp(file_header.magic, REPLAY_MAGIC, sizeof(file_header.magic)) == 0)
+	{
+		version_ = file_header.version;
+		if (version_ > REPLAY_VERSION)
+		{
+			LOG("Recording version %d not supported (max %d)", version_, REPLAY_VERSION);
+			throw std::invalid_argument(std::string("Unsupported recording version: ") + filename);
+		}
+		header_ = file_header.header;
+		data_start_ = sizeof(file_header);
+		LOG("Recording %s opened (version %d). odr: %s model: %s", filename.c_str(), version_, header_.odr_filename, header_.model_filename);
+	}
+	else
+	{
+		// No magic string, assume legacy format
+		version_ = 1;
+		file_.clear();
+		file_.seekg(0);
+		file_.read((char*)&header_, sizeof(header_));
+		data_start_ = sizeof(header_);
+		LOG("Recording %s opened (legacy format). odr: %s model: %s", filename.c_str(), header_.odr_filename, header_.model_filename);
+	}
+
+	BuildIndex();
+	GoToTime(start_time_);
+}
+
+Replay::~Replay()
+{
+	file_.close();
+}
+
+void Replay::BuildIndex()
+{
+	ReplayFrameInfo info;
+	std::streamoff offset = data_start_;
+	int n_frames = 0;
+
+	while (ReadFrameInfo(offset, info, true))
+	{
+		if (n_frames % REPLAY_INDEX_INTERVAL == 0)
+		{
+			ReplayIndexEntry entry = { info.time, info.offset };
+			index_.push_back(entry);
+		}
+
+		if (n_frames == 0)
+		{
+			start_time_ = info.time;
+		}
+		stop_time_ = info.time;
+
+		offset = info.next_offset;
+		n_frames++;
+	}
+
+	LOG("Indexed %d frames, time %.2f - %.2f", n_frames, start_time_, stop_time_);
+}
+
+bool Replay::ReadFrameInfo(std::streamoff offset, ReplayFrameInfo &info, bool register_objects)
+{
+	file_.clear();
+	file_.seekg(offset);
 
-	while (!file_.eof())
+	if (version_ == 1)
 	{
+		// Legacy format lacks frames, group consecutive entries with same timestamp
 		ObjectStateStruct data;
 
-		file_.read((char*)&data, sizeof(data));
+		if (!file_.read((char*)&data, sizeof(data)))
+		{
+			return false;
+		}
+		info.time = data.timeStamp;
+		info.n_objects = 1;
+		info.record_size = (int)sizeof(data);
+		info.offset = offset;
+		info.data_offset = offset;
+
+		float time_stamp = data.timeStamp;
+		while (file_.read((char*)&data, sizeof(data)) && data.timeStamp == time_stamp)
+		{
+			info.n_objects++;
+		}
+		info.next_offset = offset + info.n_objects * (std::streamoff)sizeof(data);
+
+		return true;
+	}
+
+	ReplayPacketHeader packet;
+
+	while (file_.read((char*)&packet, sizeof(packet)))
+	{
+		if (packet.type == REPLAY_PACKET_FRAME)
+		{
+			ReplayFrameHeader frame;
+
+			if (!file_.read((char*)&frame, sizeof(frame)))
+			{
+				return false;
+			}
+
+			// Records must fill the packet, and the packet must fit in the file
+			int data_size = packet.size - (int)sizeof(frame);
+			if (data_size < 0 || frame.n_objects < 0 || 
+				(frame.n_objects == 0 && data_size != 0) ||
+				(frame.n_objects > 0 && (data_size % frame.n_objects != 0 || data_size / frame.n_objects < (int)sizeof(ReplayObjectRecord))) ||
+				offset + (std::streamoff)sizeof(packet) + packet.size > data_end_)
+			{
+				LOG("Corrupt frame at file position %lld (size %d, %d objects), ignoring rest of recording", 
+					(long long)offset, packet.size, frame.n_objects);
+				return false;
+			}
 
-		if (!file_.eof())
+			info.time = frame.time;
+			info.n_objects = frame.n_objects;
+			info.record_size = frame.n_objects > 0 ? data_size / frame.n_objects : (int)sizeof(ReplayObjectRecord);
+			info.offset = offset;
+			info.data_offset = offset + sizeof(packet) + sizeof(frame);
+			info.next_offset = offset + sizeof(packet) + packet.size;
+
+			return true;
+		}
+		else if (packet.type == REPLAY_PACKET_OBJECT && register_objects)
 		{
-			data_.push_back(data);
+			ReplayObjectInfo object_info;
+
+			if (packet.size < (int)sizeof(object_info) || !file_.read((char*)&object_info, sizeof(object_info)))
+			{
+				return false;
+			}
+			objects_[object_info.id] = object_info;
 		}
+		else if (packet.size < 0)
+		{
+			LOG("Corrupt packet at file position %lld (size %d), ignoring rest of recording", (long long)offset, packet.size);
+			return false;
+		}
+
+		// Skip to next packet
+		offset += sizeof(packet) + packet.size;
+		file_.seekg(offset);
 	}
+
+	return false;
 }
 
-Replay::~Replay()
+void Replay::LoadFrame(ReplayFrameInfo &info)
 {
-	data_.clear();
+	// Read all records of the frame at once, ReadFrameInfo has checked that they fit in the file
+	buffer_.resize((size_t)info.n_objects * info.record_size);
+	file_.clear();
+	file_.seekg(info.data_offset);
+	if (buffer_.size() > 0 && !file_.read(buffer_.data(), buffer_.size()))
+	{
+		LOG("Failed to read frame at time %.2f", info.time);
+		buffer_.clear();
+	}
+
+	frame_.resize(buffer_.size() / info.record_size);
+
+	for (size_t i = 0; i < frame_.size(); i++)
+	{
+		ObjectStateStruct &data = frame_[i];
+
+		if (version_ == 1)
+		{
+			memcpy(&data, &buffer_[i * info.record_size], sizeof(data));
+			continue;
+		}
+
+		// Any data following the known part of the record is added by later versions, skip it
+		ReplayObjectRecord record;
+		memcpy(&record, &buffer_[i * info.record_size], sizeof(record));
+
+		data.id = record.id;
+		std::unordered_map<int, ReplayObjectInfo>::iterator object = objects_.find(record.id);
+		if (object != objects_.end())
+		{
+			data.model_id = object->second.model_id;
+			data.control = object->second.control;
+			strncpy(data.name, object->second.name, NAME_LEN);
+		}
+		else
+		{
+			data.model_id = 0;
+			data.control = 0;
+			data.name[0] = 0;
+		}
+		data.timeStamp = (float)info.time;
+		data.pos.SetX(record.x);
+		data.pos.SetY(record.y);
+		data.pos.SetZ(record.z);
+		data.pos.SetH(record.h);
+		data.pos.SetP(record.p);
+		data.pos.SetR(record.r);
+		data.pos.SetTrackId(record.road_id);
+		data.pos.SetLaneId(record.lane_id);
+		data.pos.SetS(record.s);
+		data.pos.SetOffset(record.offset);
+		data.speed = record.speed;
+		data.wheel_angle = record.wheel_angle;
+		data.wheel_rot = record.wheel_rot;
+	}
+
+	current_ = info;
 }
 
-void Replay::Step(double dt)
+int Replay::GoToTime(double t)
 {
-	ObjectStateStruct data;
+	ReplayFrameInfo info;
+	ReplayFrameInfo next;
 
-	time_ += dt;
+	if (index_.size() == 0)
+	{
+		return -1;
+	}
+
+	time_ = MIN(MAX(t, start_time_), stop_time_);
 
-	// Find entry according to time 
-	while ((index_ < data_.size() - 1 && time_ > data_[index_ + 1].timeStamp) || data_[index_].id != 0)
+	// Find last index entry not later than requested time
+	size_t lo = 0;
+	size_t hi = index_.size() - 1;
+	while (lo < hi)
 	{
-		index_++;
-		if (index_ >= data_.size() - 1)
+		size_t mid = (lo + hi + 1) / 2;
+		if (index_[mid].time <= time_)
 		{
-			index_ = 0;
-			time_ = 0;
+			lo = mid;
 		}
+		else
+		{
+			hi = mid - 1;
+		}
+	}
+
+	if (current_.offset >= index_[lo].offset && time_ >= current_.time)
+	{
+		// Current frame is already past the index entry and not later than requested time, continue from it
+		info = current_;
+	}
+	else if (!ReadFrameInfo(index_[lo].offset, info))
+	{
+		return -1;
 	}
+
+	// Scan forward to last frame not later than requested time
+	while (ReadFrameInfo(info.next_offset, next) && next.time <= time_)
+	{
+		info = next;
+	}
+
+	if (info.offset != current_.offset)
+	{
+		LoadFrame(info);
+	}
+
+	return 0;
+}
+
+int Replay::NextFrame()
+{
+	ReplayFrameInfo info;
+
+	if (current_.offset < 0 || !ReadFrameInfo(current_.next_offset, info))
+	{
+		return -1;
+	}
+
+	LoadFrame(info);
+	time_ = info.time;
+
+	return 0;
+}
+
+void Replay::Step(double dt)
+{
+	double t = time_ + dt;
+
+	if (t > stop_time_)
+	{
+		t = start_time_;
+	}
+	else if (t < start_time_)
+	{
+		t = stop_time_;
+	}
+
+	GoToTime(t);
 }
 
-ObjectStateStruct* Replay::GetState(int id)
+ObjectStateStruct* Replay::GetState(int idx)
 {
-	// Read all vehicles at current timestamp
-	if (index_ + id > data_.size() - 1 || data_[index_ + id].id != id)
+	if (idx < 0 || idx >= (int)frame_.size())
 	{
 		return 0;
 	}
 
-	return &data_[index_ + id];
+	return &frame_[idx];
 }
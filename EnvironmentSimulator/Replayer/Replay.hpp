@@ -14,6 +14,7 @@
 
 #include <string>
 #include <fstream>
+#include <unordered_map>
 #include "CommonMini.hpp"
 #include "ScenarioGateway.hpp"
 
@@ -21,6 +22,8 @@ namespace scenarioengine
 {
 
 #define REPLAY_FILENAME_SIZE 128
+#define REPLAY_MAGIC "ESMIREC"
+#define REPLAY_VERSION 2
 
 	typedef struct
 	{
@@ -28,21 +31,160 @@ namespace scenarioengine
 		char model_filename[REPLAY_FILENAME_SIZE];
 	} ReplayHeader;
 
+	/*
+	 * Recording file format, version 2 
+	 * 
+	 * The file starts with a ReplayFileHeader, followed by a sequence of packets. Each packet 
+	 * starts with a ReplayPacketHeader specifying type and payload size, so unknown packet types 
+	 * can be skipped. 
+	 *   REPLAY_PACKET_OBJECT: One ReplayObjectInfo, written once per object before its first state
+	 *   REPLAY_PACKET_FRAME:  One ReplayFrameHeader followed by n_objects records of equal size. The 
+	 *                         record size is given by the packet size. Readers use the leading 
+	 *                         ReplayObjectRecord part of each record, so records may grow in later versions.
+	 * All structs are laid out without padding, see static asserts below. Values are stored in native 
+	 * (little endian) byte order.
+	 *
+	 * Version 1 (legacy) files, lacking the magic string, consist of a ReplayHeader followed by 
+	 * raw ObjectStateStruct entries. These are only readable by the same build that wrote them.
+	 */
 
+	typedef enum
+	{
+		REPLAY_PACKET_OBJECT = 1,
+		REPLAY_PACKET_FRAME = 2
+	} ReplayPacketType;
+
+	typedef struct
+	{
+		char magic[8];		// REPLAY_MAGIC
+		int version;		// REPLAY_VERSION
+		int reserved;
+		ReplayHeader header;
+	} ReplayFileHeader;
+	static_assert(sizeof(ReplayFileHeader) == 16 + 2 * REPLAY_FILENAME_SIZE, "ReplayFileHeader must not be padded");
 
+	typedef struct
+	{
+		int type;			// ReplayPacketType
+		int size;			// size of payload following this header, in bytes
+	} ReplayPacketHeader;
+	static_assert(sizeof(ReplayPacketHeader) == 8, "ReplayPacketHeader must not be padded");
+
+	typedef struct
+	{
+		int id;
+		int model_id;
+		int control;
+		char name[NAME_LEN];
+	} ReplayObjectInfo;
+	static_assert(sizeof(ReplayObjectInfo) == 12 + NAME_LEN, "ReplayObjectInfo must not be padded");
+
+	typedef struct
+	{
+		double time;
+		int n_objects;
+		int reserved;
+	} ReplayFrameHeader;
+	static_assert(sizeof(ReplayFrameHeader) == 16, "ReplayFrameHeader must not be padded");
+
+	typedef struct
+	{
+		double x;
+		double y;
+		double z;
+		double s;
+		float h;
+		float p;
+		float r;
+		float offset;
+		float speed;
+		float wheel_angle;
+		float wheel_rot;
+		int id;
+		int road_id;
+		int lane_id;
+	} ReplayObjectRecord;
+	static_assert(sizeof(ReplayObjectRecord) == 72, "ReplayObjectRecord must not be padded");
+
+#define REPLAY_INDEX_INTERVAL 32  // number of frames between sparse index entries
+
+	typedef struct
+	{
+		double time;
+		std::streamoff offset;	// file position of the frame
+	} ReplayIndexEntry;
+
+	typedef struct
+	{
+		double time;
+		int n_objects;
+		int record_size;			// size of each object record, in bytes
+		std::streamoff offset;		// file position of the frame
+		std::streamoff data_offset;	// file position of first object record
+		std::streamoff next_offset;	// file position following the frame
+	} ReplayFrameInfo;
+
+	/*
+	 * Replay reads recordings frame by frame directly from file. On open the file is scanned once,
+	 * only reading frame headers, to build a sparse time index. Only the current frame is kept
+	 * in memory, so memory usage does not depend on recording length. Seeking to any time is a
+	 * binary search in the index followed by a short forward scan.
+	 */
 	class Replay
 	{
 	public:
 		Replay(std::string filename);
 		~Replay();
+
+		/**
+		Move playhead given time. Negative value steps backwards. Wraps around at either end.
+		@param dt delta time (s)
+		*/
 		void Step(double dt);
-		ObjectStateStruct * GetState(int id);
+
+		/**
+		Move playhead to specified time, clamped to the recording time span
+		@param t time (s)
+		@return 0 on success, -1 if recording is empty
+		*/
+		int GoToTime(double t);
+
+		/**
+		Move playhead to the first frame following the current one
+		@return 0 on success, -1 if at the end of the recording
+		*/
+		int NextFrame();
+
+		/**
+		Retrieve object state of the current frame
+		@param idx index of object within the frame, 0 to GetNumberOfObjects() - 1
+		@return pointer to the state, 0 if index out of range
+		*/
+		ObjectStateStruct * GetState(int idx);
+		int GetNumberOfObjects() { return (int)frame_.size(); }
+		double GetTime() { return time_; }
+		double GetStartTime() { return start_time_; }
+		double GetStopTime() { return stop_time_; }
 
 		ReplayHeader header_;
-		std::vector<ObjectStateStruct> data_;
+		int version_;
+
+	private:
+		bool ReadFrameInfo(std::streamoff offset, ReplayFrameInfo &info, bool register_objects = false);
+		void LoadFrame(ReplayFrameInfo &info);
+		void BuildIndex();
+
 		std::ifstream file_;
+		std::streamoff data_start_;					// file position of first frame
+		std::streamoff data_end_;					// file size
+		std::vector<ReplayIndexEntry> index_;		// every REPLAY_INDEX_INTERVAL frame
+		std::unordered_map<int, ReplayObjectInfo> objects_;	// object table of version 2 recordings, by id
+		std::vector<char> buffer_;					// object records of the frame being loaded
+		std::vector<ObjectStateStruct> frame_;		// object states of current frame
+		ReplayFrameInfo current_;
 		double time_;
-		unsigned int index_;
+		double start_time_;
+		double stop_time_;
 	};
 
 }
\ No newline at end of file
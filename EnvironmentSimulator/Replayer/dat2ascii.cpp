@@ -45,25 +45,28 @@ int main(int argc, char** argv)
 	fprintf(stdout, "OpenDRIVE: %s, 3DModel: %s\n", player->header_.odr_filename, player->header_.model_filename);
 	fprintf(stdout, "timestamp, id, name, x, y, z, h, p, r, speed, wheel_angle, wheel_rot\n");
 
-	// Then output all entries with comma separated values
-	for (size_t i = 0; i < player->data_.size(); i++)
+	// Then output all entries with comma separated values, frame by frame
+	do
 	{
-		ObjectStateStruct *state = &player->data_[i];
+		for (int i = 0; i < player->GetNumberOfObjects(); i++)
+		{
+			ObjectStateStruct *state = player->GetState(i);
 
-		fprintf(stdout, "%.3f, %d, %s, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f\n",
-			state->timeStamp,
-			state->id,
-			state->name,
-			state->pos.GetX(),
-			state->pos.GetY(),
-			state->pos.GetZ(),
-			state->pos.GetH(),
-			state->pos.GetP(),
-			state->pos.GetR(),
-			state->speed,
-			state->wheel_angle,
-			state->wheel_rot);
-	}
+			fprintf(stdout, "%.3f, %d, %s, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f\n",
+				state->timeStamp,
+				state->id,
+				state->name,
+				state->pos.GetX(),
+				state->pos.GetY(),
+				state->pos.GetZ(),
+				state->pos.GetH(),
+				state->pos.GetP(),
+				state->pos.GetR(),
+				state->speed,
+				state->wheel_angle,
+				state->wheel_rot);
+		}
+	} while (player->NextFrame() == 0);
 
 	delete player;
 }
\ No newline at end of file
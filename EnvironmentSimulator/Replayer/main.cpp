@@ -31,6 +31,7 @@ using namespace scenarioengine;
 static const double stepSize = 0.01;
 static const double maxStepSize = 0.1;
 static const double minStepSize = 0.01;
+static const double seekScale = 10.0;  // fast forward/rewind speed factor
 
 double deltaSimTime;  // external - used by Viewer::RubberBandCamera
 
@@ -81,7 +82,8 @@ int main(int argc, char** argv)
 	SE_Options opt;
 	opt.AddOption("file", "Simulation recording data file", "filename");
 	opt.AddOption("res_path", "Path to resources root folder - relative or absolut", "path");
-	opt.AddOption("time_scale", "Playback speed scale factor (1.0 == normal)", "factor");
+	opt.AddOption("time_scale", "Playback speed scale factor (1.0 == normal, negative == reverse)", "factor");
+	opt.AddOption("start_time", "Start playback at given time", "time");
 
 	if (argc < 2)
 	{
@@ -106,7 +108,7 @@ int main(int argc, char** argv)
 	{
 		std::string odr_path = opt.GetOptionArg("res_path");
 		roadmanager::Position::LoadOpenDrive(odr_path.append("/xodr/").append(player->header_.odr_filename).c_str());
-		odrManager = roadmanager::Position::GetOpenDrive();
+		odrManager = roadmanager::Position::GetDefaultOpenDrive();
 
 		std::string model_path = opt.GetOptionArg("res_path");
 		osg::ArgumentParser arguments(&argc, argv);
@@ -131,6 +133,11 @@ int main(int argc, char** argv)
 			time_scale = atof(opt.GetOptionArg("time_scale").c_str());
 		}
 
+		if (opt.GetOptionSet("start_time"))
+		{
+			player->GoToTime(atof(opt.GetOptionArg("start_time").c_str()));
+		}
+
 		while (!viewer->osgViewer_->done())
 		{
 			// Get milliseconds since Jan 1 1970
@@ -150,7 +157,19 @@ int main(int argc, char** argv)
 			// Time operations
 			simTime = simTime + deltaSimTime;
 
-			player->Step(deltaSimTime * time_scale);
+			// Arrow keys right and left fast forward and rewind respectively
+			if (viewer->getKeyRight())
+			{
+				player->Step(seekScale * deltaSimTime * fabs(time_scale));
+			}
+			else if (viewer->getKeyLeft())
+			{
+				player->Step(-seekScale * deltaSimTime * fabs(time_scale));
+			}
+			else
+			{
+				player->Step(deltaSimTime * time_scale);
+			}
 
 			// Fetch states of scenario objects
 			int index = 0;
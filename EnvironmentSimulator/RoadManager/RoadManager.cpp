@@ -46,9 +46,12 @@
 
 #include <iostream>
 #include <cstring>
-#include <random>
 #include <time.h>
 #include <limits>
+#include <queue>
+#include <algorithm>
+#include <fstream>
+#include <map>
 
 
 #include "RoadManager.hpp"
@@ -56,18 +59,62 @@
 #include "pugixml.hpp"
 #include "CommonMini.hpp"
 
-static std::mt19937 mt_rand;
-
 using namespace std;
 using namespace roadmanager;
 
 #define CURV_ZERO 0.00001
+#define SPIRAL_MAX_ARC_DEVIATION 1e-6  // m, below this distance from an arc a spiral is evaluated as one
 #define MAX(x, y) (y > x ? y : x)
 #define MIN(x, y) (y < x ? y : x)
 #define CLAMP(x, a, b) (MIN(MAX(x, a), b))
-#define MAX_TRACK_DIST 10
+#define GEOM_GRID_CELL_SIZE 50.0  // m
+#define GEOM_GRID_MAX_CELLS 1000000
+#define GEOM_GRID_SAMPLE_DIST 5.0  // m
+#define GEOM_GRID_MARGIN (MAX_TRACK_DIST + 10)  // m, covers the max penalty (3 + 5 + 2) added to the distance in XYZH2TrackPos
+#define SPIRAL_TABLE_MAX_SAMPLES 100000  // per spiral segment
+#define TRAJ_SAMPLE_MAX_ERROR 0.01  // m, max deviation between sampled trajectory and the curve
+#define TRAJ_SAMPLE_MAX_DEPTH 20  // max number of times to halve a segment, bounding number of samples
+#define ODR_CACHE_MAGIC "ESMIODR"
+#define ODR_CACHE_VERSION 1
+#define ODR_CACHE_FILE_EXT ".odrc"
+
+static std::string odr_cache_dir;  // "" = no cache
+
+
+/**
+Find the record valid at s, i.e. the last one starting at or before s. Positions before the first record
+map to the first one. The hint and its successor are checked first, covering the common case of
+stepping along a road, before falling back to binary search.
+@param s_start start s of each record, sorted
+@param s distance along the road
+@param hint index of a record likely to be valid, e.g. the one found in previous lookup. -1 if unknown.
+@return record index, -1 if there are no records
+*/
+static int GetIdxByS(const std::vector<double> &s_start, double s, int hint = -1)
+{
+	int n = (int)s_start.size();
+
+	if (n == 0)
+	{
+		return -1;
+	}
+
+	if (hint >= 0 && hint < n && (hint == 0 || s >= s_start[hint]))
+	{
+		if (hint == n - 1 || s < s_start[hint + 1])
+		{
+			return hint;
+		}
+		else if (hint == n - 2 || s < s_start[hint + 2])
+		{
+			return hint + 1;
+		}
+	}
 
+	int idx = (int)(std::upper_bound(s_start.begin(), s_start.end(), s) - s_start.begin()) - 1;
 
+	return MAX(idx, 0);
+}
 
 double Polynomial::Evaluate(double s)
 {
@@ -155,6 +202,53 @@ void Arc::EvaluateDS(double ds, double *x, double *y, double *h)
 	*h = GetHdg() + angle;
 }
 
+Spiral::Spiral(double s, double x, double y, double hdg, double length, double curv_start, double curv_end) :
+	Geometry(s, x, y, hdg, length, GEOMETRY_TYPE_SPIRAL),
+	curv_start_(curv_start), curv_end_(curv_end), c_dot_(0.0), x0_(0.0), y0_(0.0), h0_(0.0), s0_(0.0), sample_dist_(0.0)
+{
+	// Lateral deviation from an arc at the end is (curv_end - curv_start) * length^2 / 6
+	if (fabs(GetCurvEnd() - GetCurvStart()) * GetLength() * GetLength() / 6 < SPIRAL_MAX_ARC_DEVIATION)
+	{
+		// Constant curvature, no standard spiral to follow. c_dot = 0 makes EvaluateDS treat it as an arc
+		return;
+	}
+
+	if (abs(GetCurvEnd()) > CURV_ZERO && abs(GetCurvStart()) > CURV_ZERO)
+	{
+		// not starting from zero curvature (straight line)
+		// need to calculate S starting value, and rotation 
+
+		// First identify end with lowest curvature
+		double curvature_min;
+		if (abs(GetCurvStart()) < abs(GetCurvEnd()))
+		{
+			curvature_min = GetCurvStart();
+		}
+		else
+		{
+			curvature_min = GetCurvEnd();
+		}
+
+		// How long do we need to follow the spiral to reach min curve value?
+		double c_dot = (GetCurvEnd() - GetCurvStart()) / GetLength();
+		double ds = curvature_min / c_dot;
+
+		// Find out x, y, heading of start position
+		double x, y, heading;
+		odrSpiral(ds, c_dot, &x, &y, &heading);
+
+		SetX0(x);
+		SetY0(y);
+		SetH0(heading);
+		SetS0(ds);
+		SetCDot(c_dot);
+	}
+	else
+	{
+		SetCDot((GetCurvEnd() - GetCurvStart()) / GetLength());
+	}
+}
+
 void Spiral::Print()
 {
 	LOG("Spiral x: %.2f, y: %.2f, h: %.2f start curvature: %.4f end curvature: %.4f length: %.2f\n",
@@ -165,6 +259,47 @@ void Spiral::EvaluateDS(double ds, double *x, double *y, double *h)
 {
 	double xTmp, yTmp, t, curv_a, curv_b, h_start;
 
+	if (sample_.size() > 0)
+	{
+		// Cubic Hermite interpolation between samples, tangent given by the heading at each sample
+		double u = ds / sample_dist_;
+		int i = CLAMP((int)u, 0, (int)sample_.size() - 2);
+		u -= i;
+
+		double u2 = u * u;
+		double u3 = u2 * u;
+		double h00 = 2 * u3 - 3 * u2 + 1;
+		double h10 = (u3 - 2 * u2 + u) * sample_dist_;
+		double h01 = -2 * u3 + 3 * u2;
+		double h11 = (u3 - u2) * sample_dist_;
+		Sample *s0 = &sample_[i];
+		Sample *s1 = &sample_[i + 1];
+
+		*x = h00 * s0->x + h10 * s0->cos_h + h01 * s1->x + h11 * s1->cos_h;
+		*y = h00 * s0->y + h10 * s0->sin_h + h01 * s1->y + h11 * s1->sin_h;
+		*h = EvaluateHeadingDS(ds);
+
+		return;
+	}
+
+	if (GetCDot() == 0.0)
+	{
+		// Constant curvature
+		double curv = 0.5 * (GetCurvStart() + GetCurvEnd());
+		*h = GetHdg() + ds * curv;
+		if (fabs(curv) < SMALL_NUMBER)
+		{
+			*x = GetX() + ds * cos(GetHdg());
+			*y = GetY() + ds * sin(GetHdg());
+		}
+		else
+		{
+			*x = GetX() + (sin(*h) - sin(GetHdg())) / curv;
+			*y = GetY() - (cos(*h) - cos(GetHdg())) / curv;
+		}
+		return;
+	}
+
 	curv_a = GetCurvStart();
 	curv_b = GetCurvEnd();
 	h_start = GetHdg();
@@ -204,11 +339,70 @@ void Spiral::EvaluateDS(double ds, double *x, double *y, double *h)
 	*y = GetY() + x2 * sin(h_start) + y2 * cos(h_start);
 }
 
+double Spiral::EvaluateHeadingDS(double ds)
+{
+	// Same as EvaluateDS, heading of the standard spiral given by t = s^2 * c_dot / 2
+	if (GetCDot() == 0.0)
+	{
+		return GetHdg() + ds * 0.5 * (GetCurvStart() + GetCurvEnd());
+	}
+	else if (abs(GetCurvEnd()) > abs(GetCurvStart()))
+	{
+		double s = ds + GetS0();
+		return s * s * GetCDot() * 0.5 + GetHdg() - GetH0();
+	}
+	else
+	{
+		double s0 = GetS0() + GetLength();
+		double s1 = s0 - ds;
+		return (s1 * s1 - s0 * s0) * GetCDot() * 0.5 + GetHdg() - GetH0();
+	}
+}
+
 double Spiral::EvaluateCurvatureDS(double ds)
 {
 	return (curv_start_ + (ds / GetLength())* (curv_end_ - curv_start_));
 }
 
+int Spiral::CreateSampleTable(double max_error)
+{
+	ClearSampleTable();
+
+	if (GetLength() < SMALL_NUMBER || max_error < SMALL_NUMBER)
+	{
+		return 0;
+	}
+
+	// Cubic Hermite interpolation, using exact tangents, has an error bounded by h^4 / 384 * max|p(4)|
+	// For a clothoid the fourth derivative |p(4)| <= k^3 + 3 * k * |c_dot|, k being max absolute curvature
+	double k = MAX(fabs(curv_start_), fabs(curv_end_));
+	double d4_max = k * k * k + 3 * k * fabs(c_dot_);
+	double h = GetLength();
+
+	if (d4_max > 0.0)
+	{
+		h = MIN(h, pow(384 * max_error / d4_max, 0.25));
+	}
+
+	int n_samples = MIN((int)ceil(GetLength() / h), SPIRAL_TABLE_MAX_SAMPLES - 1) + 1;
+	std::vector<Sample> samples(n_samples);
+	double dist = GetLength() / (n_samples - 1);
+
+	// Evaluate exactly, i.e. before the table is registered
+	for (int i = 0; i < n_samples; i++)
+	{
+		double heading;
+		EvaluateDS(i * dist, &samples[i].x, &samples[i].y, &heading);
+		samples[i].cos_h = cos(heading);
+		samples[i].sin_h = sin(heading);
+	}
+
+	sample_.swap(samples);
+	sample_dist_ = dist;
+
+	return n_samples;
+}
+
 void Poly3::Print()
 {
 	LOG("Poly3 x: %.2f, y: %.2f, h: %.2f length: %.2f a: %.2f b: %.2f c: %.2f d: %.2f\n",
@@ -273,14 +467,8 @@ LaneWidth *Lane::GetWidthByS(double s)
 	{
 		return 0;  // No lanewidth defined
 	}
-	for (int i=0; i+1<(int)lane_width_.size(); i++)
-	{
-		if (s < lane_width_[i + 1]->GetSOffset())
-		{
-			return lane_width_[i];
-		}
-	}
-	return lane_width_.back();
+
+	return lane_width_[GetIdxByS(lane_width_s_, s)];
 }
 
 LaneLink *Lane::GetLink(LinkType type)
@@ -372,40 +560,12 @@ LaneSection* Road::GetLaneSectionByIdx(int idx)
 
 int Road::GetLaneSectionIdxByS(double s, int start_at)
 {
-	if (start_at < 0 || start_at > lane_section_.size() - 1)
+	if (start_at < 0 || start_at >= (int)lane_section_.size())
 	{
 		return -1;
 	}
 
-	LaneSection *lane_section = lane_section_[start_at];
-	size_t i = start_at;
-
-	if (s < lane_section->GetS() && start_at > 0)  
-	{
-		// Look backwards
-		for (i = start_at - 1; i > 0; i--)  // No need to check the first one
-		{
-			lane_section = GetLaneSectionByIdx((int)i);
-			if (s > lane_section->GetS())
-			{
-				break;
-			}
-		}
-	}
-	else  
-	{
-		// look forward
-		for (i = start_at; i < GetNumberOfLaneSections()-1; i++) // No need to check the last one 
-		{
-			lane_section = GetLaneSectionByIdx((int)i);
-			if (s < lane_section->GetS() + lane_section->GetLength())
-			{
-				break;
-			}
-		}
-	}
-
-	return (int)i;
+	return GetIdxByS(lane_section_s_, s, start_at);
 }
 
 LaneInfo Road::GetLaneInfoByS(double s, int start_lane_section_idx, int start_lane_id)
@@ -469,13 +629,10 @@ double Road::GetLaneWidthByS(double s, int lane_id)
 		return 0.0;
 	}
 
-	for (size_t i = 0; i < GetNumberOfLaneSections(); i++)
+	lsec = GetLaneSectionByS(s);
+	if (s < lsec->GetS() + lsec->GetLength())
 	{
-		lsec = GetLaneSectionByIdx((int)i);
-		if (s < lsec->GetS() + lsec->GetLength())
-		{
-			return lsec->GetWidth(s, lane_id);
-		}
+		return lsec->GetWidth(s, lane_id);
 	}
 
 	return 0.0;
@@ -485,10 +642,7 @@ double Road::GetSpeedByS(double s)
 {
 	if (type_.size() > 0)
 	{
-		size_t i;
-		for (i = 0; i < type_.size() - 1 && s > type_[i + 1]->s_; i++);
-
-		return type_[i]->speed_;
+		return type_[GetIdxByS(type_s_, s)]->speed_;
 	}
 
 	// No type entries, fall back to a speed based on nr of lanes
@@ -527,14 +681,9 @@ Lane* LaneSection::GetLaneByIdx(int idx)
 
 Lane* LaneSection::GetLaneById(int id)
 {
-	for (size_t i=0; i<lane_.size(); i++)
-	{
-		if (lane_[i]->GetId() == id)
-		{
-			return lane_[i];
-		}
-	}
-	return 0;
+	int idx = GetLaneIdxById(id);
+
+	return idx < 0 ? 0 : lane_[idx];
 }
 
 int LaneSection::FindClosestDrivingLane(int id)
@@ -572,14 +721,14 @@ int LaneSection::GetLaneIdByIdx(int idx)
 
 int LaneSection::GetLaneIdxById(int id)
 {
-	for (int i = 0; i<(int)lane_.size(); i++)
+	int i = id - min_lane_id_;
+
+	if (i < 0 || i >= (int)lane_idx_by_id_.size())
 	{
-		if (lane_[i]->GetId() == id)
-		{
-			return i;
-		}
+		return -1;
 	}
-	return -1;
+
+	return lane_idx_by_id_[i];
 }
 
 int LaneSection::GetNumberOfDrivingLanes()
@@ -752,6 +901,26 @@ double LaneSection::GetCenterOffsetHeading(double s, int lane_id)
 void LaneSection::AddLane(Lane *lane)
 {
 	lane_.push_back(lane);
+
+	// Lane ids are consecutive, so a table spanning them is small
+	int id = lane->GetId();
+	if (lane_idx_by_id_.size() == 0)
+	{
+		min_lane_id_ = id;
+	}
+	else if (id < min_lane_id_)
+	{
+		lane_idx_by_id_.insert(lane_idx_by_id_.begin(), min_lane_id_ - id, -1);
+		min_lane_id_ = id;
+	}
+	if (id - min_lane_id_ >= (int)lane_idx_by_id_.size())
+	{
+		lane_idx_by_id_.resize(id - min_lane_id_ + 1, -1);
+	}
+	if (lane_idx_by_id_[id - min_lane_id_] == -1)
+	{
+		lane_idx_by_id_[id - min_lane_id_] = (int)lane_.size() - 1;
+	}
 }
 
 int LaneSection::GetConnectingLaneId(int incoming_lane_id, LinkType link_type)
@@ -892,40 +1061,6 @@ void Road::AddArc(Arc *arc)
 
 void Road::AddSpiral(Spiral *spiral)
 {
-	if (abs(spiral->GetCurvEnd()) > CURV_ZERO && abs(spiral->GetCurvStart()) > CURV_ZERO)
-	{
-		// not starting from zero curvature (straight line)
-		// need to calculate S starting value, and rotation 
-
-		// First identify end with lowest curvature
-		double curvature_min;
-		if (abs(spiral->GetCurvStart()) < abs(spiral->GetCurvEnd()))
-		{
-			curvature_min = spiral->GetCurvStart();
-		}
-		else
-		{
-			curvature_min = spiral->GetCurvEnd();
-		}
-
-		// How long do we need to follow the spiral to reach min curve value?
-		double c_dot = (spiral->GetCurvEnd() - spiral->GetCurvStart()) / spiral->GetLength();
-		double ds = curvature_min / c_dot;
-
-		// Find out x, y, heading of start position
-		double x, y, heading;
-		odrSpiral(ds, c_dot, &x, &y, &heading);
-
-		spiral->SetX0(x);
-		spiral->SetY0(y);
-		spiral->SetH0(heading);
-		spiral->SetS0(ds);
-		spiral->SetCDot(c_dot);
-	}
-	else
-	{
-		spiral->SetCDot((spiral->GetCurvEnd() - spiral->GetCurvStart()) / spiral->GetLength());
-	}
 	geometry_.push_back((Geometry*)spiral);
 }
 
@@ -969,6 +1104,7 @@ void Road::AddElevation(Elevation *elevation)
 	elevation->SetLength(length_ - elevation->GetS());
 
 	elevation_profile_.push_back((Elevation*)elevation);
+	elevation_s_.push_back(elevation->GetS());
 }
 
 Elevation* Road::GetElevation(int idx)
@@ -983,40 +1119,22 @@ Elevation* Road::GetElevation(int idx)
 
 double Road::GetLaneOffset(double s)
 {
-	int i = 0;
-
 	if (lane_offset_.size() == 0)
 	{
 		return 0;
 	}
 
-	for (; i + 1 < (int)lane_offset_.size(); i++)
-	{
-		if (s < lane_offset_[i + 1]->GetS())
-		{
-			break;
-		}
-	}
-	return (lane_offset_[i]->GetLaneOffset(s));
+	return (lane_offset_[GetIdxByS(lane_offset_s_, s)]->GetLaneOffset(s));
 }
 
 double Road::GetLaneOffsetPrim(double s)
 {
-	int i = 0;
-
 	if (lane_offset_.size() == 0)
 	{
 		return 0;
 	}
 
-	for (; i + 1 < (int)lane_offset_.size(); i++)
-	{
-		if (s < lane_offset_[i + 1]->GetS())
-		{
-			break;
-		}
-	}
-	return (lane_offset_[i]->GetLaneOffsetPrim(s));
+	return (lane_offset_[GetIdxByS(lane_offset_s_, s)]->GetLaneOffsetPrim(s));
 }
 
 int Road::GetNumberOfLanes(double s)
@@ -1131,6 +1249,7 @@ void Road::AddLaneOffset(LaneOffset *lane_offset)
 	lane_offset->SetLength(length_ - lane_offset->GetS());
 	
 	lane_offset_.push_back((LaneOffset*)lane_offset);
+	lane_offset_s_.push_back(lane_offset->GetS());
 }
 
 double Road::GetCenterOffset(double s, int lane_id)
@@ -1168,48 +1287,21 @@ void Road::AddLaneSection(LaneSection *lane_section)
 	lane_section->SetLength(length_ - lane_section->GetS());
 
 	lane_section_.push_back((LaneSection*)lane_section);
+	lane_section_s_.push_back(lane_section->GetS());
 }
 
 bool Road::GetZAndPitchByS(double s, double *z, double *pitch, int *index)
 {
 	if (GetNumberOfElevations() > 0)
 	{
-		if (*index < 0 || *index >= GetNumberOfElevations())
-		{
-			*index = 0;
-		}
+		*index = GetIdxByS(elevation_s_, s, *index);
 		Elevation *elevation = GetElevation(*index);
-		if (elevation == NULL)
-		{
-			LOG("Elevation error NULL, nelev: %d elev_idx: %d\n", GetNumberOfElevations(), *index);
-			return false;
-		}
-
-		if (elevation && s > elevation->GetS() + elevation->GetLength())
-		{
-			while (s > elevation->GetS() + elevation->GetLength() && *index < GetNumberOfElevations() - 1)
-			{
-				// Move to next elevation section
-				elevation = GetElevation(++*index);
-			}
-		}
-		else if (elevation && s < elevation->GetS())
-		{
-			while (s < elevation->GetS() && *index > 0)
-			{
-				// Move to previous elevation section
-				elevation = GetElevation(--*index);
-			}
-		}
 
-		if (elevation)
-		{
-			double p = s - elevation->GetS();
-			*z = elevation->poly3_.Evaluate(p);
-			*pitch = -elevation->poly3_.EvaluatePrim(p);
+		double p = s - elevation->GetS();
+		*z = elevation->poly3_.Evaluate(p);
+		*pitch = -elevation->poly3_.EvaluatePrim(p);
 
-			return true;
-		}
+		return true;
 	}
 
 	return false;
@@ -1217,6 +1309,12 @@ bool Road::GetZAndPitchByS(double s, double *z, double *pitch, int *index)
 
 Road* OpenDrive::GetRoadById(int id)
 {
+	if (id_index_valid_)
+	{
+		std::unordered_map<int, int>::iterator it = road_idx_by_id_.find(id);
+		return it != road_idx_by_id_.end() ? road_[it->second] : 0;
+	}
+
 	for (size_t i=0; i<road_.size(); i++)
 	{
 		if (road_[i]->GetId() == id)
@@ -1253,6 +1351,12 @@ Geometry *OpenDrive::GetGeometryByIdx(int road_idx, int geom_idx)
 
 Junction* OpenDrive::GetJunctionById(int id)
 {
+	if (id_index_valid_)
+	{
+		std::unordered_map<int, int>::iterator it = junction_idx_by_id_.find(id);
+		return it != junction_idx_by_id_.end() ? junction_[it->second] : 0;
+	}
+
 	for (size_t i=0; i<junction_.size(); i++)
 	{
 		if (junction_[i]->GetId() == id)
@@ -1276,7 +1380,7 @@ Junction *OpenDrive::GetJunctionByIdx(int idx)
 	}
 }
 
-OpenDrive::OpenDrive(const char *filename)
+OpenDrive::OpenDrive(const char *filename, bool spiral_tables) : spiral_tables_(spiral_tables), id_index_valid_(false)
 {
 	if (!LoadOpenDriveFile(filename))
 	{
@@ -1287,7 +1391,7 @@ OpenDrive::OpenDrive(const char *filename)
 
 bool OpenDrive::LoadOpenDriveFile(const char *filename, bool replace)
 {
-	mt_rand.seed((unsigned int)time(0));
+	id_index_valid_ = false;
 
 	if (replace)
 	{
@@ -1311,6 +1415,58 @@ bool OpenDrive::LoadOpenDriveFile(const char *filename, bool replace)
 		return false;
 	}
 
+	unsigned long long hash = 0;
+	std::string cache_filename = GetCacheFilename(filename, hash);
+
+	if (cache_filename == "" || !ReadCache(cache_filename, hash))
+	{
+		int first_road = (int)road_.size();
+		int first_junction = (int)junction_.size();
+
+		if (!ParseOpenDriveXML(filename))
+		{
+			return false;
+		}
+
+		if (cache_filename != "")
+		{
+			WriteCache(cache_filename, hash, first_road, first_junction);
+		}
+	}
+
+	// CheckConnections();
+
+	if (spiral_tables_)
+	{
+		SetSpiralTables(true);
+	}
+
+	BuildIdIndex();
+	geometry_grid_.Build(this, GEOM_GRID_MARGIN);
+	road_graph_.Build(this);
+
+	return true;
+}
+
+void OpenDrive::BuildIdIndex()
+{
+	road_idx_by_id_.clear();
+	for (int i = 0; i < (int)road_.size(); i++)
+	{
+		road_idx_by_id_.insert(std::make_pair(road_[i]->GetId(), i));
+	}
+
+	junction_idx_by_id_.clear();
+	for (int i = 0; i < (int)junction_.size(); i++)
+	{
+		junction_idx_by_id_.insert(std::make_pair(junction_[i]->GetId(), i));
+	}
+
+	id_index_valid_ = true;
+}
+
+bool OpenDrive::ParseOpenDriveXML(const char *filename)
+{
 	pugi::xml_document doc;
 	pugi::xml_parse_result result = doc.load_file(filename);
 	if (!result)
@@ -1777,48 +1933,732 @@ bool OpenDrive::LoadOpenDriveFile(const char *filename, bool replace)
 		junction_.push_back(j);
 	}
 
-	// CheckConnections();
-
 	return true;
 }
 
-Connection::Connection(Road* incoming_road, Road *connecting_road, ContactPointType contact_point)
+void OpenDrive::SetSpiralTables(bool value)
 {
-	// Find corresponding road objects
-	incoming_road_ = incoming_road;
-	connecting_road_ = connecting_road;
-	contact_point_ = contact_point;
-}
+	spiral_tables_ = value;
 
-Connection::~Connection()
-{ 
-	for (size_t i=0; i<lane_link_.size(); i++) 
+	for (size_t i = 0; i < road_.size(); i++)
 	{
-		delete lane_link_[i];
+		for (int j = 0; j < road_[i]->GetNumberOfGeometries(); j++)
+		{
+			Geometry *geom = road_[i]->GetGeometry(j);
+			if (geom->GetType() == Geometry::GEOMETRY_TYPE_SPIRAL)
+			{
+				if (value)
+				{
+					((Spiral*)geom)->CreateSampleTable(SPIRAL_TABLE_MAX_ERROR);
+				}
+				else
+				{
+					((Spiral*)geom)->ClearSampleTable();
+				}
+			}
+		}
 	}
 }
 
-void Connection::AddJunctionLaneLink(int from, int to)
+void OpenDrive::SetCacheDir(std::string dirname)
 {
-	lane_link_.push_back(new JunctionLaneLink(from, to));
+	odr_cache_dir = dirname;
 }
 
-int Connection::GetConnectingLaneId(int incoming_lane_id)
+std::string OpenDrive::GetCacheDir()
 {
-	for (size_t i = 0; i < lane_link_.size(); i++)
-	{
-		if (lane_link_[i]->from_ == incoming_lane_id)
-		{
-			return lane_link_[i]->to_;
-		}
-	}
-	return 0;
+	return odr_cache_dir;
 }
 
-void Connection::Print()
+// Compiled road network file layout: The header followed by one table per record type. Each table is
+// stored as number of records followed by the records. Records refer to their children by count only,
+// children being stored in the same order as their parents.
+
+typedef struct
 {
-	LOG("Connection: incoming %d connecting %d\n", incoming_road_->GetId(), connecting_road_->GetId());
-	for (size_t i = 0; i < lane_link_.size(); i++)
+	char magic[8];  // ODR_CACHE_MAGIC
+	int version;    // ODR_CACHE_VERSION
+	int reserved;
+	unsigned long long hash;  // of the OpenDRIVE file content
+} OdrCacheHeader;
+
+typedef struct
+{
+	double length;
+	int id;
+	int junction;
+	int name;  // offset into string table
+	int n_types;
+	int n_links;
+	int n_geometries;
+	int n_elevations;
+	int n_lane_offsets;
+	int n_lane_sections;
+	int reserved;
+} OdrCacheRoad;
+
+typedef struct
+{
+	double s;
+	double speed;
+	int road_type;
+	int reserved;
+} OdrCacheRoadType;
+
+typedef struct
+{
+	int type;
+	int element_type;
+	int element_id;
+	int contact_point;
+} OdrCacheRoadLink;
+
+typedef struct
+{
+	double s;
+	double x;
+	double y;
+	double hdg;
+	double length;
+	double p[8];  // type specific parameters, e.g. curvature or polynomial coefficients
+	int type;
+	int p_range;
+} OdrCacheGeometry;
+
+typedef struct
+{
+	double s;  // start or sOffset of polynomial
+	double a;
+	double b;
+	double c;
+	double d;
+} OdrCachePoly3;
+
+typedef struct
+{
+	double s;
+	int n_lanes;
+	int reserved;
+} OdrCacheLaneSection;
+
+typedef struct
+{
+	int id;
+	int type;
+	int n_links;
+	int n_widths;
+} OdrCacheLane;
+
+typedef struct
+{
+	int type;
+	int id;
+} OdrCacheLaneLink;
+
+typedef struct
+{
+	int id;
+	int name;  // offset into string table
+	int n_connections;
+} OdrCacheJunction;
+
+typedef struct
+{
+	int incoming_road_id;
+	int connecting_road_id;
+	int roads_missing;  // bit 0: no incoming road, bit 1: no connecting road
+	int contact_point;
+	int n_lane_links;
+} OdrCacheConnection;
+
+typedef struct
+{
+	int from;
+	int to;
+} OdrCacheJunctionLaneLink;
+
+typedef struct
+{
+	std::vector<OdrCacheRoad> road;
+	std::vector<OdrCacheRoadType> road_type;
+	std::vector<OdrCacheRoadLink> road_link;
+	std::vector<OdrCacheGeometry> geometry;
+	std::vector<OdrCachePoly3> elevation;
+	std::vector<OdrCachePoly3> lane_offset;
+	std::vector<OdrCacheLaneSection> lane_section;
+	std::vector<OdrCacheLane> lane;
+	std::vector<OdrCacheLaneLink> lane_link;
+	std::vector<OdrCachePoly3> lane_width;
+	std::vector<OdrCacheJunction> junction;
+	std::vector<OdrCacheConnection> connection;
+	std::vector<OdrCacheJunctionLaneLink> junction_lane_link;
+	std::vector<char> strings;
+} OdrCacheTables;
+
+template <class T> static void WriteCacheTable(std::ofstream &file, std::vector<T> &table)
+{
+	int n = (int)table.size();
+
+	file.write((char*)&n, sizeof(n));
+	if (n > 0)
+	{
+		file.write((char*)table.data(), n * sizeof(T));
+	}
+}
+
+template <class T> static bool ReadCacheTable(std::ifstream &file, std::vector<T> &table, size_t file_size)
+{
+	int n = 0;
+
+	file.read((char*)&n, sizeof(n));
+	if (file.fail() || n < 0 || n * sizeof(T) > file_size)
+	{
+		return false;
+	}
+
+	table.resize(n);
+	if (n > 0)
+	{
+		file.read((char*)table.data(), n * sizeof(T));
+	}
+
+	return !file.fail();
+}
+
+static int AddCacheString(std::vector<char> &strings, std::string str)
+{
+	int offset = (int)strings.size();
+
+	strings.insert(strings.end(), str.c_str(), str.c_str() + str.size() + 1);
+
+	return offset;
+}
+
+static void AddCachePoly3(std::vector<OdrCachePoly3> &table, double s, Polynomial *poly)
+{
+	OdrCachePoly3 rec;
+
+	rec.s = s;
+	rec.a = poly->GetA();
+	rec.b = poly->GetB();
+	rec.c = poly->GetC();
+	rec.d = poly->GetD();
+	table.push_back(rec);
+}
+
+std::string OpenDrive::GetCacheFilename(const char *filename, unsigned long long &hash)
+{
+	if (odr_cache_dir == "")
+	{
+		return "";
+	}
+
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		return "";  // leave to the XML parser to report or resolve
+	}
+
+	size_t size = (size_t)file.tellg();
+	std::vector<char> content(size);
+	file.seekg(0);
+	file.read(content.data(), size);
+	if (file.fail())
+	{
+		return "";
+	}
+
+	// 64 bit FNV-1a, applied on 8 byte words for speed
+	hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i += 8)
+	{
+		unsigned long long word = 0;
+		memcpy(&word, &content[i], MIN(8, size - i));
+		hash ^= word;
+		hash *= 1099511628211ULL;
+	}
+
+	std::string name = FileNameOf(filename);
+	name = name.substr(0, name.find_last_of('.'));
+
+	char hash_str[32];
+	snprintf(hash_str, sizeof(hash_str), "_%016llx", hash);
+
+	return odr_cache_dir + "/" + name + hash_str + ODR_CACHE_FILE_EXT;
+}
+
+bool OpenDrive::WriteCache(std::string cache_filename, unsigned long long hash, int first_road, int first_junction)
+{
+	OdrCacheTables t;
+
+	for (size_t i = first_road; i < road_.size(); i++)
+	{
+		Road *r = road_[i];
+		OdrCacheRoad road;
+
+		road.id = r->GetId();
+		road.junction = r->GetJunction();
+		road.length = r->GetLength();
+		road.name = AddCacheString(t.strings, r->GetName());
+		road.n_types = r->GetNumberOfRoadTypes();
+		road.n_links = 0;
+		road.n_geometries = r->GetNumberOfGeometries();
+		road.n_elevations = r->GetNumberOfElevations();
+		road.n_lane_offsets = r->GetNumberOfLaneOffsets();
+		road.n_lane_sections = r->GetNumberOfLaneSections();
+		road.reserved = 0;
+
+		for (int j = 0; j < r->GetNumberOfRoadTypes(); j++)
+		{
+			OdrCacheRoadType type;
+			type.s = r->GetRoadType(j)->s_;
+			type.speed = r->GetRoadType(j)->speed_;
+			type.road_type = r->GetRoadType(j)->road_type_;
+			type.reserved = 0;
+			t.road_type.push_back(type);
+		}
+
+		// Same order as when parsed
+		LinkType link_types[] = { SUCCESSOR, PREDECESSOR };
+		for (int j = 0; j < 2; j++)
+		{
+			RoadLink *l = r->GetLink(link_types[j]);
+			if (l)
+			{
+				OdrCacheRoadLink link;
+				link.type = l->GetType();
+				link.element_type = l->GetElementType();
+				link.element_id = l->GetElementId();
+				link.contact_point = l->GetContactPointType();
+				t.road_link.push_back(link);
+				road.n_links++;
+			}
+		}
+
+		for (int j = 0; j < r->GetNumberOfGeometries(); j++)
+		{
+			Geometry *g = r->GetGeometry(j);
+			OdrCacheGeometry geom;
+
+			memset(&geom, 0, sizeof(geom));
+			geom.s = g->GetS();
+			geom.x = g->GetX();
+			geom.y = g->GetY();
+			geom.hdg = g->GetHdg();
+			geom.length = g->GetLength();
+			geom.type = g->GetType();
+
+			if (g->GetType() == Geometry::GEOMETRY_TYPE_ARC)
+			{
+				geom.p[0] = ((Arc*)g)->GetCurvature();
+			}
+			else if (g->GetType() == Geometry::GEOMETRY_TYPE_SPIRAL)
+			{
+				geom.p[0] = ((Spiral*)g)->GetCurvStart();
+				geom.p[1] = ((Spiral*)g)->GetCurvEnd();
+			}
+			else if (g->GetType() == Geometry::GEOMETRY_TYPE_POLY3)
+			{
+				Polynomial *poly = &((Poly3*)g)->poly3_;
+				geom.p[0] = poly->GetA();
+				geom.p[1] = poly->GetB();
+				geom.p[2] = poly->GetC();
+				geom.p[3] = poly->GetD();
+			}
+			else if (g->GetType() == Geometry::GEOMETRY_TYPE_PARAM_POLY3)
+			{
+				Polynomial *poly_u = &((ParamPoly3*)g)->poly3U_;
+				Polynomial *poly_v = &((ParamPoly3*)g)->poly3V_;
+				geom.p[0] = poly_u->GetA();
+				geom.p[1] = poly_u->GetB();
+				geom.p[2] = poly_u->GetC();
+				geom.p[3] = poly_u->GetD();
+				geom.p[4] = poly_v->GetA();
+				geom.p[5] = poly_v->GetB();
+				geom.p[6] = poly_v->GetC();
+				geom.p[7] = poly_v->GetD();
+				geom.p_range = ((ParamPoly3*)g)->GetPRange();
+			}
+			t.geometry.push_back(geom);
+		}
+
+		for (int j = 0; j < r->GetNumberOfElevations(); j++)
+		{
+			AddCachePoly3(t.elevation, r->GetElevation(j)->GetS(), &r->GetElevation(j)->poly3_);
+		}
+
+		for (int j = 0; j < r->GetNumberOfLaneOffsets(); j++)
+		{
+			AddCachePoly3(t.lane_offset, r->GetLaneOffsetByIdx(j)->GetS(), r->GetLaneOffsetByIdx(j)->GetPolynomial());
+		}
+
+		for (int j = 0; j < r->GetNumberOfLaneSections(); j++)
+		{
+			LaneSection *ls = r->GetLaneSectionByIdx(j);
+			OdrCacheLaneSection lane_section;
+
+			lane_section.s = ls->GetS();
+			lane_section.n_lanes = ls->GetNumberOfLanes();
+			lane_section.reserved = 0;
+			t.lane_section.push_back(lane_section);
+
+			for (int k = 0; k < ls->GetNumberOfLanes(); k++)
+			{
+				Lane *l = ls->GetLaneByIdx(k);
+				OdrCacheLane lane;
+
+				lane.id = l->GetId();
+				lane.type = l->GetType();
+				lane.n_links = l->GetNumberOfLinks();
+				lane.n_widths = l->GetNumberOfLaneWidths();
+				t.lane.push_back(lane);
+
+				for (int m = 0; m < l->GetNumberOfLinks(); m++)
+				{
+					OdrCacheLaneLink link;
+					link.type = l->GetLinkByIdx(m)->GetType();
+					link.id = l->GetLinkByIdx(m)->GetId();
+					t.lane_link.push_back(link);
+				}
+
+				for (int m = 0; m < l->GetNumberOfLaneWidths(); m++)
+				{
+					AddCachePoly3(t.lane_width, l->GetWidthByIndex(m)->GetSOffset(), &l->GetWidthByIndex(m)->poly3_);
+				}
+			}
+		}
+
+		t.road.push_back(road);
+	}
+
+	for (size_t i = first_junction; i < junction_.size(); i++)
+	{
+		Junction *j = junction_[i];
+		OdrCacheJunction junction;
+
+		junction.id = j->GetId();
+		junction.name = AddCacheString(t.strings, j->GetName());
+		junction.n_connections = j->GetNumberOfConnections();
+		t.junction.push_back(junction);
+
+		for (int k = 0; k < j->GetNumberOfConnections(); k++)
+		{
+			Connection *c = j->GetConnectionByIdx(k);
+			OdrCacheConnection connection;
+
+			connection.incoming_road_id = c->GetIncomingRoad() ? c->GetIncomingRoad()->GetId() : 0;
+			connection.connecting_road_id = c->GetConnectingRoad() ? c->GetConnectingRoad()->GetId() : 0;
+			connection.roads_missing = (c->GetIncomingRoad() ? 0 : 1) | (c->GetConnectingRoad() ? 0 : 2);
+			connection.contact_point = c->GetContactPoint();
+			connection.n_lane_links = c->GetNumberOfLaneLinks();
+			t.connection.push_back(connection);
+
+			for (int m = 0; m < c->GetNumberOfLaneLinks(); m++)
+			{
+				OdrCacheJunctionLaneLink lane_link;
+				lane_link.from = c->GetLaneLink(m)->from_;
+				lane_link.to = c->GetLaneLink(m)->to_;
+				t.junction_lane_link.push_back(lane_link);
+			}
+		}
+	}
+
+	// Write to a temporary file first, so that concurrent loaders never see a partial cache file
+	char tmp_id[64];
+	snprintf(tmp_id, sizeof(tmp_id), ".%p_%lld.tmp", (void*)this, (long long)SE_getSystemTime());
+	std::string tmp_filename = cache_filename + tmp_id;
+	std::ofstream file(tmp_filename, std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG("Failed to create road network cache file %s", tmp_filename.c_str());
+		return false;
+	}
+
+	OdrCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	strncpy(header.magic, ODR_CACHE_MAGIC, sizeof(header.magic));
+	header.version = ODR_CACHE_VERSION;
+	header.hash = hash;
+	file.write((char*)&header, sizeof(header));
+
+	WriteCacheTable(file, t.road);
+	WriteCacheTable(file, t.road_type);
+	WriteCacheTable(file, t.road_link);
+	WriteCacheTable(file, t.geometry);
+	WriteCacheTable(file, t.elevation);
+	WriteCacheTable(file, t.lane_offset);
+	WriteCacheTable(file, t.lane_section);
+	WriteCacheTable(file, t.lane);
+	WriteCacheTable(file, t.lane_link);
+	WriteCacheTable(file, t.lane_width);
+	WriteCacheTable(file, t.junction);
+	WriteCacheTable(file, t.connection);
+	WriteCacheTable(file, t.junction_lane_link);
+	WriteCacheTable(file, t.strings);
+
+	bool failed = file.fail();
+	file.close();
+
+	if (failed || rename(tmp_filename.c_str(), cache_filename.c_str()) != 0)
+	{
+		// On some platforms rename fails if target exists, e.g. written by another process meanwhile
+		LOG("Failed to write road network cache file %s", cache_filename.c_str());
+		remove(tmp_filename.c_str());
+		return false;
+	}
+
+	LOG("Road network cache written to %s", cache_filename.c_str());
+
+	return true;
+}
+
+bool OpenDrive::ReadCache(std::string cache_filename, unsigned long long hash)
+{
+	std::ifstream file(cache_filename, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	size_t file_size = (size_t)file.tellg();
+	file.seekg(0);
+
+	OdrCacheHeader header;
+	file.read((char*)&header, sizeof(header));
+	if (file.fail() || strncmp(header.magic, ODR_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != ODR_CACHE_VERSION || header.hash != hash)
+	{
+		LOG("Road network cache file %s not valid, ignoring", cache_filename.c_str());
+		return false;
+	}
+
+	// Read all tables, and check consistency, before creating any road network objects
+	OdrCacheTables t;
+	if (!ReadCacheTable(file, t.road, file_size) ||
+		!ReadCacheTable(file, t.road_type, file_size) ||
+		!ReadCacheTable(file, t.road_link, file_size) ||
+		!ReadCacheTable(file, t.geometry, file_size) ||
+		!ReadCacheTable(file, t.elevation, file_size) ||
+		!ReadCacheTable(file, t.lane_offset, file_size) ||
+		!ReadCacheTable(file, t.lane_section, file_size) ||
+		!ReadCacheTable(file, t.lane, file_size) ||
+		!ReadCacheTable(file, t.lane_link, file_size) ||
+		!ReadCacheTable(file, t.lane_width, file_size) ||
+		!ReadCacheTable(file, t.junction, file_size) ||
+		!ReadCacheTable(file, t.connection, file_size) ||
+		!ReadCacheTable(file, t.junction_lane_link, file_size) ||
+		!ReadCacheTable(file, t.strings, file_size))
+	{
+		LOG("Road network cache file %s truncated, ignoring", cache_filename.c_str());
+		return false;
+	}
+
+	size_t n[6] = { 0, 0, 0, 0, 0, 0 };  // types, links, geometries, elevations, lane offsets, lane sections
+	size_t n_lanes = 0, n_lane_links = 0, n_widths = 0, n_connections = 0, n_junction_lane_links = 0;
+	bool valid = t.strings.size() == 0 || t.strings.back() == 0;
+
+	for (size_t i = 0; valid && i < t.road.size(); i++)
+	{
+		n[0] += t.road[i].n_types;
+		n[1] += t.road[i].n_links;
+		n[2] += t.road[i].n_geometries;
+		n[3] += t.road[i].n_elevations;
+		n[4] += t.road[i].n_lane_offsets;
+		n[5] += t.road[i].n_lane_sections;
+		valid = t.road[i].name >= 0 && t.road[i].name < (int)t.strings.size();
+	}
+	for (size_t i = 0; valid && i < t.lane_section.size(); i++)
+	{
+		n_lanes += t.lane_section[i].n_lanes;
+	}
+	for (size_t i = 0; valid && i < t.lane.size(); i++)
+	{
+		n_lane_links += t.lane[i].n_links;
+		n_widths += t.lane[i].n_widths;
+	}
+	for (size_t i = 0; valid && i < t.junction.size(); i++)
+	{
+		n_connections += t.junction[i].n_connections;
+		valid = t.junction[i].name >= 0 && t.junction[i].name < (int)t.strings.size();
+	}
+	for (size_t i = 0; valid && i < t.connection.size(); i++)
+	{
+		n_junction_lane_links += t.connection[i].n_lane_links;
+	}
+
+	if (!valid || n[0] != t.road_type.size() || n[1] != t.road_link.size() || n[2] != t.geometry.size() ||
+		n[3] != t.elevation.size() || n[4] != t.lane_offset.size() || n[5] != t.lane_section.size() ||
+		n_lanes != t.lane.size() || n_lane_links != t.lane_link.size() || n_widths != t.lane_width.size() ||
+		n_connections != t.connection.size() || n_junction_lane_links != t.junction_lane_link.size())
+	{
+		LOG("Road network cache file %s inconsistent, ignoring", cache_filename.c_str());
+		return false;
+	}
+
+	OdrCacheRoadType *road_type = t.road_type.data();
+	OdrCacheRoadLink *road_link = t.road_link.data();
+	OdrCacheGeometry *geom = t.geometry.data();
+	OdrCachePoly3 *elevation = t.elevation.data();
+	OdrCachePoly3 *lane_offset = t.lane_offset.data();
+	OdrCacheLaneSection *lane_section = t.lane_section.data();
+	OdrCacheLane *lane = t.lane.data();
+	OdrCacheLaneLink *lane_link = t.lane_link.data();
+	OdrCachePoly3 *lane_width = t.lane_width.data();
+
+	for (size_t i = 0; i < t.road.size(); i++)
+	{
+		Road *r = new Road(t.road[i].id, &t.strings[t.road[i].name]);
+		r->SetLength(t.road[i].length);
+		r->SetJunction(t.road[i].junction);
+
+		for (int j = 0; j < t.road[i].n_types; j++, road_type++)
+		{
+			RoadTypeEntry *r_type = new RoadTypeEntry();
+			r_type->s_ = road_type->s;
+			r_type->speed_ = road_type->speed;
+			r_type->road_type_ = (RoadType)road_type->road_type;
+			r->AddRoadType(r_type);
+		}
+
+		for (int j = 0; j < t.road[i].n_links; j++, road_link++)
+		{
+			r->AddLink(new RoadLink((LinkType)road_link->type, (RoadLink::ElementType)road_link->element_type,
+				road_link->element_id, (ContactPointType)road_link->contact_point));
+		}
+
+		for (int j = 0; j < t.road[i].n_geometries; j++, geom++)
+		{
+			switch (geom->type)
+			{
+			case Geometry::GEOMETRY_TYPE_LINE:
+				r->AddLine(new Line(geom->s, geom->x, geom->y, geom->hdg, geom->length));
+				break;
+			case Geometry::GEOMETRY_TYPE_ARC:
+				r->AddArc(new Arc(geom->s, geom->x, geom->y, geom->hdg, geom->length, geom->p[0]));
+				break;
+			case Geometry::GEOMETRY_TYPE_SPIRAL:
+				r->AddSpiral(new Spiral(geom->s, geom->x, geom->y, geom->hdg, geom->length, geom->p[0], geom->p[1]));
+				break;
+			case Geometry::GEOMETRY_TYPE_POLY3:
+				r->AddPoly3(new Poly3(geom->s, geom->x, geom->y, geom->hdg, geom->length,
+					geom->p[0], geom->p[1], geom->p[2], geom->p[3]));
+				break;
+			case Geometry::GEOMETRY_TYPE_PARAM_POLY3:
+				r->AddParamPoly3(new ParamPoly3(geom->s, geom->x, geom->y, geom->hdg, geom->length,
+					geom->p[0], geom->p[1], geom->p[2], geom->p[3], geom->p[4], geom->p[5], geom->p[6], geom->p[7],
+					(ParamPoly3::PRangeType)geom->p_range));
+				break;
+			default:
+				LOG("Unexpected geometry type %d in road network cache", geom->type);
+			}
+		}
+
+		for (int j = 0; j < t.road[i].n_elevations; j++, elevation++)
+		{
+			r->AddElevation(new Elevation(elevation->s, elevation->a, elevation->b, elevation->c, elevation->d));
+		}
+
+		for (int j = 0; j < t.road[i].n_lane_offsets; j++, lane_offset++)
+		{
+			r->AddLaneOffset(new LaneOffset(lane_offset->s, lane_offset->a, lane_offset->b, lane_offset->c, lane_offset->d));
+		}
+
+		for (int j = 0; j < t.road[i].n_lane_sections; j++, lane_section++)
+		{
+			LaneSection *ls = new LaneSection(lane_section->s);
+			r->AddLaneSection(ls);
+
+			for (int k = 0; k < lane_section->n_lanes; k++, lane++)
+			{
+				Lane *l = new Lane(lane->id, (Lane::LaneType)lane->type);
+				ls->AddLane(l);
+
+				for (int m = 0; m < lane->n_links; m++, lane_link++)
+				{
+					l->AddLink(new LaneLink((LinkType)lane_link->type, lane_link->id));
+				}
+
+				for (int m = 0; m < lane->n_widths; m++, lane_width++)
+				{
+					l->AddLaneWIdth(new LaneWidth(lane_width->s, lane_width->a, lane_width->b, lane_width->c, lane_width->d));
+				}
+			}
+		}
+
+		road_.push_back(r);
+	}
+
+	// Junction connections may refer to any loaded road, not only the ones from this file
+	std::map<int, Road*> road_by_id;
+	for (int i = (int)road_.size() - 1; i >= 0; i--)
+	{
+		road_by_id[road_[i]->GetId()] = road_[i];  // first road of any duplicate id, as GetRoadById()
+	}
+
+	OdrCacheConnection *connection = t.connection.data();
+	OdrCacheJunctionLaneLink *junction_lane_link = t.junction_lane_link.data();
+
+	for (size_t i = 0; i < t.junction.size(); i++)
+	{
+		Junction *j = new Junction(t.junction[i].id, &t.strings[t.junction[i].name]);
+
+		for (int k = 0; k < t.junction[i].n_connections; k++, connection++)
+		{
+			Road *incoming_road = (connection->roads_missing & 1) ? 0 : road_by_id[connection->incoming_road_id];
+			Road *connecting_road = (connection->roads_missing & 2) ? 0 : road_by_id[connection->connecting_road_id];
+			Connection *c = new Connection(incoming_road, connecting_road, (ContactPointType)connection->contact_point);
+
+			for (int m = 0; m < connection->n_lane_links; m++, junction_lane_link++)
+			{
+				c->AddJunctionLaneLink(junction_lane_link->from, junction_lane_link->to);
+			}
+			j->AddConnection(c);
+		}
+		junction_.push_back(j);
+	}
+
+	LOG("Road network loaded from cache %s", cache_filename.c_str());
+
+	return true;
+}
+
+Connection::Connection(Road* incoming_road, Road *connecting_road, ContactPointType contact_point)
+{
+	// Find corresponding road objects
+	incoming_road_ = incoming_road;
+	connecting_road_ = connecting_road;
+	contact_point_ = contact_point;
+}
+
+Connection::~Connection()
+{ 
+	for (size_t i=0; i<lane_link_.size(); i++) 
+	{
+		delete lane_link_[i];
+	}
+}
+
+void Connection::AddJunctionLaneLink(int from, int to)
+{
+	lane_link_.push_back(new JunctionLaneLink(from, to));
+}
+
+int Connection::GetConnectingLaneId(int incoming_lane_id)
+{
+	for (size_t i = 0; i < lane_link_.size(); i++)
+	{
+		if (lane_link_[i]->from_ == incoming_lane_id)
+		{
+			return lane_link_[i]->to_;
+		}
+	}
+	return 0;
+}
+
+void Connection::Print()
+{
+	LOG("Connection: incoming %d connecting %d\n", incoming_road_->GetId(), connecting_road_->GetId());
+	for (size_t i = 0; i < lane_link_.size(); i++)
 	{
 		lane_link_[i]->Print();
 	}
@@ -2111,132 +2951,424 @@ int RoadPath::Calculate(double &dist)
 		return -1;
 	}
 
-	for (i = 0; i < 100 && !found && unvisited_.size() > 0; i++)
+	for (i = 0; i < 100 && !found && unvisited_.size() > 0; i++)
+	{
+		found = false;
+		
+		// Find unvisited PathNode with shortest distance
+		double minDist = LARGE_NUMBER;
+		int minIndex = 0;
+		for (size_t j = 0; j < unvisited_.size(); j++)
+		{
+			if (unvisited_[j]->dist < minDist)
+			{
+				minIndex = (int)j;
+				minDist = unvisited_[j]->dist;
+			}
+		}
+
+		link = unvisited_[minIndex]->link;
+		tmpDist = unvisited_[minIndex]->dist;
+		pivotRoad = unvisited_[minIndex]->fromRoad;
+
+		// - Inspect all unvisited neighbor nodes (links), measure edge (road) distance to that link
+		// - Note the total distance 
+		// - If not already in invisited list, put it there. 
+		// - Update distance to this link if shorter than previously registered value
+		if (link->GetElementType() == RoadLink::ElementType::ELEMENT_TYPE_ROAD)
+		{
+			// only one edge (road)
+			nextRoad = odr->GetRoadById(link->GetElementId());
+
+			if (nextRoad == targetRoad)
+			{
+				// Special case: On same road, distance is equal to delta s, direction considered
+				if (link->GetContactPointType() == ContactPointType::CONTACT_POINT_START)
+				{
+					tmpDist += targetPos_->GetS();
+				}
+				else
+				{
+					tmpDist += nextRoad->GetLength() - targetPos_->GetS();
+				}
+				
+				found = true;
+			}
+			else
+			{
+				CheckRoad(nextRoad, unvisited_[minIndex], pivotRoad);
+			}
+		}
+		else if (link->GetElementType() == RoadLink::ElementType::ELEMENT_TYPE_JUNCTION)
+		{
+			// check all outgoing edges (connecting roads) from the link (junction)
+			junction = odr->GetJunctionById(link->GetElementId());
+			for (size_t j = 0; j < junction->GetNoConnectionsFromRoadId(pivotRoad->GetId()); j++)
+			{
+				Road * nextRoad = odr->GetRoadById(junction->GetConnectingRoadIdFromIncomingRoadId(pivotRoad->GetId(), (int)j));
+				if (nextRoad == 0)
+				{
+					return 0;
+				}
+
+				if (nextRoad == targetRoad)
+				{
+					// Special case: On same road, distance is equal to delta s
+					tmpDist += targetPos_->GetS();
+					found = true;
+				}
+				else
+				{ 
+					CheckRoad(nextRoad, unvisited_[minIndex], pivotRoad);
+				}
+			}
+		}
+		
+		// Mark pivot link as visited (move it from unvisited to visited)
+		visited_.push_back(unvisited_[minIndex]);
+		unvisited_.erase(unvisited_.begin() + minIndex);
+	}
+
+	if (found)
+	{
+		// Find out whether the path goes forward or backwards from starting position
+		if (visited_.size() > 0)
+		{
+			RoadPath::PathNode* node = visited_.back();
+
+			while (node)
+			{
+				if (node->previous == 0)
+				{
+					// This is the first node - inspect whether it is in front or behind start position
+					if ((node->link == startRoad->GetLink(LinkType::PREDECESSOR) && 
+						abs(startPos_->GetHRelative()) > M_PI_2 && abs(startPos_->GetHRelative()) < 3 * M_PI / 2) ||
+						((node->link == startRoad->GetLink(LinkType::SUCCESSOR) &&
+						abs(startPos_->GetHRelative()) < M_PI_2 || abs(startPos_->GetHRelative()) > 3 * M_PI / 2)))
+					{
+						direction_ = 1;
+					}
+					else
+					{
+						direction_ = -1;
+					}
+				}
+				node = node->previous;
+			}
+		}
+	}
+
+	dist = direction_ * tmpDist;
+
+	return found ? 0 : -1;
+}
+
+
+RoadPath::~RoadPath()
+{
+	for (size_t i = 0; i < visited_.size(); i++)
+	{
+		delete(visited_[i]);
+	}
+	visited_.clear();
+
+	for (size_t i = 0; i < unvisited_.size(); i++)
+	{
+		delete(unvisited_[i]);
+	}
+	unvisited_.clear();
+}
+
+static double GetRoadHalfWidth(Road *road, double s)
+{
+	LaneSection *lsec;
+
+	if (road->GetNumberOfLaneSections() == 0 || (lsec = road->GetLaneSectionByS(s)) == 0)
+	{
+		return 0.0;
+	}
+
+	int min_id = 0;
+	int max_id = 0;
+	for (int i = 0; i < lsec->GetNumberOfLanes(); i++)
+	{
+		min_id = MIN(min_id, lsec->GetLaneIdByIdx(i));
+		max_id = MAX(max_id, lsec->GetLaneIdByIdx(i));
+	}
+
+	double left_width = max_id != 0 ? lsec->GetOuterOffset(s, max_id) : 0.0;
+	double right_width = min_id != 0 ? lsec->GetOuterOffset(s, min_id) : 0.0;
+
+	return fmax(left_width, right_width) + fabs(road->GetLaneOffset(s));
+}
+
+void GeometryGrid::Clear()
+{
+	cell_.clear();
+	margin_ = 0;
+	n_cols_ = 0;
+	n_rows_ = 0;
+}
+
+void GeometryGrid::Build(OpenDrive *odr, double margin)
+{
+	typedef struct
+	{
+		double x;
+		double y;
+		double w;
+	} GeomSample;
+
+	std::vector<std::vector<GeomSample> > samples;
+	std::vector<GeometryRef> refs;
+	double x_max = -LARGE_NUMBER;
+	double y_max = -LARGE_NUMBER;
+
+	Clear();
+	margin_ = margin;
+	x_min_ = LARGE_NUMBER;
+	y_min_ = LARGE_NUMBER;
+
+	// Sample reference line and road width along all geometries, establish extent of the road network
+	for (int i = 0; i < odr->GetNumOfRoads(); i++)
+	{
+		Road *road = odr->GetRoadByIdx(i);
+
+		for (int j = 0; j < road->GetNumberOfGeometries(); j++)
+		{
+			Geometry *geom = road->GetGeometry(j);
+			int n_samples = MAX(1, (int)ceil(geom->GetLength() / GEOM_GRID_SAMPLE_DIST));
+			std::vector<GeomSample> geom_samples;
+
+			for (int k = 0; k < n_samples + 1; k++)
+			{
+				GeomSample sample;
+				double ds = k * geom->GetLength() / n_samples;
+				double h;
+
+				geom->EvaluateDS(ds, &sample.x, &sample.y, &h);
+				sample.w = GetRoadHalfWidth(road, geom->GetS() + ds) + margin;
+
+				x_min_ = MIN(x_min_, sample.x - sample.w);
+				y_min_ = MIN(y_min_, sample.y - sample.w);
+				x_max = MAX(x_max, sample.x + sample.w);
+				y_max = MAX(y_max, sample.y + sample.w);
+
+				geom_samples.push_back(sample);
+			}
+			samples.push_back(geom_samples);
+
+			GeometryRef ref = { i, j };
+			refs.push_back(ref);
+		}
+	}
+
+	if (samples.size() == 0)
+	{
+		return;
+	}
+
+	// Grow cell size if needed to keep the grid within reasonable memory bounds
+	cell_size_ = GEOM_GRID_CELL_SIZE;
+	do
+	{
+		n_cols_ = (int)((x_max - x_min_) / cell_size_) + 1;
+		n_rows_ = (int)((y_max - y_min_) / cell_size_) + 1;
+		if ((double)n_cols_ * n_rows_ > GEOM_GRID_MAX_CELLS)
+		{
+			cell_size_ *= 2;
+		}
+		else
+		{
+			break;
+		}
+	} while (true);
+
+	cell_.resize(n_cols_ * n_rows_);
+
+	// Register each geometry in all cells overlapped by its sampled polyline, including width
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		for (size_t j = 0; j + 1 < samples[i].size(); j++)
+		{
+			AddSegment(samples[i][j].x, samples[i][j].y, samples[i][j + 1].x, samples[i][j + 1].y,
+				MAX(samples[i][j].w, samples[i][j + 1].w), refs[i]);
+		}
+	}
+}
+
+void GeometryGrid::AddSegment(double x0, double y0, double x1, double y1, double width, GeometryRef ref)
+{
+	int col_min = (int)((MIN(x0, x1) - width - x_min_) / cell_size_);
+	int col_max = (int)((MAX(x0, x1) + width - x_min_) / cell_size_);
+	int row_min = (int)((MIN(y0, y1) - width - y_min_) / cell_size_);
+	int row_max = (int)((MAX(y0, y1) + width - y_min_) / cell_size_);
+
+	col_min = CLAMP(col_min, 0, n_cols_ - 1);
+	col_max = CLAMP(col_max, 0, n_cols_ - 1);
+	row_min = CLAMP(row_min, 0, n_rows_ - 1);
+	row_max = CLAMP(row_max, 0, n_rows_ - 1);
+
+	for (int row = row_min; row <= row_max; row++)
+	{
+		for (int col = col_min; col <= col_max; col++)
+		{
+			std::vector<GeometryRef> &cell = cell_[GetCellIdx(col, row)];
+
+			// Geometries are added in order, so any duplicate will be the last entry
+			if (cell.size() == 0 || cell.back().road_idx_ != ref.road_idx_ || cell.back().geom_idx_ != ref.geom_idx_)
+			{
+				cell.push_back(ref);
+			}
+		}
+	}
+}
+
+const std::vector<GeometryRef> *GeometryGrid::GetCandidates(double x, double y)
+{
+	if (IsEmpty() || x < x_min_ || y < y_min_)
+	{
+		return 0;
+	}
+
+	int col = (int)((x - x_min_) / cell_size_);
+	int row = (int)((y - y_min_) / cell_size_);
+
+	if (col >= n_cols_ || row >= n_rows_ || cell_[GetCellIdx(col, row)].size() == 0)
+	{
+		return 0;
+	}
+
+	return &cell_[GetCellIdx(col, row)];
+}
+
+void RoadGraph::Build(OpenDrive *odr)
+{
+	Clear();
+	serial_++;
+
+	edge_.resize(2 * odr->GetNumOfRoads());
+
+	for (int i = 0; i < odr->GetNumOfRoads(); i++)
 	{
-		found = false;
-		
-		// Find unvisited PathNode with shortest distance
-		double minDist = LARGE_NUMBER;
-		int minIndex = 0;
-		for (size_t j = 0; j < unvisited_.size(); j++)
-		{
-			if (unvisited_[j]->dist < minDist)
-			{
-				minIndex = (int)j;
-				minDist = unvisited_[j]->dist;
-			}
-		}
+		Road *road = odr->GetRoadByIdx(i);
 
-		link = unvisited_[minIndex]->link;
-		tmpDist = unvisited_[minIndex]->dist;
-		pivotRoad = unvisited_[minIndex]->fromRoad;
+		// The road itself, in both directions
+		Edge along = { 2 * i + 1, road->GetLength() };
+		Edge against = { 2 * i, road->GetLength() };
+		edge_[2 * i].push_back(along);
+		edge_[2 * i + 1].push_back(against);
 
-		// - Inspect all unvisited neighbor nodes (links), measure edge (road) distance to that link
-		// - Note the total distance 
-		// - If not already in invisited list, put it there. 
-		// - Update distance to this link if shorter than previously registered value
-		if (link->GetElementType() == RoadLink::ElementType::ELEMENT_TYPE_ROAD)
+		// Links from start (predecessor) and end (successor) of the road
+		for (int end = 0; end < 2; end++)
 		{
-			// only one edge (road)
-			nextRoad = odr->GetRoadById(link->GetElementId());
+			RoadLink *link = road->GetLink(end == 0 ? LinkType::PREDECESSOR : LinkType::SUCCESSOR);
 
-			if (nextRoad == targetRoad)
+			if (link == 0)
 			{
-				// Special case: On same road, distance is equal to delta s, direction considered
-				if (link->GetContactPointType() == ContactPointType::CONTACT_POINT_START)
-				{
-					tmpDist += targetPos_->GetS();
-				}
-				else
-				{
-					tmpDist += nextRoad->GetLength() - targetPos_->GetS();
-				}
-				
-				found = true;
+				continue;
 			}
-			else
+
+			if (link->GetElementType() == RoadLink::ElementType::ELEMENT_TYPE_ROAD)
 			{
-				CheckRoad(nextRoad, unvisited_[minIndex], pivotRoad);
+				int road2_idx = odr->GetTrackIdxById(link->GetElementId());
+				if (road2_idx < 0)
+				{
+					continue;
+				}
+				Edge edge = { 2 * road2_idx + (link->GetContactPointType() == ContactPointType::CONTACT_POINT_END ? 1 : 0), 0.0 };
+				edge_[2 * i + end].push_back(edge);
 			}
-		}
-		else if (link->GetElementType() == RoadLink::ElementType::ELEMENT_TYPE_JUNCTION)
-		{
-			// check all outgoing edges (connecting roads) from the link (junction)
-			junction = odr->GetJunctionById(link->GetElementId());
-			for (size_t j = 0; j < junction->GetNoConnectionsFromRoadId(pivotRoad->GetId()); j++)
+			else if (link->GetElementType() == RoadLink::ElementType::ELEMENT_TYPE_JUNCTION)
 			{
-				Road * nextRoad = odr->GetRoadById(junction->GetConnectingRoadIdFromIncomingRoadId(pivotRoad->GetId(), (int)j));
-				if (nextRoad == 0)
+				Junction *junction = odr->GetJunctionById(link->GetElementId());
+				if (junction == 0)
 				{
-					return 0;
+					continue;
 				}
 
-				if (nextRoad == targetRoad)
+				for (int j = 0; j < junction->GetNumberOfConnections(); j++)
 				{
-					// Special case: On same road, distance is equal to delta s
-					tmpDist += targetPos_->GetS();
-					found = true;
-				}
-				else
-				{ 
-					CheckRoad(nextRoad, unvisited_[minIndex], pivotRoad);
+					Connection *connection = junction->GetConnectionByIdx(j);
+
+					if (connection->GetIncomingRoad() != road || connection->GetConnectingRoad() == 0)
+					{
+						continue;
+					}
+
+					int road2_idx = odr->GetTrackIdxById(connection->GetConnectingRoad()->GetId());
+					if (road2_idx < 0)
+					{
+						continue;
+					}
+					Edge edge = { 2 * road2_idx + (connection->GetContactPoint() == ContactPointType::CONTACT_POINT_END ? 1 : 0), 0.0 };
+					edge_[2 * i + end].push_back(edge);
 				}
 			}
 		}
-		
-		// Mark pivot link as visited (move it from unvisited to visited)
-		visited_.push_back(unvisited_[minIndex]);
-		unvisited_.erase(unvisited_.begin() + minIndex);
 	}
+}
 
-	if (found)
+bool RoadGraph::GetShortestDistances(int from_road_idx, int to_road_idx, double dist[2][2])
+{
+	typedef std::pair<double, int> QueueEntry;  // distance, node
+	bool found = false;
+
+	for (int from_end = 0; from_end < 2; from_end++)
 	{
-		// Find out whether the path goes forward or backwards from starting position
-		if (visited_.size() > 0)
+		dist[from_end][0] = LARGE_NUMBER;
+		dist[from_end][1] = LARGE_NUMBER;
+
+		if (from_road_idx < 0 || to_road_idx < 0 || 2 * MAX(from_road_idx, to_road_idx) + 1 >= (int)edge_.size())
 		{
-			RoadPath::PathNode* node = visited_.back();
+			continue;
+		}
 
-			while (node)
+		// Dijkstra's algorithm https://en.wikipedia.org/wiki/Dijkstra%27s_algorithm
+		std::vector<double> node_dist(edge_.size(), LARGE_NUMBER);
+		std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > queue;
+		int n_reached = 0;
+
+		node_dist[2 * from_road_idx + from_end] = 0;
+		queue.push(QueueEntry(0, 2 * from_road_idx + from_end));
+
+		while (!queue.empty() && n_reached < 2)
+		{
+			QueueEntry entry = queue.top();
+			queue.pop();
+
+			if (entry.first > node_dist[entry.second])
 			{
-				if (node->previous == 0)
-				{
-					// This is the first node - inspect whether it is in front or behind start position
-					if ((node->link == startRoad->GetLink(LinkType::PREDECESSOR) && 
-						abs(startPos_->GetHRelative()) > M_PI_2 && abs(startPos_->GetHRelative()) < 3 * M_PI / 2) ||
-						((node->link == startRoad->GetLink(LinkType::SUCCESSOR) &&
-						abs(startPos_->GetHRelative()) < M_PI_2 || abs(startPos_->GetHRelative()) > 3 * M_PI / 2)))
-					{
-						direction_ = 1;
-					}
-					else
-					{
-						direction_ = -1;
-					}
-				}
-				node = node->previous;
+				continue;  // outdated entry, node already settled
 			}
-		}
-	}
 
-	dist = direction_ * tmpDist;
+			if (entry.second / 2 == to_road_idx)
+			{
+				dist[from_end][entry.second % 2] = entry.first;
+				n_reached++;
+				found = true;
+			}
 
-	return found ? 0 : -1;
-}
+			for (size_t i = 0; i < edge_[entry.second].size(); i++)
+			{
+				Edge &edge = edge_[entry.second][i];
 
+				// Do not pass the from road, path must leave it at the specified end
+				if (edge.node_ / 2 == from_road_idx)
+				{
+					continue;
+				}
 
-RoadPath::~RoadPath()
-{
-	for (size_t i = 0; i < visited_.size(); i++)
-	{
-		delete(visited_[i]);
+				if (entry.first + edge.dist_ < node_dist[edge.node_])
+				{
+					node_dist[edge.node_] = entry.first + edge.dist_;
+					queue.push(QueueEntry(node_dist[edge.node_], edge.node_));
+				}
+			}
+		}
 	}
-	visited_.clear();
 
-	for (size_t i = 0; i < unvisited_.size(); i++)
-	{
-		delete(unvisited_[i]);
-	}
-	unvisited_.clear();
+	return found;
 }
 
 OpenDrive::~OpenDrive()
@@ -2253,11 +3385,22 @@ OpenDrive::~OpenDrive()
 
 int OpenDrive::GetTrackIdxById(int id)
 {
-	for (int i = 0; i<(int)road_.size(); i++)
+	if (id_index_valid_)
 	{
-		if (road_[i]->GetId() == id)
+		std::unordered_map<int, int>::iterator it = road_idx_by_id_.find(id);
+		if (it != road_idx_by_id_.end())
 		{
-			return i;
+			return it->second;
+		}
+	}
+	else
+	{
+		for (int i = 0; i<(int)road_.size(); i++)
+		{
+			if (road_[i]->GetId() == id)
+			{
+				return i;
+			}
 		}
 	}
 	LOG("OpenDrive::GetTrackIdxById Error: Road id %d not found\n", id);
@@ -2703,6 +3846,7 @@ void Position::Init()
 	s_ = 0.0;
 	s_route_ = 0.0;
 	s_trajectory_ = 0.0;
+	trajectory_seg_idx_ = 0;
 	t_ = 0.0;
 	offset_ = 0.0;
 	x_ = 0.0;
@@ -2728,6 +3872,13 @@ void Position::Init()
 	elevation_idx_ = -1;
 	route_ = 0;
 	trajectory_ = 0;
+	odr_ = GetDefaultOpenDrive();
+
+	for (int i = 0; i < PATH_CACHE_SIZE; i++)
+	{
+		path_cache_[i].graph_ = 0;
+	}
+	path_cache_next_ = 0;
 }
 
 Position::Position()
@@ -2735,6 +3886,12 @@ Position::Position()
 	Init();
 }
 
+Position::Position(OpenDrive *odr)
+{
+	Init();
+	odr_ = odr;
+}
+
 Position::Position(int track_id, double s, double t)
 {
 	Init();
@@ -2766,15 +3923,38 @@ Position::~Position()
 
 bool Position::LoadOpenDrive(const char *filename)
 {
-	return(GetOpenDrive()->LoadOpenDriveFile(filename));
+	return(GetDefaultOpenDrive()->LoadOpenDriveFile(filename));
 }
 
-OpenDrive* Position::GetOpenDrive()
+static thread_local OpenDrive *thread_odr = 0;
+
+OpenDrive* Position::GetDefaultOpenDrive()
 {
 	static OpenDrive od;
+
+	if (thread_odr)
+	{
+		return thread_odr;
+	}
 	return &od; 
 }
 
+void Position::SetThreadOpenDrive(OpenDrive *odr)
+{
+	thread_odr = odr;
+}
+
+OpenDrive* Position::GetThreadOpenDrive()
+{
+	return thread_odr;
+}
+
+void Position::SetOpenDrive(OpenDrive *odr)
+{
+	Init();
+	odr_ = odr;
+}
+
 int LaneSection::GetClosestLaneIdx(double s, double t, double &offset)
 {
 	double min_offset = t;  // Initial offset relates to reference line
@@ -3101,103 +4281,156 @@ void Position::XYZH2TrackPos(double x3, double y3, double z3, double h3, bool al
 	x_ = x3;
 	y_ = y3;
 
-	for (int i = -1; !search_done && i < GetOpenDrive()->GetNumOfRoads(); i++)
-	{
-		if (i == -1)
-		{
-			// First check current road. IF the new point is ON this road, i.e. within drivable lanes, - then don't look further
-			if (current_road)
-			{
-				road = current_road;
-			}
-			else
-			{
-				continue;  // Skip, no current road
-			}
-		}
-		else
-		{
-			if (current_road && i == track_idx_)
-			{
-				continue; // Skip, already checked this one
-			}
-			else
-			{
-				road = GetOpenDrive()->GetRoadByIdx(i);
-			}
-		}
+	// Restrict search to geometries in the vicinity of the point, see GeometryGrid. Roads not registered in 
+	// the grid cell are further away than the grid margin, so if no candidate scores better than that all 
+	// roads are checked, giving the same result as without the grid.
+	GeometryGrid *grid = GetOpenDrive()->GetGeometryGrid();
+	const std::vector<GeometryRef> *candidates = grid->GetCandidates(x3, y3);
 
-		weight = 0;
-		angle = 0;
+	while (true)
+	{
+		size_t next_candidate = 0;  // first candidate of next road to check
+		int n_roads = candidates ? (int)candidates->size() : GetOpenDrive()->GetNumOfRoads();
 
-		// Add resistance to leave current road or directly connected ones 
-		// actual weights are totally unscientific... up to tuning
-		if (current_road && (road == current_road || GetOpenDrive()->IsDirectlyConnected(current_road->GetId(), road->GetId(), angle)))
+		for (int i = -1; !search_done && i < n_roads; i++)
 		{
-			weight = angle;
-			directlyConnected = true;
-		}
-		else
-		{
-			if (directlyConnectedMin) // if already found a directly connected position - add offset distance
-			{
-				weight = 3;
-			}
+			int n_geoms = 0;
+			int n_candidates = 0;
+			const GeometryRef *road_candidates = 0;
 
-			weight += 5;  // For non connected roads add additional "penalty" threshold  
-			directlyConnected = false;
-		}
-		
-		for (int j = -1; j < road->GetNumberOfGeometries(); j++)
-		{
-			if (j == -1)
+			if (i == -1)
 			{
-				if (road == current_road)
+				// First check current road. IF the new point is ON this road, i.e. within drivable lanes, - then don't look further
+				if (current_road)
 				{
-					// If current road, first check current segment
-					geom = road->GetGeometry(geometry_idx_);
+					road = current_road;
 				}
 				else
 				{
-					continue;  // no current road, skip
+					continue;  // Skip, no current road
 				}
 			}
 			else
 			{
-				if (road == current_road && j == geometry_idx_)
+				int road_idx = i;
+
+				if (candidates)
+				{
+					// Next run of candidates, all belonging to the same road
+					if (next_candidate >= candidates->size())
+					{
+						break;
+					}
+					road_candidates = &(*candidates)[next_candidate];
+					road_idx = road_candidates->road_idx_;
+					while (next_candidate < candidates->size() && (*candidates)[next_candidate].road_idx_ == road_idx)
+					{
+						n_candidates++;
+						next_candidate++;
+					}
+				}
+
+				if (current_road && road_idx == track_idx_)
 				{
 					continue; // Skip, already checked this one
 				}
 				else
 				{
-					geom = road->GetGeometry(j); 
+					road = GetOpenDrive()->GetRoadByIdx(road_idx);
 				}
 			}
-			
-			dist = GetDistToTrackGeom(x3, y3, z3, h3, road, geom, inside, sNorm);
-			
-			dist += weight + (inside ? 0 : 2);  // penalty for roads outside projection area
 
-			if (dist < distMin)
+			// Check all geometries of current road, else only the candidates
+			n_geoms = road_candidates ? n_candidates : road->GetNumberOfGeometries();
+
+			weight = 0;
+			angle = 0;
+
+			// Add resistance to leave current road or directly connected ones 
+			// actual weights are totally unscientific... up to tuning
+			if (current_road && (road == current_road || GetOpenDrive()->IsDirectlyConnected(current_road->GetId(), road->GetId(), angle)))
 			{
-				geomMin = geom;
-				directlyConnectedMin = directlyConnected;
-				roadMin = road;
-				sNormMin = CLAMP(sNorm, 0.0, 1.0);
-				distMin = dist;
+				weight = angle;
+				directlyConnected = true;
 			}
+			else
+			{
+				if (directlyConnectedMin) // if already found a directly connected position - add offset distance
+				{
+					weight = 3;
+				}
 
-			// Special case - if point is on current road
-			if (road == current_road)
+				weight += 5;  // For non connected roads add additional "penalty" threshold  
+				directlyConnected = false;
+			}
+		
+			for (int j = -1; j < n_geoms; j++)
 			{
-				if (dist < road->GetLaneWidthByS(sNormMin * geomMin->GetLength(), lane_id_) / 2.0)
+				if (j == -1)
+				{
+					if (road == current_road)
+					{
+						// If current road, first check current segment
+						geom = road->GetGeometry(geometry_idx_);
+					}
+					else
+					{
+						continue;  // no current road, skip
+					}
+				}
+				else
+				{
+					int geom_idx = road_candidates ? road_candidates[j].geom_idx_ : j;
+
+					if (road == current_road && geom_idx == geometry_idx_)
+					{
+						continue; // Skip, already checked this one
+					}
+					else
+					{
+						geom = road->GetGeometry(geom_idx);
+					}
+				}
+			
+				dist = GetDistToTrackGeom(x3, y3, z3, h3, road, geom, inside, sNorm);
+			
+				dist += weight + (inside ? 0 : 2);  // penalty for roads outside projection area
+
+				if (dist < distMin)
+				{
+					geomMin = geom;
+					directlyConnectedMin = directlyConnected;
+					roadMin = road;
+					sNormMin = CLAMP(sNorm, 0.0, 1.0);
+					distMin = dist;
+				}
+
+				// Special case - if point is on current road
+				if (road == current_road)
 				{
-					// If inside drivable lanes boundry, stay on current road
-					search_done = true;
-					break;
+					if (dist < road->GetLaneWidthByS(sNormMin * geomMin->GetLength(), lane_id_) / 2.0)
+					{
+						// If inside drivable lanes boundry, stay on current road
+						search_done = true;
+						break;
+					}
 				}
 			}
 		}
+
+		if (search_done || candidates == 0 || (roadMin != 0 && distMin <= grid->GetMargin()))
+		{
+			break;
+		}
+
+		// Start over, checking all roads
+		candidates = 0;
+		distMin = std::numeric_limits<double>::infinity();
+		geomMin = 0;
+		roadMin = 0;
+		sNormMin = 0;
+		directlyConnectedMin = false;
+		search_done = false;
 	}
 
 	if (roadMin == 0)
@@ -3597,7 +4830,7 @@ int Position::MoveToConnectingRoad(RoadLink *road_link, ContactPointType &contac
 			}
 			else if (strategy == Junction::JunctionStrategyType::RANDOM)
 			{
-				connection_idx = (int)(n_connections * (double)mt_rand() / mt_rand.max());
+				connection_idx = rand_.GetInt(n_connections);
 			}
 		}
 
@@ -3948,11 +5181,13 @@ double Position::GetDrivingDirection()
 
 void Position::CopyRMPos(Position *from)
 {
-	// Preserve route field
+	// Preserve route and random number stream
 	Route *tmp = route_;
+	SE_Random rand = rand_;
 	
 	*this = *from;
 	route_ = tmp;
+	rand_ = rand;
 }
 
 
@@ -4070,38 +5305,109 @@ void Position::SetRoute(Route *route)
 void Position::SetTrajectory(Trajectory* trajectory)
 {
 	trajectory_ = trajectory;
+	trajectory_seg_idx_ = 0;
+}
+
+PathCacheEntry *Position::GetPathDistances(int to_road_id)
+{
+	RoadGraph *graph = GetOpenDrive()->GetRoadGraph();
+
+	for (int i = 0; i < PATH_CACHE_SIZE; i++)
+	{
+		PathCacheEntry *entry = &path_cache_[i];
+		if (entry->graph_ == graph && entry->serial_ == graph->GetSerial() &&
+			entry->from_road_id_ == track_id_ && entry->to_road_id_ == to_road_id)
+		{
+			return entry;
+		}
+	}
+
+	// Not found, calculate and store in the oldest entry
+	PathCacheEntry *entry = &path_cache_[path_cache_next_];
+	path_cache_next_ = (path_cache_next_ + 1) % PATH_CACHE_SIZE;
+
+	graph->GetShortestDistances(GetOpenDrive()->GetTrackIdxById(track_id_), GetOpenDrive()->GetTrackIdxById(to_road_id), entry->dist_);
+	entry->graph_ = graph;
+	entry->serial_ = graph->GetSerial();
+	entry->from_road_id_ = track_id_;
+	entry->to_road_id_ = to_road_id;
+
+	return entry;
 }
 
-bool Position::Delta(Position pos_b, PositionDiff &diff)
+bool Position::Delta(Position &pos_b, PositionDiff &diff)
 {
 	double dist = 0;
-	bool found;
+	bool found = false;
+	bool facing_backward = fabs(GetHRelative()) > M_PI_2 && fabs(GetHRelative()) < 3 * M_PI_2;
+
+	if (GetTrackId() == pos_b.GetTrackId())
+	{
+		// Special case: On same road, distance is equal to delta s
+		dist = pos_b.GetS() - GetS();
 
-	RoadPath *path = new RoadPath(this, &pos_b);
+		if (GetLaneId() < 0)
+		{
+			if (GetHRelative() > M_PI_2 && GetHRelative() < 3 * M_PI_2)
+			{
+				// facing opposite road direction
+				dist *= -1;
+			}
+		}
+		else
+		{
+			// decreasing in lanes with positive IDs
+			dist *= -1;
 
-	if (found = (path->Calculate(dist) == 0))
+			if (GetHRelative() < M_PI_2 || GetHRelative() > 3 * M_PI_2)
+			{
+				// facing along road direction
+				dist *= -1;
+			}
+		}
+		found = true;
+	}
+	else
 	{
-		diff.dLaneId = GetLaneId() - pos_b.GetLaneId();
-		diff.ds = dist;
-		diff.dt = GetT() - pos_b.GetT();
+		Road *road_a = GetOpenDrive()->GetRoadById(GetTrackId());
+		Road *road_b = GetOpenDrive()->GetRoadById(pos_b.GetTrackId());
 
-#if 0   // Change to 1 to print some info on stdout - e.g. for debugging
-		printf("Dist %.2f Path (reversed): %d", dist, pos_b.GetTrackId());
-		if (path->visited_.size() > 0)
+		if (road_a && road_b)
 		{
-			RoadPath::PathNode* node = path->visited_.back();
+			PathCacheEntry *path = GetPathDistances(pos_b.GetTrackId());
+			double dist_min = LARGE_NUMBER;
+			int end_min = 0;
 
-			while (node)
+			// Combine road distances with distances from/to the road ends
+			for (int end_a = 0; end_a < 2; end_a++)
 			{
-				if (node->fromRoad != 0)
+				for (int end_b = 0; end_b < 2; end_b++)
 				{
-					printf(" <- %d", node->fromRoad->GetId());
+					double d = (end_a == 0 ? GetS() : road_a->GetLength() - GetS()) + path->dist_[end_a][end_b] +
+						(end_b == 0 ? pos_b.GetS() : road_b->GetLength() - pos_b.GetS());
+
+					if (d < dist_min)
+					{
+						dist_min = d;
+						end_min = end_a;
+					}
 				}
-				node = node->previous;
+			}
+
+			if (dist_min < LARGE_NUMBER)
+			{
+				// Path leading out from the start (predecessor) of the road is forward if facing opposite road direction
+				dist = ((end_min == 0) == facing_backward) ? dist_min : -dist_min;
+				found = true;
 			}
 		}
-		printf("\n");
-#endif
+	}
+
+	if (found)
+	{
+		diff.dLaneId = GetLaneId() - pos_b.GetLaneId();
+		diff.ds = dist;
+		diff.dt = GetT() - pos_b.GetT();
 	}
 	else
 	{
@@ -4110,8 +5416,6 @@ bool Position::Delta(Position pos_b, PositionDiff &diff)
 		diff.dt = 0;
 	}
 
-	delete path;
-
 	return found;
 }
 
@@ -4581,81 +5885,159 @@ int Position::SetRouteLanePosition(Route *route, double route_s, int laneId, dou
 
 void PolyLine::AddVertex(Position pos, double time)
 {
-	Vertex* v = new Vertex();
-	v->pos_ = pos;
-	v->time_ = time;
+	vertex_.push_back(Vertex());
+	vertex_.back().time = time;
+	SetVertex(vertex_.size() - 1, pos);
+	UpdateS(vertex_.size() - 1);
+	length_ = vertex_.back().s;
+
+	if (pos.GetType() == Position::PositionType::RELATIVE_OBJECT || pos.GetType() == Position::PositionType::RELATIVE_WORLD ||
+		pos.GetType() == Position::PositionType::RELATIVE_LANE)
+	{
+		// Keep the position, to be resolved when the trajectory is used
+		RelativeVertex rel = { vertex_.size() - 1, pos };
+		relative_pos_.push_back(rel);
+	}
+}
+
+void PolyLine::SetVertex(size_t idx, Position &pos)
+{
+	Vertex* v = &vertex_[idx];
+
+	v->x = pos.GetX();
+	v->y = pos.GetY();
+	v->z = pos.GetZ();
+	v->h = pos.GetH();
+	v->p = pos.GetP();
+	v->r = pos.GetR();
+}
+
+void PolyLine::UpdateS(size_t idx)
+{
+	Vertex* v = &vertex_[idx];
+
+	v->s = idx > 0 ? vertex_[idx - 1].s + PointDistance2D(vertex_[idx - 1].x, vertex_[idx - 1].y, v->x, v->y) : 0.0;
+}
+
+void PolyLine::AddVertex(Vertex v)
+{
+	if (vertex_.size() > 0)
+	{
+		Vertex* prev = &vertex_.back();
+		v.h = prev->h + GetAngleDifference(v.h, prev->h);
+		v.s = prev->s + PointDistance2D(prev->x, prev->y, v.x, v.y);
+	}
+	else
+	{
+		v.s = 0.0;
+	}
 	vertex_.push_back(v);
-	if (vertex_.size() > 1)
+	length_ = v.s;
+}
+
+void PolyLine::Freeze()
+{
+	if (relative_pos_.size() == 0)
 	{
-		length_ += PointDistance2D(
-			vertex_[vertex_.size() - 2]->pos_.GetX(),
-			vertex_[vertex_.size() - 2]->pos_.GetY(),
-			vertex_[vertex_.size() - 1]->pos_.GetX(),
-			vertex_[vertex_.size() - 1]->pos_.GetY());
+		return;
+	}
+
+	for (size_t i = 0; i < relative_pos_.size(); i++)
+	{
+		relative_pos_[i].pos.ReleaseRelation();
+		SetVertex(relative_pos_[i].idx, relative_pos_[i].pos);
 	}
+	std::vector<RelativeVertex>().swap(relative_pos_);
+
+	// Resolved vertices may have moved, update accumulated distance
+	for (size_t i = 0; i < vertex_.size(); i++)
+	{
+		UpdateS(i);
+	}
+	length_ = vertex_.size() > 0 ? vertex_.back().s : 0.0;
 }
 
-int Position::MoveTrajectoryDS(double ds)
+int PolyLine::FindSegment(double Vertex::*field, double value, int hint)
 {
-	if (!trajectory_)
+	int n = (int)vertex_.size();
+
+	if (n < 2)
 	{
-		return -1;
+		return 0;
 	}
 
-	if (trajectory_->shape_->type_ == Shape::POLYLINE)
+	// Typically the value has not moved further than to the next segment since last lookup
+	for (int i = MAX(0, hint); i < MIN(hint + 2, n - 1); i++)
 	{
-		PolyLine* pline = (PolyLine*)trajectory_->shape_;
-		if (pline->vertex_.size() == 0)
+		if ((i == 0 || vertex_[i].*field <= value) && value < vertex_[i + 1].*field)
 		{
-			return -1;
+			return i;
 		}
-		SetTrajectoryS(trajectory_, s_trajectory_ + ds);
 	}
-	else
+
+	// Otherwise find first vertex, except the first one, beyond the value
+	int lo = 1;
+	int hi = n;
+	while (lo < hi)
 	{
-		LOG("Trajectory types Clothoid and Nurbs not supported yet");
+		int mid = (lo + hi) / 2;
+		if (value < vertex_[mid].*field)
+		{
+			hi = mid;
+		}
+		else
+		{
+			lo = mid + 1;
+		}
 	}
 
-	return 0;
+	return lo - 1;
+}
+
+int Position::MoveTrajectoryDS(double ds)
+{
+	if (!trajectory_)
+	{
+		return -1;
+	}
+
+	PolyLine* pline = trajectory_->GetPolyLine();
+	if (pline == 0 || pline->vertex_.size() == 0)
+	{
+		return -1;
+	}
+
+	return SetTrajectoryS(trajectory_, s_trajectory_ + ds);
 }
 
 int Position::SetTrajectoryPosByTime(Trajectory* trajectory, double time)
 {
 	double s = 0;
-	double incr_time = 0;
-	double tot_dist = 0;
 
 	// Find out corresponding S-value
-	size_t i = 0;
-	if (trajectory->shape_->type_ == Shape::POLYLINE)
+	PolyLine* pline = trajectory->GetPolyLine();
+	if (pline == 0 || pline->vertex_.size() == 0)
 	{
-		PolyLine* pline = (PolyLine*)trajectory->shape_;
-
-
-		for (i = 0; i < pline->vertex_.size()-1; i++)
-		{
-			double t0 = pline->vertex_[i]->time_;
-			double t1 = pline->vertex_[i+1]->time_;
-			Position* vp0 = &pline->vertex_[i]->pos_;
-			Position* vp1 = &pline->vertex_[i+1]->pos_;
+		return -1;
+	}
 
-			double dist = PointDistance2D(vp0->GetX(), vp0->GetY(), vp1->GetX(), vp1->GetY());
+	int i = pline->FindSegmentByTime(time, trajectory_seg_idx_);
+	PolyLine::Vertex* v0 = &pline->vertex_[i];
 
-			if (time < t1)
-			{
-				double a = (time - t0) / (t1 - t0);
-				s += a * dist;
-				break;
-			}
-			s += dist;
-		}
+	if (i < (int)pline->vertex_.size() - 1)
+	{
+		PolyLine::Vertex* v1 = &pline->vertex_[i + 1];
+		double dt = v1->time - v0->time;
+		double a = dt > SMALL_NUMBER ? (time - v0->time) / dt : 0.0;
+		s = v0->s + a * (v1->s - v0->s);
 	}
 	else
 	{
-		LOG("Trajectory types Clothoid and Nurbs not supported yet");
+		// passed end of trajectory
+		s = v0->s;
 	}
 	
-//	LOG("i %d t %.2f s %.2f", i, time, s);
+//	LOG("t %.2f s %.2f", time, s);
 
 	SetTrajectoryS(trajectory_, s);
 
@@ -4670,68 +6052,41 @@ int Position::SetTrajectoryS(Trajectory* trajectory, double traj_s)
 	}
 
 	s_trajectory_ = traj_s;
-	
-	if (trajectory->shape_->type_ == Shape::POLYLINE)
-	{
-		PolyLine* pline = (PolyLine*)trajectory->shape_;
-		if (pline->vertex_.size() == 0)
-		{
-			return -1;
-		}
-		else if (pline->vertex_.size() == 1)
-		{
-			// Only one vertex 
-			Position* vpos = &pline->vertex_[0]->pos_;
-			SetInertiaPos(vpos->GetX(), vpos->GetY(), vpos->GetZ(), vpos->GetH(), vpos->GetP(), vpos->GetR(), false);
-			
-			return 0;
-		}
 
-		double tot_dist = 0;
-		size_t i;
-		for (i = 0; i < pline->vertex_.size()-1; i++)
-		{
-			Position* vp0 = &pline->vertex_[i]->pos_;
-			Position* vp1 = &pline->vertex_[i+1]->pos_;
-			
-			double dist = PointDistance2D(vp0->GetX(), vp0->GetY(), vp1->GetX(), vp1->GetY());
-			if (traj_s < tot_dist + dist)
-			{
-				// At segment, make a linear interpolation
-				double a = (traj_s - tot_dist) / dist; // a = interpolation factor
-				double x = (1 - a) * vp0->GetX() + a * vp1->GetX();
-				double y = (1 - a) * vp0->GetY() + a * vp1->GetY();
-				double z = (1 - a) * vp0->GetZ() + a * vp1->GetZ();
-
-				SetInertiaPos(
-					(1 - a) * vp0->GetX() + a * vp1->GetX(),
-					(1 - a) * vp0->GetY() + a * vp1->GetY(),
-					(1 - a) * vp0->GetZ() + a * vp1->GetZ(),
-					(1 - a) * vp0->GetH() + a * vp1->GetH(),
-					(1 - a) * vp0->GetP() + a * vp1->GetP(),
-					(1 - a) * vp0->GetR() + a * vp1->GetR(),
-					false);
-				
-				return 0;
-			}
-			tot_dist += dist;
-		}
+	PolyLine* pline = trajectory->GetPolyLine();
+	if (pline == 0 || pline->vertex_.size() == 0)
+	{
+		return -1;
+	}
 
-		if (i == pline->vertex_.size())
-		{
-			// passed length of trajectory, use final vertex
-			Position* vpos = &pline->vertex_.back()->pos_;
-			SetInertiaPos(vpos->GetX(), vpos->GetY(), vpos->GetZ(), vpos->GetH(), vpos->GetP(), vpos->GetR(), false);
+	int i = pline->FindSegmentByS(traj_s, trajectory_seg_idx_);
+	PolyLine::Vertex* v0 = &pline->vertex_[i];
 
-			return 0;
-		}
-	}
-	else
+	if (i == (int)pline->vertex_.size() - 1)
 	{
-		LOG("Trajectory types Clothoid and Nurbs not supported yet");
+		// Only one vertex or passed length of trajectory, use final vertex
+		SetInertiaPos(v0->x, v0->y, v0->z, v0->h, v0->p, v0->r, false);
+
+		return 0;
 	}
 
-	return -1;
+	trajectory_seg_idx_ = i;
+
+	// At segment, make a linear interpolation
+	PolyLine::Vertex* v1 = &pline->vertex_[i + 1];
+	double dist = v1->s - v0->s;
+	double a = dist > SMALL_NUMBER ? (traj_s - v0->s) / dist : 0.0; // a = interpolation factor
+
+	SetInertiaPos(
+		(1 - a) * v0->x + a * v1->x,
+		(1 - a) * v0->y + a * v1->y,
+		(1 - a) * v0->z + a * v1->z,
+		(1 - a) * v0->h + a * v1->h,
+		(1 - a) * v0->p + a * v1->p,
+		(1 - a) * v0->r + a * v1->r,
+		false);
+
+	return 0;
 }
 
 int Position::SetRouteS(Route *route, double route_s)
@@ -4926,29 +6281,290 @@ std::string Route::getName()
 	return name;
 }
 
-void Trajectory::Freeze()
+typedef void (*ShapeEvaluator)(void *shape, double p, PolyLine::Vertex *v);
+
+static double PointSegmentDistance3D(PolyLine::Vertex &p, PolyLine::Vertex &v0, PolyLine::Vertex &v1)
 {
-	if (shape_->type_ == Shape::ShapeType::POLYLINE)
+	double dx = v1.x - v0.x;
+	double dy = v1.y - v0.y;
+	double dz = v1.z - v0.z;
+	double len2 = dx * dx + dy * dy + dz * dz;
+	double a = len2 > SMALL_NUMBER ? CLAMP(((p.x - v0.x) * dx + (p.y - v0.y) * dy + (p.z - v0.z) * dz) / len2, 0.0, 1.0) : 0.0;
+
+	dx = p.x - (v0.x + a * dx);
+	dy = p.y - (v0.y + a * dy);
+	dz = p.z - (v0.z + a * dz);
+
+	return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+static void SubdivideShape(ShapeEvaluator eval, void *shape, double p0, PolyLine::Vertex &v0, double p1, PolyLine::Vertex &v1,
+	int depth, PolyLine *pline)
+{
+	if (depth < TRAJ_SAMPLE_MAX_DEPTH)
 	{
-		PolyLine* pline = (PolyLine*)shape_;
-		
-		pline->length_ = 0;
+		PolyLine::Vertex vm;
+		double pm = (p0 + p1) / 2;
 
-		for (size_t i = 0; i < pline->vertex_.size(); i++)
+		eval(shape, pm, &vm);
+		if (PointSegmentDistance3D(vm, v0, v1) > TRAJ_SAMPLE_MAX_ERROR)
 		{
-			pline->vertex_[i]->pos_.ReleaseRelation();
-			if (i > 0)
-			{
-				pline->length_ += PointDistance2D(
-					pline->vertex_[i-1]->pos_.GetX(),
-					pline->vertex_[i-1]->pos_.GetY(),
-					pline->vertex_[i]->pos_.GetX(),
-					pline->vertex_[i]->pos_.GetY());
-			}
+			SubdivideShape(eval, shape, p0, v0, pm, vm, depth + 1, pline);
+			SubdivideShape(eval, shape, pm, vm, p1, v1, depth + 1, pline);
+			return;
+		}
+	}
+
+	pline->AddVertex(v1);
+}
+
+/**
+Append samples of a curve to a polyline, dense enough for the linear interpolation to stay within TRAJ_SAMPLE_MAX_ERROR.
+The parameter range is first split into n_segments of equal size, each one then halved until the curve mid point is
+close enough to the chord. Initial segments should be short enough not to fit any S-shape, which would go unnoticed.
+@param eval Function evaluating the curve at given parameter value
+@param p_start Start of parameter range, added as first sample unless the polyline already has vertices
+*/
+static void SampleShape(ShapeEvaluator eval, void *shape, double p_start, double p_end, int n_segments, PolyLine *pline)
+{
+	PolyLine::Vertex v0, v1;
+	double p0 = p_start;
+
+	eval(shape, p0, &v0);
+	if (pline->vertex_.size() == 0)
+	{
+		pline->AddVertex(v0);
+	}
+
+	for (int i = 1; i <= n_segments; i++)
+	{
+		double p1 = p_start + (p_end - p_start) * i / n_segments;
+
+		eval(shape, p1, &v1);
+		SubdivideShape(eval, shape, p0, v0, p1, v1, 0, pline);
+		p0 = p1;
+		v0 = v1;
+	}
+}
+
+static void EvaluateClothoid(void *shape, double p, PolyLine::Vertex *v)
+{
+	((Clothoid*)shape)->Evaluate(p, v);
+}
+
+static void EvaluateNurbs(void *shape, double p, PolyLine::Vertex *v)
+{
+	((Nurbs*)shape)->Evaluate(p, v);
+}
+
+Clothoid::Clothoid(roadmanager::Position pos, double curv, double curvDot, double len, double tStart, double tEnd) :
+	Shape(ShapeType::CLOTHOID), clothoid_(0), pos_(pos), curv_(curv), curvDot_(curvDot), t_start_(tStart), t_end_(tEnd)
+{
+	CreateGeometry(len);
+	length_ = len;
+}
+
+void Clothoid::CreateGeometry(double len)
+{
+	delete clothoid_;
+
+	// Lateral deviation from an arc at the end is curvDot * len^3 / 6
+	if (fabs(curvDot_) * len * len * len / 6 < SPIRAL_MAX_ARC_DEVIATION)
+	{
+		// Constant curvature, the standard spiral is undefined
+		if (fabs(curv_) < SMALL_NUMBER)
+		{
+			clothoid_ = new roadmanager::Line(0, pos_.GetX(), pos_.GetY(), pos_.GetH(), len);
+		}
+		else
+		{
+			clothoid_ = new roadmanager::Arc(0, pos_.GetX(), pos_.GetY(), pos_.GetH(), len, curv_);
+		}
+	}
+	else
+	{
+		clothoid_ = new roadmanager::Spiral(0, pos_.GetX(), pos_.GetY(), pos_.GetH(), len, curv_, curv_ + curvDot_ * len);
+	}
+}
+
+void Clothoid::Evaluate(double ds, PolyLine::Vertex *v)
+{
+	clothoid_->EvaluateDS(ds, &v->x, &v->y, &v->h);
+	v->z = pos_.GetZ();
+	v->p = pos_.GetP();
+	v->r = pos_.GetR();
+	v->time = t_start_ + (t_end_ - t_start_) * ds / clothoid_->GetLength();
+}
+
+void Clothoid::Freeze()
+{
+	double len = clothoid_->GetLength();
+
+	// Start position might have moved since parsed
+	pos_.ReleaseRelation();
+	CreateGeometry(len);
+
+	// Initial segments short enough for the curve not to turn more than 45 degrees
+	double max_curv = MAX(fabs(curv_), fabs(curv_ + curvDot_ * len));
+	int n_segments = 1 + (int)(max_curv * len / (M_PI / 4));
+
+	pline_.vertex_.clear();
+	SampleShape(EvaluateClothoid, this, 0.0, len, n_segments, &pline_);
+	length_ = pline_.length_;
+}
+
+void Nurbs::AddControlPoint(Position pos, double time, double weight)
+{
+	ControlPoint cp;
+	cp.pos_ = pos;
+	cp.time_ = time;
+	cp.weight_ = weight;
+	ctrlPoint_.push_back(cp);
+}
+
+void Nurbs::Evaluate(double u, PolyLine::Vertex *v)
+{
+	int p = order_ - 1;  // degree
+	int n = (int)ctrlPoint_.size();
+
+	// Find knot span k, knot_[k] <= u < knot_[k + 1], affected by control points k - p .. k
+	int k = (int)(std::upper_bound(knot_.begin() + p + 1, knot_.begin() + n, u) - knot_.begin()) - 1;
+
+	// Non zero basis functions of degree p, and of degree p - 1 for the derivative, see "The NURBS Book"
+	std::vector<double> N(order_, 0.0);
+	std::vector<double> N_prev(order_, 0.0);
+	std::vector<double> left(order_, 0.0);
+	std::vector<double> right(order_, 0.0);
+
+	N[0] = 1.0;
+	for (int j = 1; j <= p; j++)
+	{
+		N_prev = N;
+		left[j] = u - knot_[k + 1 - j];
+		right[j] = knot_[k + j] - u;
+		double saved = 0.0;
+		for (int r = 0; r < j; r++)
+		{
+			double tmp = N[r] / (right[r + 1] + left[j - r]);
+			N[r] = saved + right[r + 1] * tmp;
+			saved = left[j - r] * tmp;
+		}
+		N[j] = saved;
+	}
+
+	double w = 0.0, dw = 0.0, dx = 0.0, dy = 0.0;
+	v->x = v->y = v->z = v->p = v->r = v->time = 0.0;
+
+	for (int i = 0; i <= p; i++)
+	{
+		ControlPoint *cp = &ctrlPoint_[k - p + i];
+		double dN = 0.0;
+
+		if (i > 0 && knot_[k + i] > knot_[k - p + i])
+		{
+			dN += p * N_prev[i - 1] / (knot_[k + i] - knot_[k - p + i]);
+		}
+		if (i < p && knot_[k + i + 1] > knot_[k - p + i + 1])
+		{
+			dN -= p * N_prev[i] / (knot_[k + i + 1] - knot_[k - p + i + 1]);
+		}
+
+		double a = N[i] * cp->weight_;
+		double da = dN * cp->weight_;
+
+		w += a;
+		dw += da;
+		v->x += a * cp->pos_.GetX();
+		v->y += a * cp->pos_.GetY();
+		v->z += a * cp->pos_.GetZ();
+		v->p += a * cp->pos_.GetP();
+		v->r += a * cp->pos_.GetR();
+		v->time += a * cp->time_;
+		dx += da * cp->pos_.GetX();
+		dy += da * cp->pos_.GetY();
+	}
+
+	if (w > SMALL_NUMBER)
+	{
+		v->x /= w;
+		v->y /= w;
+		v->z /= w;
+		v->p /= w;
+		v->r /= w;
+		v->time /= w;
+	}
+
+	// Derivative of the rational curve is (A' - w' * C) / w, heading not affected by the positive factor 1 / w
+	v->h = GetAngleOfVector(dx - dw * v->x, dy - dw * v->y);
+}
+
+void Nurbs::Freeze()
+{
+	int n = (int)ctrlPoint_.size();
+
+	pline_.vertex_.clear();
+	length_ = 0.0;
+
+	if (order_ < 1 || n < order_ || (int)knot_.size() != n + order_)
+	{
+		LOG("Invalid Nurbs: order %d, %d control points and %d knots (expected %d)", order_, n, (int)knot_.size(), n + order_);
+		return;
+	}
+
+	for (size_t i = 0; i < ctrlPoint_.size(); i++)
+	{
+		ctrlPoint_[i].pos_.ReleaseRelation();
+	}
+
+	// Each knot span is a polynomial of degree order_ - 1, which may have order_ - 2 inflection points
+	for (int k = order_ - 1; k < n; k++)
+	{
+		if (knot_[k + 1] > knot_[k])
+		{
+			SampleShape(EvaluateNurbs, this, knot_[k], knot_[k + 1], order_, &pline_);
 		}
 	}
+	length_ = pline_.length_;
+}
+
+void Trajectory::Freeze()
+{
+	if (shape_->type_ == Shape::ShapeType::POLYLINE)
+	{
+		((PolyLine*)shape_)->Freeze();
+	}
+	else if (shape_->type_ == Shape::ShapeType::CLOTHOID)
+	{
+		((Clothoid*)shape_)->Freeze();
+	}
+	else if (shape_->type_ == Shape::ShapeType::NURBS)
+	{
+		((Nurbs*)shape_)->Freeze();
+	}
 	else
 	{
-		LOG("Clothoid and Nurbs trajectory types not supported yet");
+		LOG("Unsupported trajectory type %d", shape_->type_);
+	}
+}
+
+PolyLine* Trajectory::GetPolyLine()
+{
+	if (shape_ == 0)
+	{
+		return 0;
+	}
+	else if (shape_->type_ == Shape::ShapeType::POLYLINE)
+	{
+		return (PolyLine*)shape_;
+	}
+	else if (shape_->type_ == Shape::ShapeType::CLOTHOID)
+	{
+		return &((Clothoid*)shape_)->pline_;
 	}
+	else if (shape_->type_ == Shape::ShapeType::NURBS)
+	{
+		return &((Nurbs*)shape_)->pline_;
+	}
+
+	return 0;
 }
\ No newline at end of file
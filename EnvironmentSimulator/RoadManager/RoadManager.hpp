@@ -17,7 +17,11 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <unordered_map>
 #include "pugixml.hpp"
+#include "CommonMini.hpp"
+
+#define SPIRAL_TABLE_MAX_ERROR 1E-6  // m, max deviation of interpolated spiral samples
 
 namespace roadmanager
 {
@@ -107,6 +111,7 @@ namespace roadmanager
 		~Arc() {}
 
 		double EvaluateCurvatureDS(double ds) { (void)ds; return curvature_; }
+		double GetCurvature() { return curvature_; }
 		double GetRadius() { return std::fabs(1.0 / curvature_); }
 		void Print();
 		void EvaluateDS(double ds, double *x, double *y, double *h);
@@ -119,9 +124,7 @@ namespace roadmanager
 	class Spiral : public Geometry
 	{
 	public:
-		Spiral(double s, double x, double y, double hdg, double length, double curv_start, double curv_end) :
-			Geometry(s, x, y, hdg, length, GEOMETRY_TYPE_SPIRAL),
-			curv_start_(curv_start), curv_end_(curv_end), c_dot_(0.0), x0_(0.0), y0_(0.0), h0_(0.0), s0_(0.0) {}
+		Spiral(double s, double x, double y, double hdg, double length, double curv_start, double curv_end);
 		~Spiral() {};
 
 		double GetCurvStart() { return curv_start_; }
@@ -140,6 +143,16 @@ namespace roadmanager
 		void EvaluateDS(double ds, double *x, double *y, double *h);
 		double EvaluateCurvatureDS(double ds);
 
+		/**
+		Precompute position and heading at equidistant points along the segment. Subsequent evaluations
+		will interpolate the table instead of computing the Fresnel integrals.
+		@param max_error Max interpolation error (m), decides sample distance
+		@return Number of samples in the table
+		*/
+		int CreateSampleTable(double max_error);
+		void ClearSampleTable() { sample_.clear(); sample_dist_ = 0.0; }
+		bool HasSampleTable() { return sample_.size() > 0; }
+
 	private:
 		double curv_start_;
 		double curv_end_;
@@ -148,6 +161,19 @@ namespace roadmanager
 		double y0_; // 0 if spiral starts with curvature = 0
 		double h0_; // 0 if spiral starts with curvature = 0
 		double s0_; // 0 if spiral starts with curvature = 0
+
+		typedef struct
+		{
+			double x;
+			double y;
+			double cos_h;
+			double sin_h;
+		} Sample;
+
+		std::vector<Sample> sample_;  // global position and heading direction at ds = i * sample_dist_
+		double sample_dist_;
+
+		double EvaluateHeadingDS(double ds);
 	};
 
 
@@ -188,19 +214,23 @@ namespace roadmanager
 		ParamPoly3(
 			double s, double x, double y, double hdg, double length,
 			double aU, double bU, double cU, double dU, double aV, double bV, double cV, double dV, PRangeType p_range) :
-			Geometry(s, x, y, hdg, length, GeometryType::GEOMETRY_TYPE_PARAM_POLY3)
+			Geometry(s, x, y, hdg, length, GeometryType::GEOMETRY_TYPE_PARAM_POLY3), p_range_(p_range)
 		{
 			poly3U_.Set(aU, bU, cU, dU, p_range == PRangeType::P_RANGE_NORMALIZED ? 1.0/length : 1.0);
 			poly3V_.Set(aV, bV, cV, dV, p_range == PRangeType::P_RANGE_NORMALIZED ? 1.0/length : 1.0);
 		}
 		~ParamPoly3() {};
 
+		PRangeType GetPRange() { return p_range_; }
 		void Print();
 		void EvaluateDS(double ds, double *x, double *y, double *h);
 		double EvaluateCurvatureDS(double ds);
 
 		Polynomial poly3U_;
 		Polynomial poly3V_;
+
+	private:
+		PRangeType p_range_;
 	};
 
 
@@ -283,6 +313,7 @@ namespace roadmanager
 		double GetLength() { return length_; }
 		double GetLaneOffset(double s);
 		double GetLaneOffsetPrim(double s);
+		Polynomial *GetPolynomial() { return &polynomial_; }
 		void Print();
 
 	private:
@@ -329,12 +360,16 @@ namespace roadmanager
 		Lane(int id, Lane::LaneType type) : id_(id), type_(type), level_(1), offset_from_ref_(0) {}
 		void AddLink(LaneLink *lane_link) { link_.push_back(lane_link); }
 		int GetId() { return id_; }
+		LaneType GetType() { return type_; }
 		LaneWidth *GetWidthByIndex(int index) { return lane_width_[index]; }
+		int GetNumberOfLaneWidths() { return (int)lane_width_.size(); }
 		LaneWidth *GetWidthByS(double s);
 		LaneLink *GetLink(LinkType type);
+		LaneLink *GetLinkByIdx(int idx) { return link_[idx]; }
+		int GetNumberOfLinks() { return (int)link_.size(); }
 		void SetOffsetFromRef(double offset) { offset_from_ref_ = offset; }
 		double GetOffsetFromRef() { return offset_from_ref_; }
-		void AddLaneWIdth(LaneWidth *lane_width) { lane_width_.push_back(lane_width); }
+		void AddLaneWIdth(LaneWidth *lane_width) { lane_width_.push_back(lane_width); lane_width_s_.push_back(lane_width->GetSOffset()); }
 		int IsDriving();
 		void Print();
 
@@ -345,12 +380,13 @@ namespace roadmanager
 		double offset_from_ref_;
 		std::vector<LaneLink*> link_;
 		std::vector<LaneWidth*> lane_width_;
+		std::vector<double> lane_width_s_;  // sOffset of each lane width entry, for lookup by s
 	};
 
 	class LaneSection
 	{
 	public:
-		LaneSection(double s) : s_(s), length_(0) {}
+		LaneSection(double s) : s_(s), length_(0), min_lane_id_(0) {}
 		void AddLane(Lane *lane);
 		double GetS() { return s_; }
 		Lane* GetLaneByIdx(int idx);
@@ -388,6 +424,8 @@ namespace roadmanager
 		double s_;
 		double length_;
 		std::vector<Lane*> lane_;
+		std::vector<int> lane_idx_by_id_;  // lane index per id - min_lane_id_, -1 if no such lane
+		int min_lane_id_;
 	};
 
 	enum ContactPointType
@@ -479,6 +517,8 @@ namespace roadmanager
 		/**
 		Retrieve the lanesection index at specified s-value
 		@param s distance along the road segment
+		@param start_at lane section index to check first, e.g. the one found in previous call
+		@return lane section index, -1 if start_at is out of range
 		*/
 		int GetLaneSectionIdxByS(double s, int start_at = 0);
 
@@ -508,7 +548,9 @@ namespace roadmanager
 		void SetJunction(int junction) { junction_ = junction; }
 		int GetJunction() { return junction_; }
 		void AddLink(RoadLink *link) { link_.push_back(link); }
-		void AddRoadType(RoadTypeEntry *type) { type_.push_back(type); }
+		void AddRoadType(RoadTypeEntry *type) { type_.push_back(type); type_s_.push_back(type->s_); }
+		RoadTypeEntry *GetRoadType(int idx) { return type_[idx]; }
+		int GetNumberOfRoadTypes() { return (int)type_.size(); }
 		RoadLink *GetLink(LinkType type);
 		void AddLine(Line *line);
 		void AddArc(Arc *arc);
@@ -522,6 +564,8 @@ namespace roadmanager
 		int GetNumberOfElevations() { return (int)elevation_profile_.size(); }
 		double GetLaneOffset(double s);
 		double GetLaneOffsetPrim(double s);
+		LaneOffset *GetLaneOffsetByIdx(int idx) { return lane_offset_[idx]; }
+		int GetNumberOfLaneOffsets() { return (int)lane_offset_.size(); }
 		int GetNumberOfLanes(double s);
 		int GetNumberOfDrivingLanes(double s);
 		Lane* GetDrivingLaneByIdx(double s, int idx);
@@ -539,6 +583,12 @@ namespace roadmanager
 		std::vector<Elevation*> elevation_profile_;
 		std::vector<LaneSection*> lane_section_;
 		std::vector<LaneOffset*> lane_offset_;
+
+		// Start s of above records, sorted as in the OpenDRIVE file, for binary search by s
+		std::vector<double> type_s_;
+		std::vector<double> elevation_s_;
+		std::vector<double> lane_section_s_;
+		std::vector<double> lane_offset_s_;
 	};
 
 	class LaneRoadLaneConnection
@@ -620,11 +670,114 @@ namespace roadmanager
 		std::string name_;
 	};
 
+	/**
+	Reference to a geometry segment, specified by road and geometry vector element indices
+	*/
+	typedef struct
+	{
+		int road_idx_;
+		int geom_idx_;
+	} GeometryRef;
+
+	class OpenDrive;
+
+	#define MAX_TRACK_DIST 10  // m, search margin around roads when mapping a world coordinate to a road position
+
+	/**
+	Uniform grid spatial index over all road geometry segments. Each geometry is registered in
+	every cell touched by its footprint, i.e. the reference line widened by the road width and
+	an additional search margin. Used to restrict the candidate set when mapping a world
+	coordinate to a road position.
+	*/
+	class GeometryGrid
+	{
+	public:
+		GeometryGrid() : x_min_(0), y_min_(0), cell_size_(0), margin_(0), n_cols_(0), n_rows_(0) {}
+
+		/**
+		(Re)build the index from all geometries of given road network
+		@param odr road network to index
+		@param margin extra distance (m) added to the road width, defines the search range
+		*/
+		void Build(OpenDrive *odr, double margin);
+		void Clear();
+
+		/**
+		Retrieve geometries whose footprint overlaps the grid cell containing the specified point
+		@param x X coordinate of the point
+		@param y Y coordinate of the point
+		@return Geometry references of the cell, sorted on road index and geometry index. 0 if the point is
+		outside indexed area or the cell is empty. Valid until the grid is rebuilt.
+		*/
+		const std::vector<GeometryRef> *GetCandidates(double x, double y);
+		bool IsEmpty() { return cell_.size() == 0; }
+
+		/**
+		Any geometry not registered in a cell is at least this far (m) from all points of the cell
+		*/
+		double GetMargin() { return margin_; }
+
+	private:
+		void AddSegment(double x0, double y0, double x1, double y1, double width, GeometryRef ref);
+		int GetCellIdx(int col, int row) { return row * n_cols_ + col; }
+
+		double x_min_;
+		double y_min_;
+		double cell_size_;
+		double margin_;
+		int n_cols_;
+		int n_rows_;
+		std::vector<std::vector<GeometryRef> > cell_;
+	};
+
+	/**
+	Road connectivity graph. Each road is represented by two nodes, its start (s=0) and end (s=length).
+	Edges are the roads themselves, weighted by road length, and the links between roads, directly or
+	via junction connections, with zero weight. Built once when loading the road network.
+	*/
+	class RoadGraph
+	{
+	public:
+		typedef struct
+		{
+			int node_;		// road_idx * 2 + end (0=start, 1=end)
+			double dist_;
+		} Edge;
+
+		RoadGraph() : serial_(0) {}
+
+		/**
+		(Re)build the graph from the road links and junction connections of given road network
+		@param odr road network
+		*/
+		void Build(OpenDrive *odr);
+		void Clear() { edge_.clear(); }
+
+		/**
+		Find shortest path distances from each end of one road to each end of another road
+		The lengths of the from and to roads themselves are not included. 
+		@param from_road_idx index of the road to start from
+		@param to_road_idx index of the road to reach
+		@param dist Distances indexed [from end][to end], where 0 is road start and 1 is road end. LARGE_NUMBER if no path.
+		@return true if any path was found, else false
+		*/
+		bool GetShortestDistances(int from_road_idx, int to_road_idx, double dist[2][2]);
+
+		/**
+		Incremented every time the graph is rebuilt, used to detect stale cached path data
+		*/
+		int GetSerial() { return serial_; }
+
+	private:
+		std::vector<std::vector<Edge> > edge_;  // outgoing edges per node
+		int serial_;
+	};
+
 	class OpenDrive
 	{
 	public:
-		OpenDrive() {};
-		OpenDrive(const char *filename);
+		OpenDrive() : spiral_tables_(false), id_index_valid_(false) {};
+		OpenDrive(const char *filename, bool spiral_tables = false);
 		~OpenDrive();
 
 		/**
@@ -634,6 +787,25 @@ namespace roadmanager
 		*/
 		bool LoadOpenDriveFile(const char *filename, bool replace = true);
 
+		/**
+		Select whether spiral geometries should be evaluated from precomputed sample tables, created when
+		loading the road network, instead of computing Fresnel integrals on each evaluation. Tables are
+		created or removed for any already loaded road network as well.
+		@param value If true, use sample tables (max error SPIRAL_TABLE_MAX_ERROR), else exact evaluation
+		*/
+		void SetSpiralTables(bool value);
+		bool GetSpiralTables() { return spiral_tables_; }
+
+		/**
+		Enable a cache of compiled road networks, shared by all OpenDrive instances. The first time an
+		OpenDRIVE file is loaded, a binary copy of the parsed road network is written to the cache folder,
+		named after a hash of the file content. Later loads of identical content will read the binary copy
+		instead of parsing the XML.
+		@param dirname Folder for the cache files, "" disables the cache (default)
+		*/
+		static void SetCacheDir(std::string dirname);
+		static std::string GetCacheDir();
+
 		/**
 		Get the filename of currently loaded OpenDRIVE file
 		*/
@@ -685,14 +857,45 @@ namespace roadmanager
 		std::string ContactPointType2Str(ContactPointType type);
 		std::string ElementType2Str(RoadLink::ElementType type);
 
+		/**
+		Spatial index over geometry segments, built when loading the road network
+		*/
+		GeometryGrid *GetGeometryGrid() { return &geometry_grid_; }
+
+		/**
+		Road connectivity graph, built when loading the road network
+		*/
+		RoadGraph *GetRoadGraph() { return &road_graph_; }
 
 		void Print();
-	
+
 	private:
 		pugi::xml_node root_node_;
 		std::vector<Road*> road_;
 		std::vector<Junction*> junction_;
 		std::string odr_filename_;
+		GeometryGrid geometry_grid_;
+		RoadGraph road_graph_;
+		bool spiral_tables_;
+		std::unordered_map<int, int> road_idx_by_id_;
+		std::unordered_map<int, int> junction_idx_by_id_;
+		bool id_index_valid_;  // false while loading, then lookups by id fall back to search
+
+		bool ParseOpenDriveXML(const char *filename);
+
+		/**
+		Index roads and junctions by id, for constant time lookups. Called when loading is complete.
+		In case of duplicate ids the first element is found, just like a search would.
+		*/
+		void BuildIdIndex();
+
+		/**
+		Compiled road network cache, see SetCacheDir()
+		The roads and junctions from index first_road and first_junction are stored
+		*/
+		std::string GetCacheFilename(const char *filename, unsigned long long &hash);
+		bool WriteCache(std::string cache_filename, unsigned long long hash, int first_road, int first_junction);
+		bool ReadCache(std::string cache_filename, unsigned long long hash);
 	};
 
 	typedef struct
@@ -720,6 +923,18 @@ namespace roadmanager
 		int dLaneId;			// delta laneId (increasing left and decreasing to the right)
 	} PositionDiff;
 
+	#define PATH_CACHE_SIZE 4
+
+	// Shortest path distances between two roads, see RoadGraph::GetShortestDistances
+	typedef struct
+	{
+		RoadGraph *graph_;
+		int serial_;
+		int from_road_id_;
+		int to_road_id_;
+		double dist_[2][2];
+	} PathCacheEntry;
+
 	// Forward declarations
 	class Route;
 	class Trajectory;
@@ -751,6 +966,7 @@ namespace roadmanager
 		};
 
 		explicit Position();
+		explicit Position(OpenDrive *odr);
 		explicit Position(int track_id, double s, double t);
 		explicit Position(int track_id, int lane_id, double s, double offset);
 		explicit Position(double x, double y, double z, double h, double p, double r);
@@ -758,8 +974,44 @@ namespace roadmanager
 		~Position();
 		
 		void Init();
+
+		/**
+		Load a road network into the default instance, see GetDefaultOpenDrive
+		@param filename OpenDRIVE file
+		*/
 		static bool LoadOpenDrive(const char *filename);
-		static OpenDrive* GetOpenDrive();
+
+		/**
+		Get the default road network, used by positions not explicitly assigned another one. 
+		It's the one bound to the calling thread, if any, else the process default one.
+		*/
+		static OpenDrive* GetDefaultOpenDrive();
+
+		/**
+		Bind a road network to the calling thread. Until unbound, positions created by the thread, 
+		and LoadOpenDrive, will use the specified road network instead of the process default one. 
+		Enables multiple threads to simulate on separate road networks.
+		@param odr Road network to use, or 0 to revert to the process default one
+		*/
+		static void SetThreadOpenDrive(OpenDrive *odr);
+
+		/**
+		Get the road network bound to the calling thread
+		@return Road network or 0 if none bound
+		*/
+		static OpenDrive* GetThreadOpenDrive();
+
+		/**
+		Get the road network this position refers to
+		*/
+		OpenDrive* GetOpenDrive() { return odr_; }
+
+		/**
+		Specify the road network this position refers to. The network is only read, so it can be 
+		shared among any number of positions, also in different threads. Any road position is reset.
+		@param odr Road network, must be loaded and outlive the position
+		*/
+		void SetOpenDrive(OpenDrive *odr);
 		int GotoClosestDrivingLaneAtCurrentPosition();
 		void SetTrackPos(int track_id, double s, double t, bool calculateXYZ = true);
 		void ForceLaneId(int lane_id);
@@ -779,6 +1031,19 @@ namespace roadmanager
 
 		Position* GetRelativePosition() { return rel_pos_; }
 
+		/**
+		Restart the random number stream used for random choices, e.g. junction strategy RANDOM. Give each
+		entity a unique stream id, then its choices are reproducible given the global seed (see SE_Random::SetGlobalSeed).
+		@param stream_id Typically the entity id
+		*/
+		void SetRandomStream(unsigned long long stream_id) { rand_.Seed(SE_Random::GetGlobalSeed(), stream_id); }
+
+		/**
+		Get and set the random number stream including its progress, e.g. to keep it when assigning another position
+		*/
+		SE_Random GetRandomStream() { return rand_; }
+		void SetRandomStream(const SE_Random &stream) { rand_ = stream; }
+
 		void ReleaseRelation();
 
 		void SetRoute(Route *route);
@@ -858,10 +1123,12 @@ namespace roadmanager
 
 		/**
 		Find out the difference between two position objects, in effect subtracting the values 
+		Road distances between this and recently used target roads are cached, so repeated calls 
+		are cheap as long as neither position changes road.
 		@param positionB The position which will be subtracted from the current position object
 		@return true if position found and parameter values are valid, else false
 		*/
-		bool Delta(Position pos_b, PositionDiff &diff);
+		bool Delta(Position &pos_b, PositionDiff &diff);
 
 		/**
 		Is the current position ahead of the one specified in argument
@@ -1043,6 +1310,9 @@ namespace roadmanager
 		void SetR(double r) { r_ = r; }
 		void SetOrientationType(OrientationType type) { orientation_type_ = type; }
 
+		/**
+		Copy position, keeping the fields owned by the entity: route and random number stream
+		*/
 		void CopyRMPos(Position *from);
 
 		void PrintTrackPos();
@@ -1060,6 +1330,10 @@ namespace roadmanager
 		int SetLongitudinalTrackPos(int track_id, double s);
 		bool EvaluateRoadZPitchRoll(bool alignZPitchRoll);
 		double GetDistToTrackGeom(double x3, double y3, double z3, double h, Road *road, Geometry *geom, bool &inside, double &sNorm);
+		PathCacheEntry *GetPathDistances(int to_road_id);
+
+		// road network reference
+		OpenDrive *odr_;
 
 		// route reference
 		Route  *route_;			// if pointer set, the position corresponds to a point along (s) the route
@@ -1078,6 +1352,8 @@ namespace roadmanager
 		double  h_relative_;	// heading relative to the road (h_ = h_road_ + h_relative_)
 		double  s_route_;		// longitudinal point/distance along the route
 		double  s_trajectory_;	// longitudinal point/distance along the trajectory
+		int     trajectory_seg_idx_;  // last found trajectory segment, where to start next lookup
+		SE_Random rand_;  // for random choices, owned by the entity, i.e. kept by CopyRMPos
 		double  curvature_;
 		Position* rel_pos_;
 		PositionType type_;
@@ -1099,6 +1375,30 @@ namespace roadmanager
 		int		lane_section_idx_;	// lane section
 		int		geometry_idx_;	// index of the segment within the track given by track_idx
 		int		elevation_idx_;	// index of the current elevation entry 
+
+		// shortest path distances to recently used target roads
+		PathCacheEntry path_cache_[PATH_CACHE_SIZE];
+		int		path_cache_next_;	// entry to replace next
+	};
+
+	/**
+	Binds a road network to the calling thread while in scope, see Position::SetThreadOpenDrive. 
+	Any previous binding is restored when the object goes out of scope.
+	*/
+	class OpenDriveThreadBinding
+	{
+	public:
+		OpenDriveThreadBinding(OpenDrive *odr) : prev_(Position::GetThreadOpenDrive())
+		{
+			Position::SetThreadOpenDrive(odr);
+		}
+		~OpenDriveThreadBinding()
+		{
+			Position::SetThreadOpenDrive(prev_);
+		}
+
+	private:
+		OpenDrive *prev_;
 	};
 
 
@@ -1186,37 +1486,129 @@ namespace roadmanager
 	{
 	public:
 
-		class Vertex
+		typedef struct
 		{
-		public:
-			Position pos_;
-			double time_;
-		};
+			double x;
+			double y;
+			double z;
+			double h;
+			double p;
+			double r;
+			double s;     // accumulated distance along the polyline
+			double time;  // assumed non decreasing along the polyline
+		} Vertex;
 
 		PolyLine() : Shape(ShapeType::POLYLINE) {}
 		void AddVertex(Position pos, double time = 0);
 
-		std::vector<Vertex*> vertex_;
+		/**
+		Add an already evaluated vertex, e.g. a sample of another shape. Distance s is calculated and heading
+		is unwrapped to be continuous with previous vertex. Do not mix with vertices added as positions.
+		*/
+		void AddVertex(Vertex v);
+
+		/**
+		Resolve any relative vertex positions and update the evaluated vertices accordingly. The relative 
+		positions are released, so later calls have no effect.
+		*/
+		void Freeze();
+
+		/**
+		Find the segment containing a given distance, i.e. the first segment ending beyond s
+		@param s Distance along the polyline
+		@param hint Segment index to check first, typically the one found in previous call
+		@return Index of the segment start vertex, or the last vertex index if s is beyond the end
+		*/
+		int FindSegmentByS(double s, int hint = 0) { return FindSegment(&Vertex::s, s, hint); }
+
+		/**
+		Find the segment containing a given time, i.e. the first segment ending after time
+		@param time Time along the polyline
+		@param hint Segment index to check first, typically the one found in previous call
+		@return Index of the segment start vertex, or the last vertex index if time is beyond the end
+		*/
+		int FindSegmentByTime(double time, int hint = 0) { return FindSegment(&Vertex::time, time, hint); }
+
+		std::vector<Vertex> vertex_;  // evaluated vertices, contiguous for fast lookup
+
+	private:
+		typedef struct
+		{
+			size_t idx;  // index of the vertex
+			Position pos;
+		} RelativeVertex;
+
+		std::vector<RelativeVertex> relative_pos_;  // positions of vertices specified relative other objects or lanes, until frozen
+
+		void SetVertex(size_t idx, Position &pos);
+		void UpdateS(size_t idx);
+		int FindSegment(double Vertex::*field, double value, int hint);
 	};
 
 	class Clothoid : public Shape
 	{
 	public:
 
-		Clothoid(roadmanager::Position pos, double curv, double curvDot, double len, double tStart, double tEnd) : Shape(ShapeType::CLOTHOID)
-		{
-			pos_ = pos;
-			clothoid_ = new roadmanager::Spiral(0, pos_.GetX(), pos_.GetY(), pos_.GetH(), len, curv, curv + curvDot * len);
-		}
+		Clothoid(roadmanager::Position pos, double curv, double curvDot, double len, double tStart, double tEnd);
+		~Clothoid() { delete clothoid_; }
+
+		/**
+		Resolve start position, in case relative other objects, and sample the curve into pline_
+		*/
+		void Freeze();
 
-		roadmanager::Spiral* clothoid_;
+		/**
+		Evaluate the curve
+		@param ds Distance from start of the clothoid
+		@param v Receives position, heading and time of the point
+		*/
+		void Evaluate(double ds, PolyLine::Vertex *v);
+
+		roadmanager::Geometry* clothoid_;  // Spiral, or Arc or Line in case of constant curvature
 		roadmanager::Position pos_;
+		double curv_;
+		double curvDot_;
+		double t_start_;
+		double t_end_;
+		PolyLine pline_;  // samples, see Freeze()
+
+	private:
+		void CreateGeometry(double len);
 	};
 
 	class Nurbs : public Shape
 	{
 	public:
-		Nurbs() : Shape(ShapeType::NURBS) {}
+
+		class ControlPoint
+		{
+		public:
+			Position pos_;
+			double time_;
+			double weight_;
+		};
+
+		Nurbs(int order) : Shape(ShapeType::NURBS), order_(order) {}
+
+		void AddControlPoint(Position pos, double time, double weight);
+		void AddKnot(double value) { knot_.push_back(value); }
+
+		/**
+		Resolve control point positions, in case relative other objects, and sample the curve into pline_
+		*/
+		void Freeze();
+
+		/**
+		Evaluate the curve
+		@param u Curve parameter, in range of the knot vector excluding the first and last order - 1 values
+		@param v Receives position, heading (tangent direction) and time of the point
+		*/
+		void Evaluate(double u, PolyLine::Vertex *v);
+
+		int order_;  // polynomial degree + 1
+		std::vector<ControlPoint> ctrlPoint_;
+		std::vector<double> knot_;  // expected size ctrlPoint_.size() + order_
+		PolyLine pline_;  // samples, see Freeze()
 	};
 
 	class Trajectory
@@ -1228,6 +1620,13 @@ namespace roadmanager
 		Trajectory() : shape_(0), closed_(false) {}
 		void Freeze();
 
+		/**
+		Get the polyline representation used for evaluation. Clothoid and NURBS shapes are represented by
+		samples, hence available only after Freeze().
+		@return Pointer to the polyline, 0 if shape is missing or of unknown type
+		*/
+		PolyLine* GetPolyLine();
+
 		std::string name_;
 		bool closed_;
 	};
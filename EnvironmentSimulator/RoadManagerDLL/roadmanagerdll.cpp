@@ -99,12 +99,14 @@ extern "C"
 			RM_Close();
 		}
 
-		if (!roadmanager::Position::LoadOpenDrive(odrFilename))
+		// Use a dedicated road network, not interfering with any other module in the process
+		odrManager = new roadmanager::OpenDrive;
+		if (!odrManager->LoadOpenDriveFile(odrFilename))
 		{
 			printf("Failed to load ODR %s\n", odrFilename);
+			RM_Close();
 			return -1;
 		}
-		odrManager = roadmanager::Position::GetOpenDrive();
 
 		return 0;
 	}
@@ -113,12 +115,20 @@ extern "C"
 	{
 		position.clear();
 
+		delete odrManager;
+		odrManager = 0;
+
 		return 0;
 	}
 	
 	RM_DLL_API int RM_CreatePosition()
 	{
-		roadmanager::Position newPosition;
+		if (odrManager == 0)
+		{
+			return -1;
+		}
+
+		roadmanager::Position newPosition(odrManager);
 		position.push_back(newPosition);
 		return (int)(position.size() - 1);  // return index of newly created 
 	}
@@ -69,7 +69,7 @@ extern "C"
 
 	/**
 	Create a position object
-	@return Handle to the position object, to use for operations
+	@return Handle to the position object, to use for operations, -1 if no road network is loaded (see RM_Init)
 	*/
 	RM_DLL_API int RM_CreatePosition();
 
@@ -127,14 +127,12 @@ bool EvalDone(bool result, TrigByEntity::TriggeringEntitiesRule rule)
 
 bool OSCCondition::Evaluate(StoryBoard *storyBoard, double sim_time)
 {
-	(void)storyBoard;
-	(void)sim_time;
-
 	if (timer_.Started())
 	{
-		if (timer_.DurationS() > delay_)
+		// Allow for round off errors when accumulating timesteps
+		if (timer_.DurationS(sim_time) > delay_ - SMALL_NUMBER)
 		{
-			LOG("Timer expired at %.2f seconds", timer_.DurationS());
+			LOG("Timer expired at %.2f seconds", timer_.DurationS(sim_time));
 			timer_.Reset();
 			return true;
 		}
@@ -149,7 +147,7 @@ bool OSCCondition::Evaluate(StoryBoard *storyBoard, double sim_time)
 
 	if (trig && delay_ > 0)
 	{
-		timer_.Start();
+		timer_.Start(sim_time);
 		LOG("Timer %.2fs started", delay_);
 		return false;
 	}
@@ -195,6 +193,29 @@ bool Trigger::Evaluate(StoryBoard *storyBoard, double sim_time)
 	return result;
 }
 
+StoryBoardElement *TrigByState::ResolveElement(StoryBoard *storyBoard)
+{
+	if (element_type_ == StoryBoardElement::ElementType::ACTION)
+	{
+		element_ = storyBoard->FindActionByName(element_name_);
+	}
+	else if (element_type_ == StoryBoardElement::ElementType::ACT)
+	{
+		element_ = storyBoard->FindActByName(element_name_);
+	}
+	else if (element_type_ == StoryBoardElement::ElementType::EVENT)
+	{
+		element_ = storyBoard->FindEventByName(element_name_);
+	}
+	else if (element_type_ != StoryBoardElement::ElementType::STORY)
+	{
+		LOG("Story element type %d not supported yet", element_type_);
+		element_ = 0;
+	}
+
+	return element_;
+}
+
 bool TrigByState::CheckCondition(StoryBoard *storyBoard, double sim_time, bool log)
 {
 	(void)sim_time;
@@ -215,21 +236,9 @@ bool TrigByState::CheckCondition(StoryBoard *storyBoard, double sim_time, bool l
 	}
 	else
 	{
-		if (element_type_ == StoryBoardElement::ElementType::ACTION)
-		{
-			element = storyBoard->FindActionByName(element_name_);
-		}
-		else if (element_type_ == StoryBoardElement::ElementType::ACT)
-		{
-			element = storyBoard->FindActByName(element_name_);
-		}
-		else if (element_type_ == StoryBoardElement::ElementType::EVENT)
-		{
-			element = storyBoard->FindEventByName(element_name_);
-		}
-		else
+		if ((element = element_) == 0 && (element = ResolveElement(storyBoard)) == 0)
 		{
-			LOG("Story element type %d not supported yet", element_type_);
+			// Unknown element or type, reported when the storyboard was resolved
 			return false;
 		}
 
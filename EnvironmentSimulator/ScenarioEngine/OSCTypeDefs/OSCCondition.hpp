@@ -27,21 +27,27 @@ namespace scenarioengine
 	// Forward declaration 
 	class StoryBoard;
 
+	/**
+	Measures simulation time, not wall-clock time, so that delays are independent of
+	how fast the simulation runs compared to realtime
+	*/
 	class Timer
 	{
 	public:
-		__int64 start_time_;
+		double start_time_;
+		bool started_;
 
-		Timer() : start_time_(0) {}
-		void Start() 
+		Timer() : start_time_(0), started_(false) {}
+		void Start(double sim_time)
 		{ 
-			start_time_ = SE_getSystemTime(); 
+			start_time_ = sim_time;
+			started_ = true;
 		}
 		
-		void Reset() { start_time_ = 0; }
+		void Reset() { start_time_ = 0; started_ = false; }
 
-		bool Started() { return start_time_ > 0 ? true : false; }
-		double DurationS() { return 1E-3 * (SE_getSystemTime() - start_time_);  }
+		bool Started() { return started_; }
+		double DurationS(double sim_time) { return sim_time - start_time_; }
 		
 	};
 	
@@ -226,10 +232,18 @@ namespace scenarioengine
 		CondElementState state_;
 		StoryBoardElement::ElementType element_type_;
 		std::string element_name_;
+		StoryBoardElement *element_;  // referred element, resolved by name once the storyboard is parsed
 
 		bool CheckCondition(StoryBoard* storyBoard, double sim_time, bool log = false); 
 		TrigByState(CondElementState state, StoryBoardElement::ElementType element_type, std::string element_name) :
-			OSCCondition(BY_STATE), state_(state), element_type_(element_type), element_name_(element_name) {}
+			OSCCondition(BY_STATE), state_(state), element_type_(element_type), element_name_(element_name), element_(0) {}
+
+		/**
+		Look up the referred element by type and name in the storyboard index and keep a pointer to it
+		@param storyBoard The storyboard containing the element
+		@return Pointer to the element, 0 if not found
+		*/
+		StoryBoardElement *ResolveElement(StoryBoard *storyBoard);
 		std::string CondElementState2Str(CondElementState state);
 	};
 
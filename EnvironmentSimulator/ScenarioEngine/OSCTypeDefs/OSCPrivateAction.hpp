@@ -91,6 +91,12 @@ namespace scenarioengine
 			return 0;
 		};
 
+		/**
+		Tell whether Step only reads and modifies the state of the action's own object. Such actions 
+		of different objects do not interact and may be stepped in parallel.
+		*/
+		virtual bool IsObjectLocal() { return false; }
+
 	};
 
 	class LongSpeedAction : public OSCPrivateAction
@@ -176,6 +182,8 @@ namespace scenarioengine
 
 		void Step(double dt, double simTime);
 
+		bool IsObjectLocal() { return target_->type_ == Target::Type::ABSOLUTE; }
+
 		void print()
 		{
 			LOG("");
@@ -305,6 +313,7 @@ namespace scenarioengine
 		}
 
 		void Step(double dt, double simTime);
+		bool IsObjectLocal() { return true; }
 
 		void Start();
 
@@ -378,6 +387,7 @@ namespace scenarioengine
 
 		void Start();
 		void Step(double dt, double simTime);
+		bool IsObjectLocal() { return true; }
 	};
 
 	class SynchronizeAction : public OSCPrivateAction
@@ -499,6 +509,8 @@ namespace scenarioengine
 			(void)simTime;
 		}
 
+		bool IsObjectLocal() { return true; }
+
 		void Start();
 	};
 
@@ -536,6 +548,7 @@ namespace scenarioengine
 		}
 
 		void Step(double dt, double simTime);
+		bool IsObjectLocal() { return true; }
 
 		void Start();
 	};
@@ -568,6 +581,7 @@ namespace scenarioengine
 		}
 
 		void Step(double dt, double simTime) { }  // put driver model here
+		bool IsObjectLocal() { return true; }
 
 		void Start()
 		{
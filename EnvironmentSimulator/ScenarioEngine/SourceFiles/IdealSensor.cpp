@@ -12,8 +12,85 @@
 
 #include "IdealSensor.hpp"
 
+#include <algorithm>
+
 using namespace scenarioengine;
 
+void ObjectGrid::Build(Entities *entities, double cell_size)
+{
+	n_objects_ = (int)entities->object_.size();
+	cell_size_ = MAX(cell_size, SMALL_NUMBER);
+
+	// Number of buckets is power of two, at least twice the number of objects to keep collisions rare
+	unsigned int n_buckets = 16;
+	while (n_buckets < 2 * (unsigned int)n_objects_)
+	{
+		n_buckets *= 2;
+	}
+	bucket_mask_ = n_buckets - 1;
+
+	// Counting sort of objects into buckets, keeping ascending index order within each bucket
+	bucket_start_.assign(n_buckets + 1, 0);
+	object_bucket_.resize(n_objects_);
+	object_idx_.resize(n_objects_);
+
+	for (int i = 0; i < n_objects_; i++)
+	{
+		roadmanager::Position &pos = entities->object_[i]->pos_;
+		object_bucket_[i] = GetBucket((int)floor(pos.GetX() / cell_size_), (int)floor(pos.GetY() / cell_size_));
+		bucket_start_[object_bucket_[i] + 1]++;
+	}
+
+	for (unsigned int i = 0; i < n_buckets; i++)
+	{
+		bucket_start_[i + 1] += bucket_start_[i];
+	}
+
+	std::vector<int> next(bucket_start_.begin(), bucket_start_.end() - 1);
+	for (int i = 0; i < n_objects_; i++)
+	{
+		object_idx_[next[object_bucket_[i]]++] = i;
+	}
+}
+
+void ObjectGrid::Query(double x, double y, double radius, std::vector<int> &candidates, std::vector<unsigned int> &buckets)
+{
+	int cell_x_min = (int)floor((x - radius) / cell_size_);
+	int cell_x_max = (int)floor((x + radius) / cell_size_);
+	int cell_y_min = (int)floor((y - radius) / cell_size_);
+	int cell_y_max = (int)floor((y + radius) / cell_size_);
+
+	candidates.clear();
+
+	if ((double)(cell_x_max - cell_x_min + 1) * (cell_y_max - cell_y_min + 1) > bucket_mask_)
+	{
+		// Covering about as many cells as there are buckets, just return all objects
+		for (int i = 0; i < n_objects_; i++)
+		{
+			candidates.push_back(i);
+		}
+		return;
+	}
+
+	// Cells may share bucket, visit each bucket once
+	buckets.clear();
+	for (int cell_x = cell_x_min; cell_x <= cell_x_max; cell_x++)
+	{
+		for (int cell_y = cell_y_min; cell_y <= cell_y_max; cell_y++)
+		{
+			buckets.push_back(GetBucket(cell_x, cell_y));
+		}
+	}
+	std::sort(buckets.begin(), buckets.end());
+	buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+
+	for (size_t i = 0; i < buckets.size(); i++)
+	{
+		candidates.insert(candidates.end(), object_idx_.begin() + bucket_start_[buckets[i]], 
+			object_idx_.begin() + bucket_start_[buckets[i] + 1]);
+	}
+}
+
 BaseSensor::BaseSensor(BaseSensor::Type type, double pos_x, double pos_y, double pos_z, double heading)
 {
 	type_ = type;
@@ -49,13 +126,39 @@ ObjectSensor::~ObjectSensor()
 	free(hitList_);
 }
 
-void ObjectSensor::Update()
+static bool CompareHitIndex(const std::pair<int, ObjectSensor::ObjectHit> &a, const std::pair<int, ObjectSensor::ObjectHit> &b)
+{
+	return a.first < b.first;
+}
+
+void ObjectSensor::Update(ObjectGrid *grid)
 {
 	nObj_ = 0;
 
-	for (size_t i = 0; i < entities_->object_.size(); i++)
+	// Sensor heading vector and global position, same for all objects
+	double hx2, hy2;
+	RotateVec2D(1.0, 0.0, host_->pos_.GetH(), hx2, hy2);
+
+	double sensor_pos_x, sensor_pos_y;
+	RotateVec2D(pos_.x, pos_.y, host_->pos_.GetH(), sensor_pos_x, sensor_pos_y);
+	pos_.x_global = host_->pos_.GetX() + sensor_pos_x;
+	pos_.y_global = host_->pos_.GetY() + sensor_pos_y;
+	pos_.z_global = host_->pos_.GetZ() + pos_.z;
+
+	double sensor_heading = GetAngleSum(host_->pos_.GetH(), pos_.h);
+
+	size_t n_candidates = entities_->object_.size();
+	if (grid)
+	{
+		grid->Query(pos_.x_global, pos_.y_global, far_, candidates_, query_buckets_);
+		n_candidates = candidates_.size();
+		hits_.clear();
+	}
+
+	for (size_t i = 0; i < n_candidates && nObj_ < maxObj_; i++)
 	{
-		Object *obj = entities_->object_[i];
+		int idx = grid ? candidates_[i] : (int)i;
+		Object *obj = entities_->object_[idx];
 		if (obj == host_ || obj->control_ == Object::Control::HYBRID_GHOST)
 		{
 			// skip own vehicle and any ghost vehicles
@@ -64,18 +167,6 @@ void ObjectSensor::Update()
 
 		// Check whether object is within field of view
 
-		// find out angle between heading vector and line to object
-		double hx = 1.0;
-		double hy = 0.0;
-		double hx2, hy2;
-		RotateVec2D(hx, hy, host_->pos_.GetH(), hx2, hy2);
-
-		double sensor_pos_x, sensor_pos_y;
-		RotateVec2D(pos_.x, pos_.y, host_->pos_.GetH(), sensor_pos_x, sensor_pos_y);
-		pos_.x_global = host_->pos_.GetX() + sensor_pos_x;
-		pos_.y_global = host_->pos_.GetY() + sensor_pos_y;
-		pos_.z_global = host_->pos_.GetZ() + pos_.z;
-
 		// Find vector from host to object
 		double xo = obj->pos_.GetX() - pos_.x_global;
 		double yo = obj->pos_.GetY() - pos_.y_global;
@@ -88,6 +179,7 @@ void ObjectSensor::Update()
 			continue;
 		}
 
+		// find out angle between heading vector and line to object
 		double xon, yon;
 		NormalizeVec2D(xo, yo, xon, yon);
 
@@ -96,16 +188,35 @@ void ObjectSensor::Update()
 		double rel_angle = GetAbsAngleDifference(angle, pos_.h);
 		if (rel_angle < fovH_/2)
 		{
-			hitList_[nObj_].obj_ = obj;
+			ObjectHit hit;
+			hit.obj_ = obj;
 
 			// Calculate hit object position in sensor local coordinates
 			double xl, yl;
-			RotateVec2D(xo, yo, -GetAngleSum(host_->pos_.GetH(), pos_.h), xl, yl);
+			RotateVec2D(xo, yo, -sensor_heading, xl, yl);
+
+			hit.x_ = xl;
+			hit.y_ = yl;
+			hit.z_ = obj->pos_.GetZ() - pos_.z_global + 0.7;
+
+			if (grid)
+			{
+				hits_.push_back(std::make_pair(idx, hit));
+			}
+			else
+			{
+				hitList_[nObj_++] = hit;
+			}
+		}
+	}
 
-			hitList_[nObj_].x_ = xl;
-			hitList_[nObj_].y_ = yl;
-			hitList_[nObj_].z_ = obj->pos_.GetZ() - pos_.z_global + 0.7;
-			nObj_++;
+	if (grid)
+	{
+		// Report objects in the same order as when checking all of them
+		std::sort(hits_.begin(), hits_.end(), CompareHitIndex);
+		for (size_t i = 0; i < hits_.size() && nObj_ < maxObj_; i++)
+		{
+			hitList_[nObj_++] = hits_[i].second;
 		}
 	}
-}
\ No newline at end of file
+}
@@ -16,6 +16,48 @@
 
 namespace scenarioengine
 {
+	/**
+	Spatial hash of object positions, to find objects close to a point without checking all of them.
+	Objects are sorted into square cells, which in turn are hashed into a bucket table sized by the
+	number of objects. Rebuild whenever objects have moved, typically once per step.
+	*/
+	class ObjectGrid
+	{
+	public:
+		ObjectGrid() : cell_size_(1.0), bucket_mask_(0), n_objects_(0) {}
+
+		/**
+		Sort objects into cells by their current position
+		@param entities The objects
+		@param cell_size Side length of the cells, preferably in the order of the query radius
+		*/
+		void Build(Entities *entities, double cell_size);
+
+		/**
+		Find objects within distance from a point. The result is a superset, it may include objects 
+		further away, so distance still needs to be checked.
+		@param x X coordinate of the point
+		@param y Y coordinate of the point
+		@param radius Search distance
+		@param candidates Filled with indices into the entities object list, each once but in no particular order
+		@param buckets Scratch storage, reused between calls. Owned by the caller since the grid may be queried concurrently.
+		*/
+		void Query(double x, double y, double radius, std::vector<int> &candidates, std::vector<unsigned int> &buckets);
+
+	private:
+		double cell_size_;
+		unsigned int bucket_mask_;
+		int n_objects_;
+		std::vector<int> bucket_start_;  // index of first object per bucket in object_idx_, one extra entry at end
+		std::vector<int> object_idx_;  // object indices, grouped by bucket and ascending within each
+		std::vector<unsigned int> object_bucket_;
+
+		unsigned int GetBucket(int cell_x, int cell_y)
+		{
+			return ((unsigned int)cell_x * 73856093u ^ (unsigned int)cell_y * 19349663u) & bucket_mask_;
+		}
+	};
+
 	typedef struct
 	{
 		double x;
@@ -74,11 +116,20 @@ namespace scenarioengine
 		ObjectSensor(Entities *entities, Object *refobj, double pos_x, double pos_y, double pos_z, double heading, 
 			double near, double far, double fovH, int maxObj);
 		~ObjectSensor();
-		void Update();
+		void Update() { Update(0); }
+
+		/**
+		Identify objects within field of view
+		@param grid Spatial hash of current object positions, to limit the check to nearby objects. 0 checks all objects.
+		*/
+		void Update(ObjectGrid *grid);
 
 	private:
 
 		Entities *entities_;   // Reference to the global collection of objects within the scenario
+		std::vector<int> candidates_;  // Indices of objects close enough to check, from grid
+		std::vector<unsigned int> query_buckets_;  // Grid query scratch storage
+		std::vector<std::pair<int, ObjectHit>> hits_;  // Identified objects by index, to be sorted in object order
 
 	};
 
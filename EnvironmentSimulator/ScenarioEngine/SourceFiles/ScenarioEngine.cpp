@@ -15,12 +15,14 @@
 
 using namespace scenarioengine;
 
-ScenarioEngine::ScenarioEngine(std::string oscFilename, double headstart_time, RequestControlMode control_mode_first_vehicle)
+ScenarioEngine::ScenarioEngine(std::string oscFilename, double headstart_time, RequestControlMode control_mode_first_vehicle) :
+	scenarioReader(0), odrManager(0), event_driven_(false), object_dt_(0)
 {
 	InitScenario(oscFilename, headstart_time, control_mode_first_vehicle);
 }
 
-ScenarioEngine::ScenarioEngine(const pugi::xml_document &xml_doc, double headstart_time, RequestControlMode control_mode_first_vehicle)
+ScenarioEngine::ScenarioEngine(const pugi::xml_document &xml_doc, double headstart_time, RequestControlMode control_mode_first_vehicle) :
+	scenarioReader(0), odrManager(0), event_driven_(false), object_dt_(0)
 {
 	InitScenario(xml_doc, headstart_time, control_mode_first_vehicle);
 }
@@ -37,6 +39,14 @@ void ScenarioEngine::InitScenario(std::string oscFilename, double headstart_time
 		throw std::invalid_argument(std::string("Failed to load OpenSCENARIO file ") + oscFilename);
 	}
 
+	for (size_t i = 0; i < parameter_overrides_.size(); i++)
+	{
+		if (scenarioReader->SetParameterValue(parameter_overrides_[i].first, parameter_overrides_[i].second) != 0)
+		{
+			throw std::invalid_argument(std::string("Failed to set parameter ") + parameter_overrides_[i].first);
+		}
+	}
+
 	parseScenario(control_mode_first_vehicle);
 }
 
@@ -45,17 +55,31 @@ void ScenarioEngine::InitScenario(const pugi::xml_document &xml_doc, double head
 	LOG("Init %s", xml_doc.name());
 	quit_flag = false;
 	headstart_time_ = headstart_time;
+	scenarioReader = new ScenarioReader(&entities, &catalogs);
 	scenarioReader->loadOSCMem(xml_doc);
 	parseScenario(control_mode_first_vehicle);
 }
 
 ScenarioEngine::~ScenarioEngine()
 {
+	size_t trail_memory = GetTrailMemoryUsage();
+	if (trail_memory > 0)
+	{
+		LOG("Trail memory usage: %d kB", (int)(trail_memory / 1024));
+	}
+	delete scenarioReader;
 	LOG("Closing");
 }
 
+void ScenarioEngine::SetParameterValue(std::string name, std::string value)
+{
+	parameter_overrides_.push_back(std::make_pair(name, value));
+}
+
 void ScenarioEngine::step(double deltaSimTime, bool initial)	
 {
+	roadmanager::OpenDriveThreadBinding odr_binding(odrManager);
+
 	simulationTime += deltaSimTime;
 
 	if (entities.object_.size() == 0)
@@ -71,18 +95,21 @@ void ScenarioEngine::step(double deltaSimTime, bool initial)
 			if (entities.object_[i]->control_ == Object::Control::EXTERNAL ||
 				entities.object_[i]->control_ == Object::Control::HYBRID_EXTERNAL)
 			{
-				ObjectState o;
+				ObjectState *o = scenarioGateway.getObjectStatePtrById(entities.object_[i]->id_);
 
-				if (scenarioGateway.getObjectStateById(entities.object_[i]->id_, o) != 0)
+				if (o == 0)
 				{
 					LOG("Gateway did not provide state for external car %d", entities.object_[i]->id_);
 				}
 				else
 				{
-					entities.object_[i]->pos_ = o.state_.pos;
-					entities.object_[i]->speed_ = o.state_.speed;
-					entities.object_[i]->wheel_angle_ = o.state_.wheel_angle;
-					entities.object_[i]->wheel_rot_ = o.state_.wheel_rot;
+					// Keep the random number stream of the entity
+					SE_Random rand = entities.object_[i]->pos_.GetRandomStream();
+					entities.object_[i]->pos_ = o->state_.pos;
+					entities.object_[i]->pos_.SetRandomStream(rand);
+					entities.object_[i]->speed_ = o->state_.speed;
+					entities.object_[i]->wheel_angle_ = o->state_.wheel_angle;
+					entities.object_[i]->wheel_rot_ = o->state_.wheel_rot;
 				}
 			}
 		}
@@ -100,15 +127,7 @@ void ScenarioEngine::step(double deltaSimTime, bool initial)
 	}
 
 	// Step inital actions - might be extened in time (more than one step)
-	for (size_t i = 0; i < init.private_action_.size(); i++)
-	{
-		if (init.private_action_[i]->IsActive())
-		{
-			//LOG("Stepping action of type %d", init.private_action_[i]->action_[j]->type_)
-			init.private_action_[i]->Step(deltaSimTime, getSimulationTime());
-			init.private_action_[i]->UpdateState();
-		}
-	}
+	StepInitActions(deltaSimTime);
 
 	// Story 
 	
@@ -119,159 +138,7 @@ void ScenarioEngine::step(double deltaSimTime, bool initial)
 		return;
 	}
 
-	bool all_done = true;
-	for (size_t i = 0; i < storyBoard.story_.size(); i++)
-	{
-		Story *story = storyBoard.story_[i];
-
-		for (size_t j = 0; j < story->act_.size(); j++)
-		{
-			Act *act = story->act_[j];
-
-			// Update elements' state - moving from transitions to stable states
-			for (size_t k = 0; k < act->maneuverGroup_.size(); k++)
-			{
-				for (size_t l = 0; l < act->maneuverGroup_[k]->maneuver_.size(); l++)
-				{
-					OSCManeuver *maneuver = act->maneuverGroup_[k]->maneuver_[l];
-
-					for (size_t m = 0; m < maneuver->event_.size(); m++)
-					{
-						for (size_t n = 0; n < maneuver->event_[m]->action_.size(); n++)
-						{
-							maneuver->event_[m]->action_[n]->UpdateState();
-						}
-						maneuver->event_[m]->UpdateState();
-					}
-				}
-			}
-
-			act->UpdateState();
-
-			if (act->IsTriggable())
-			{
-				// Check start conditions
-				if (!act->start_trigger_)
-				{
-					// Start act even if there's no trigger
-					act->Start();
-				}
-				else if (act->start_trigger_->Evaluate(&storyBoard, simulationTime) == true)
-				{
-					act->Start();
-				}
-			}
-
-			if (act->IsActive() && act->stop_trigger_)
-			{
-				if (act->stop_trigger_->Evaluate(&storyBoard, simulationTime) == true)
-				{
-					act->End();
-				}
-			}
-
-			// Check whether all acts are done
-			all_done = all_done && act->state_ == Act::State::COMPLETE;
-
-			// Maneuvers
-			if (act->IsActive())
-			{
-				for (size_t k = 0; k < act->maneuverGroup_.size(); k++)
-				{
-					for (size_t l = 0; l < act->maneuverGroup_[k]->maneuver_.size(); l++)
-					{
-						OSCManeuver *maneuver = act->maneuverGroup_[k]->maneuver_[l];
-
-						for (size_t m = 0; m < maneuver->event_.size(); m++)
-						{
-							Event *event = maneuver->event_[m];
-
-							if (event->IsTriggable())
-							{
-								// Check event conditions
-								if (event->start_trigger_->Evaluate(&storyBoard, simulationTime) == true)
-								{
-									// Check priority
-									if (event->priority_ == Event::Priority::OVERWRITE)
-									{
-										// Activate trigged event
-										if (event->IsActive())
-										{
-											LOG("Can't overwrite own running event (%s) - skip trig", event->name_.c_str());
-										}
-										else
-										{
-											// Deactivate any currently active event
-											for (size_t n = 0; n < maneuver->event_.size(); n++)
-											{
-												if (maneuver->event_[n]->IsActive())
-												{
-													maneuver->event_[n]->End();
-													LOG("Event %s ended, overwritten by event %s",
-														maneuver->event_[n]->name_.c_str(), event->name_.c_str());
-												}
-											}
-
-											event->Start();
-										}
-									}
-									else if (event->priority_ == Event::Priority::SKIP)
-									{
-										if (maneuver->IsAnyEventActive())
-										{
-											LOG("Event is running, skipping trigged %s", event->name_.c_str());
-										}
-										else
-										{
-											event->Start();
-										}
-									}
-									else if (event->priority_ == Event::Priority::PARALLEL)
-									{
-										// Don't care if any other action is ongoing, launch anyway
-										if (event->IsActive())
-										{
-											LOG("Event %s already running, trigger ignored", event->name_.c_str());
-										}
-										else if (maneuver->IsAnyEventActive())
-										{
-											LOG("Event(s) ongoing, %s will run in parallel", event->name_.c_str());
-										}
-										event->Start();
-									}
-									else
-									{
-										LOG("Unknown event priority: %d", event->priority_);
-									}
-								}
-							}
-
-							// Update (step) all active actions, for all objects connected to the action
-							if (event->IsActive())
-							{
-								bool active = false;
-
-								for (size_t n = 0; n < event->action_.size(); n++)
-								{
-									if (event->action_[n]->IsActive())
-									{
-										event->action_[n]->Step(deltaSimTime, getSimulationTime());
-										
-										active = active || (event->action_[n]->IsActive());
-									}
-								}
-								if (!active)
-								{
-									// Actions done -> Set event done
-									event->End();
-								}
-							}
-						}
-					}
-				}
-			}
-		}
-	}
+	bool all_done = event_driven_ ? StepLiveStory(deltaSimTime) : StepStory(deltaSimTime);
 
 	// Report resulting states to the gateway
 	for (size_t i = 0; i < entities.object_.size(); i++)
@@ -293,6 +160,8 @@ void ScenarioEngine::step(double deltaSimTime, bool initial)
 		}
 	}
 
+	scenarioGateway.PublishFrame(simulationTime);
+
 	stepObjects(deltaSimTime);
 
 	if (all_done)
@@ -351,6 +220,9 @@ void ScenarioEngine::ResolveHybridVehicles()
 			// Add "_ghost" to original vehicle name
 			entities.object_[i]->name_.append("_ghost");
 
+			// The external buddy will follow the trail of the ghost
+			entities.object_[i]->trail_.Enable();
+
 			// Adjust some properties for the externally controlled buddy
 			external_vehicle->control_ = Object::Control::HYBRID_EXTERNAL;
 			// Connect external vehicle to the ghost
@@ -379,8 +251,22 @@ void ScenarioEngine::parseScenario(RequestControlMode control_mode_first_vehicle
 
 	// Init road manager
 	scenarioReader->parseRoadNetwork(roadNetwork);
-	roadmanager::Position::LoadOpenDrive(getOdrFilename().c_str());
-	odrManager = roadmanager::Position::GetOpenDrive();
+	if (odrManager && odrManager->GetOpenDriveFilename() == getOdrFilename())
+	{
+		LOG("Using already loaded road network %s", getOdrFilename().c_str());
+	}
+	else
+	{
+		if (odrManager)
+		{
+			LOG("Provided road network %s does not match scenario, loading %s", 
+				odrManager->GetOpenDriveFilename().c_str(), getOdrFilename().c_str());
+		}
+		roadmanager::Position::LoadOpenDrive(getOdrFilename().c_str());
+		odrManager = roadmanager::Position::GetDefaultOpenDrive();
+	}
+
+	roadmanager::OpenDriveThreadBinding odr_binding(odrManager);
 
 	scenarioReader->parseCatalogs();
 	scenarioReader->parseEntities();
@@ -391,6 +277,14 @@ void ScenarioEngine::parseScenario(RequestControlMode control_mode_first_vehicle
 		entities.object_[0]->SetControl(RequestControl2ObjectControl(control_mode_first_vehicle));
 	}
 	ResolveHybridVehicles();
+
+	// Each entity draws from its own random number stream, making its choices reproducible given the seed
+	LOG("Random seed %u", SE_Random::GetGlobalSeed());
+	for (size_t i = 0; i < entities.object_.size(); i++)
+	{
+		entities.object_[i]->pos_.SetRandomStream(entities.object_[i]->id_);
+	}
+
 	scenarioReader->parseInit(init);
 	scenarioReader->parseStoryBoard(storyBoard);
 
@@ -408,7 +302,27 @@ void ScenarioEngine::parseScenario(RequestControlMode control_mode_first_vehicle
 		}
 	}
 
-	
+	// Group init actions per object, for parallel stepping
+	size_t num_grouped_actions = 0;
+	object_init_action_.resize(entities.object_.size());
+	for (size_t i = 0; i < init.private_action_.size(); i++)
+	{
+		for (size_t j = 0; j < entities.object_.size(); j++)
+		{
+			if (init.private_action_[i]->object_ == entities.object_[j])
+			{
+				object_init_action_[j].push_back(init.private_action_[i]);
+				num_grouped_actions++;
+				break;
+			}
+		}
+	}
+	if (num_grouped_actions != init.private_action_.size())
+	{
+		// Some action refers to an unknown object, step all in sequence
+		object_init_action_.clear();
+	}
+
 	for (size_t i = 0; i < entities.object_.size(); i++)
 	{
 		if (entities.object_[i]->control_ == Object::Control::HYBRID_GHOST)
@@ -432,40 +346,421 @@ void ScenarioEngine::parseScenario(RequestControlMode control_mode_first_vehicle
 	entities.Print();
 
 	storyBoard.Print();
+
+	BuildLiveStory();
 }
 
-void ScenarioEngine::stepObjects(double dt)
+void ScenarioEngine::EnableTrails(int max_states, double dt)
 {
 	for (size_t i = 0; i < entities.object_.size(); i++)
 	{
-		Object *obj = entities.object_[i];
+		entities.object_[i]->trail_.Enable(max_states, dt);
+	}
+	LOG("Trails enabled for %d objects, max %d states (%d kB) each, dt %.2f", (int)entities.object_.size(), 
+		max_states, (int)(max_states * sizeof(ObjectTrailState) / 1024), dt);
+}
 
-		if ((simulationTime > 0 && obj->control_ == Object::Control::INTERNAL) ||
-			obj->control_ == Object::Control::HYBRID_GHOST)
+size_t ScenarioEngine::GetTrailMemoryUsage()
+{
+	size_t size = 0;
+	for (size_t i = 0; i < entities.object_.size(); i++)
+	{
+		size += entities.object_[i]->trail_.GetMemoryUsage();
+	}
+	return size;
+}
+
+void ScenarioEngine::SetObjectThreads(int n_threads)
+{
+	object_pool_.Start(MAX(0, n_threads - 1));
+	LOG("Step objects using %d thread%s", object_pool_.GetNumberOfWorkers() + 1, object_pool_.GetNumberOfWorkers() > 0 ? "s" : "");
+}
+
+void ScenarioEngine::SetEventDriven(bool event_driven)
+{
+	if (event_driven && !event_driven_)
+	{
+		// Pending flags are not maintained in default mode, revisit all live events once
+		for (size_t i = 0; i < live_act_.size(); i++)
+		{
+			live_act_[i].pending = true;
+		}
+	}
+	event_driven_ = event_driven;
+}
+
+void ScenarioEngine::BuildLiveStory()
+{
+	live_act_.clear();
+
+	for (size_t i = 0; i < storyBoard.story_.size(); i++)
+	{
+		Story *story = storyBoard.story_[i];
+
+		for (size_t j = 0; j < story->act_.size(); j++)
 		{
-			double steplen = obj->speed_ * dt;
+			LiveAct live_act;
+			live_act.act = story->act_[j];
+			live_act.pending = true;
 
-			if (obj->pos_.GetRoute())
+			for (size_t k = 0; k < live_act.act->maneuverGroup_.size(); k++)
 			{
-				obj->pos_.MoveRouteDS(steplen);
+				for (size_t l = 0; l < live_act.act->maneuverGroup_[k]->maneuver_.size(); l++)
+				{
+					OSCManeuver *maneuver = live_act.act->maneuverGroup_[k]->maneuver_[l];
+
+					for (size_t m = 0; m < maneuver->event_.size(); m++)
+					{
+						LiveEvent live_event = { maneuver, maneuver->event_[m] };
+						live_act.event.push_back(live_event);
+					}
+				}
 			}
-			else if (obj->pos_.GetTrajectory())
+			live_act_.push_back(live_act);
+		}
+	}
+}
+
+static void UpdateEventState(Event *event)
+{
+	for (size_t i = 0; i < event->action_.size(); i++)
+	{
+		event->action_[i]->UpdateState();
+	}
+	event->UpdateState();
+}
+
+static bool IsUpdatePending(StoryBoardElement *element)
+{
+	return element->next_state_ != element->state_ || 
+		element->transition_ != StoryBoardElement::Transition::UNDEFINED_ELEMENT_TRANSITION;
+}
+
+void ScenarioEngine::StepAct(Act *act)
+{
+	if (act->IsTriggable())
+	{
+		// Check start conditions
+		if (!act->start_trigger_)
+		{
+			// Start act even if there's no trigger
+			act->Start();
+		}
+		else if (act->start_trigger_->Evaluate(&storyBoard, simulationTime) == true)
+		{
+			act->Start();
+		}
+	}
+
+	if (act->IsActive() && act->stop_trigger_)
+	{
+		if (act->stop_trigger_->Evaluate(&storyBoard, simulationTime) == true)
+		{
+			act->End();
+		}
+	}
+}
+
+void ScenarioEngine::StepEvent(OSCManeuver *maneuver, Event *event, double dt)
+{
+	if (event->IsTriggable())
+	{
+		// Check event conditions
+		if (event->start_trigger_->Evaluate(&storyBoard, simulationTime) == true)
+		{
+			// Check priority
+			if (event->priority_ == Event::Priority::OVERWRITE)
 			{
-				// Do nothing - updates handled by followTrajectoryAction
+				// Activate trigged event
+				if (event->IsActive())
+				{
+					LOG("Can't overwrite own running event (%s) - skip trig", event->name_.c_str());
+				}
+				else
+				{
+					// Deactivate any currently active event
+					for (size_t n = 0; n < maneuver->event_.size(); n++)
+					{
+						if (maneuver->event_[n]->IsActive())
+						{
+							maneuver->event_[n]->End();
+							LOG("Event %s ended, overwritten by event %s",
+								maneuver->event_[n]->name_.c_str(), event->name_.c_str());
+						}
+					}
+
+					event->Start();
+				}
+			}
+			else if (event->priority_ == Event::Priority::SKIP)
+			{
+				if (maneuver->IsAnyEventActive())
+				{
+					LOG("Event is running, skipping trigged %s", event->name_.c_str());
+				}
+				else
+				{
+					event->Start();
+				}
+			}
+			else if (event->priority_ == Event::Priority::PARALLEL)
+			{
+				// Don't care if any other action is ongoing, launch anyway
+				if (event->IsActive())
+				{
+					LOG("Event %s already running, trigger ignored", event->name_.c_str());
+				}
+				else if (maneuver->IsAnyEventActive())
+				{
+					LOG("Event(s) ongoing, %s will run in parallel", event->name_.c_str());
+				}
+				event->Start();
+			}
+			else
+			{
+				LOG("Unknown event priority: %d", event->priority_);
+			}
+		}
+	}
+
+	// Update (step) all active actions, for all objects connected to the action
+	if (event->IsActive())
+	{
+		bool active = false;
+
+		for (size_t n = 0; n < event->action_.size(); n++)
+		{
+			if (event->action_[n]->IsActive())
+			{
+				event->action_[n]->Step(dt, getSimulationTime());
+				
+				active = active || (event->action_[n]->IsActive());
+			}
+		}
+		if (!active)
+		{
+			// Actions done -> Set event done
+			event->End();
+		}
+	}
+}
+
+bool ScenarioEngine::StepStory(double dt)
+{
+	bool all_done = true;
+	for (size_t i = 0; i < storyBoard.story_.size(); i++)
+	{
+		Story *story = storyBoard.story_[i];
+
+		for (size_t j = 0; j < story->act_.size(); j++)
+		{
+			Act *act = story->act_[j];
+
+			// Update elements' state - moving from transitions to stable states
+			for (size_t k = 0; k < act->maneuverGroup_.size(); k++)
+			{
+				for (size_t l = 0; l < act->maneuverGroup_[k]->maneuver_.size(); l++)
+				{
+					OSCManeuver *maneuver = act->maneuverGroup_[k]->maneuver_[l];
+
+					for (size_t m = 0; m < maneuver->event_.size(); m++)
+					{
+						UpdateEventState(maneuver->event_[m]);
+					}
+				}
+			}
+
+			act->UpdateState();
+
+			StepAct(act);
+
+			// Check whether all acts are done
+			all_done = all_done && act->state_ == Act::State::COMPLETE;
+
+			// Maneuvers
+			if (act->IsActive())
+			{
+				for (size_t k = 0; k < act->maneuverGroup_.size(); k++)
+				{
+					for (size_t l = 0; l < act->maneuverGroup_[k]->maneuver_.size(); l++)
+					{
+						OSCManeuver *maneuver = act->maneuverGroup_[k]->maneuver_[l];
+
+						for (size_t m = 0; m < maneuver->event_.size(); m++)
+						{
+							StepEvent(maneuver, maneuver->event_[m], dt);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return all_done;
+}
+
+bool ScenarioEngine::StepLiveStory(double dt)
+{
+	// Same sequence as StepStory, skipping elements which can't change state. Events and actions are only 
+	// started, ended or stepped by their running act. Hence events of other acts are left untouched until 
+	// any pending update has been applied, and completed events and acts stay completed.
+	bool all_done = true;
+	for (size_t i = 0; i < live_act_.size(); )
+	{
+		LiveAct &live_act = live_act_[i];
+		Act *act = live_act.act;
+		bool visit_events = act->IsActive() || live_act.pending;
+
+		if (visit_events)
+		{
+			for (size_t j = 0; j < live_act.event.size(); j++)
+			{
+				UpdateEventState(live_act.event[j].event);
 			}
-			else 
+		}
+
+		act->UpdateState();
+
+		StepAct(act);
+
+		all_done = all_done && act->state_ == Act::State::COMPLETE;
+
+		if (act->IsActive())
+		{
+			for (size_t j = 0; j < live_act.event.size(); j++)
+			{
+				StepEvent(live_act.event[j].maneuver, live_act.event[j].event, dt);
+			}
+			visit_events = true;
+		}
+
+		if (visit_events)
+		{
+			// Drop completed events and find out whether any update is left for next step
+			size_t n_live = 0;
+			live_act.pending = false;
+			for (size_t j = 0; j < live_act.event.size(); j++)
 			{
-				// Adjustment movement to heading and road direction 
-				if (GetAbsAngleDifference(obj->pos_.GetH(), obj->pos_.GetDrivingDirection()) > M_PI_2)
+				Event *event = live_act.event[j].event;
+				bool pending = IsUpdatePending(event);
+
+				for (size_t k = 0; k < event->action_.size() && !pending; k++)
+				{
+					pending = IsUpdatePending(event->action_[k]);
+				}
+
+				if (pending || event->state_ != Event::State::COMPLETE)
 				{
-					// If pointing in other direction 
-					steplen *= -1;
+					live_act.event[n_live++] = live_act.event[j];
 				}
-				obj->pos_.MoveAlongS(steplen);
+				live_act.pending = live_act.pending || pending;
+			}
+			live_act.event.resize(n_live);
+		}
+
+		if (act->state_ == Act::State::COMPLETE && !IsUpdatePending(act) && !live_act.pending)
+		{
+			live_act_.erase(live_act_.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	return all_done;
+}
+
+void ScenarioEngine::StepInitActions(double dt)
+{
+	bool parallel = object_pool_.GetNumberOfWorkers() > 0 && object_init_action_.size() > 0;
+
+	for (size_t i = 0; parallel && i < init.private_action_.size(); i++)
+	{
+		if (init.private_action_[i]->IsActive() && !init.private_action_[i]->IsObjectLocal())
+		{
+			parallel = false;
+		}
+	}
+
+	if (parallel)
+	{
+		// Actions of different objects are independent, and each object steps its own in init order
+		object_dt_ = dt;
+		object_pool_.Run(StepObjectInitActionsTask, (int)object_init_action_.size(), this);
+		return;
+	}
+
+	for (size_t i = 0; i < init.private_action_.size(); i++)
+	{
+		if (init.private_action_[i]->IsActive())
+		{
+			//LOG("Stepping action of type %d", init.private_action_[i]->action_[j]->type_)
+			init.private_action_[i]->Step(dt, getSimulationTime());
+			init.private_action_[i]->UpdateState();
+		}
+	}
+}
+
+void ScenarioEngine::StepObjectInitActionsTask(int index, void *args)
+{
+	ScenarioEngine *engine = (ScenarioEngine*)args;
+	std::vector<OSCPrivateAction*> &action = engine->object_init_action_[index];
+
+	roadmanager::OpenDriveThreadBinding odr_binding(engine->odrManager);
+
+	for (size_t i = 0; i < action.size(); i++)
+	{
+		if (action[i]->IsActive())
+		{
+			action[i]->Step(engine->object_dt_, engine->getSimulationTime());
+			action[i]->UpdateState();
+		}
+	}
+}
+
+void ScenarioEngine::StepObjectTask(int index, void *args)
+{
+	ScenarioEngine *engine = (ScenarioEngine*)args;
+
+	roadmanager::OpenDriveThreadBinding odr_binding(engine->odrManager);
+
+	engine->StepObject(engine->entities.object_[index], engine->object_dt_);
+}
+
+void ScenarioEngine::stepObjects(double dt)
+{
+	object_dt_ = dt;
+	object_pool_.Run(StepObjectTask, (int)entities.object_.size(), this);
+}
+
+void ScenarioEngine::StepObject(Object *obj, double dt)
+{
+	if ((simulationTime > 0 && obj->control_ == Object::Control::INTERNAL) ||
+		obj->control_ == Object::Control::HYBRID_GHOST)
+	{
+		double steplen = obj->speed_ * dt;
+
+		if (obj->pos_.GetRoute())
+		{
+			obj->pos_.MoveRouteDS(steplen);
+		}
+		else if (obj->pos_.GetTrajectory())
+		{
+			// Do nothing - updates handled by followTrajectoryAction
+		}
+		else 
+		{
+			// Adjustment movement to heading and road direction 
+			if (GetAbsAngleDifference(obj->pos_.GetH(), obj->pos_.GetDrivingDirection()) > M_PI_2)
+			{
+				// If pointing in other direction 
+				steplen *= -1;
 			}
-			obj->odometer_ += abs(steplen);  // odometer always measure all movements as positive, I guess...
+			obj->pos_.MoveAlongS(steplen);
 		}
-		obj->trail_.AddState((float)simulationTime, (float)obj->pos_.GetX(), (float)obj->pos_.GetY(), (float)obj->pos_.GetZ(), (float)obj->speed_);
+		obj->odometer_ += abs(steplen);  // odometer always measure all movements as positive, I guess...
 	}
+	obj->trail_.AddState((float)simulationTime, (float)obj->pos_.GetX(), (float)obj->pos_.GetY(), (float)obj->pos_.GetZ(), (float)obj->speed_);
 }
 
@@ -49,9 +49,59 @@ namespace scenarioengine
 
 		ScenarioEngine(std::string oscFilename, double headstart_time = DEFAULT_HEADSTART_TIME, RequestControlMode control_mode_first_vehicle = CONTROL_BY_OSC);
 		ScenarioEngine(const pugi::xml_document &xml_doc, double headstart_time = DEFAULT_HEADSTART_TIME, RequestControlMode control_mode_first_vehicle = CONTROL_BY_OSC);
-		ScenarioEngine() {};
+		ScenarioEngine() : scenarioReader(0), odrManager(0), event_driven_(false), object_dt_(0) {};
 		~ScenarioEngine();
 
+		/**
+		Use an already loaded road network, e.g. shared with other engines, instead of loading the 
+		one referenced by the scenario. The engine only reads it. Must be called before InitScenario. 
+		If the network does not match the one referenced by the scenario it will be ignored.
+		@param odr Road network, must outlive the engine
+		*/
+		void SetOpenDrive(roadmanager::OpenDrive *odr) { odrManager = odr; }
+
+		/**
+		Override the value of a global parameter declared in the scenario. Must be called
+		before InitScenario, the value will be applied once the scenario file is loaded.
+		@param name Name of the parameter
+		@param value New value
+		*/
+		void SetParameterValue(std::string name, std::string value);
+
+		/**
+		Evaluate the story event driven: completed acts and events are dropped, and events of acts not 
+		running are skipped unless they have a state update pending. Outcome is identical to the default 
+		evaluation, but the cost per step scales with the number of live elements instead of the size of 
+		the storyboard. May be called at any time.
+		@param event_driven true for event driven evaluation, false to visit the complete story tree each step
+		*/
+		void SetEventDriven(bool event_driven);
+		bool GetEventDriven() { return event_driven_; }
+
+		/**
+		Step objects in parallel: their motion along road, route or trajectory, and init actions 
+		stepping only their own object (see OSCPrivateAction::IsObjectLocal). As long as any init 
+		action depends on another object, all init actions are stepped in sequence. Each object is 
+		updated by one thread in the same order as sequential execution, so results do not depend on 
+		the number of threads.
+		@param n_threads Number of threads, including the one calling step. 1 for sequential updates.
+		*/
+		void SetObjectThreads(int n_threads);
+
+		/**
+		Record trails of all objects. By default only ghosts record a trail, to be followed by their 
+		externally controlled buddy. Any already recorded states are discarded.
+		@param max_states Capacity of each trail, when reached the oldest states will be overwritten
+		@param dt Minimum time between recorded states
+		*/
+		void EnableTrails(int max_states = TRAIL_MAX_STATES, double dt = TRAIL_DT);
+
+		/**
+		Get memory allocated by the trails of all objects
+		@return Number of bytes
+		*/
+		size_t GetTrailMemoryUsage();
+
 		void InitScenario(std::string oscFilename, double headstart_time, RequestControlMode control_mode_first_vehicle = CONTROL_BY_OSC);
 		void InitScenario(const pugi::xml_document &xml_doc, double headstart_time, RequestControlMode control_mode_first_vehicle = CONTROL_BY_OSC);
 
@@ -88,8 +138,42 @@ namespace scenarioengine
 		// execution control flags
 		bool quit_flag;
 
+		// global parameter values overriding the ones in the scenario file
+		std::vector<std::pair<std::string, std::string>> parameter_overrides_;
+
+		// Event driven story evaluation, see SetEventDriven()
+		typedef struct
+		{
+			OSCManeuver *maneuver;
+			Event *event;
+		} LiveEvent;
+
+		typedef struct
+		{
+			Act *act;
+			std::vector<LiveEvent> event;  // events not yet completed, in story order
+			bool pending;  // any of the events or their actions has a state update pending
+		} LiveAct;
+
+		bool event_driven_;
+		std::vector<LiveAct> live_act_;  // acts not yet completed, in story order
+
+		// Parallel object updates, see SetObjectThreads()
+		SE_TaskPool object_pool_;
+		std::vector<std::vector<OSCPrivateAction*>> object_init_action_;  // init actions per object, in init order
+		double object_dt_;  // step size passed to the object tasks
+
 		void parseScenario(RequestControlMode control_mode_first_vehicle = CONTROL_BY_OSC);
 		void ResolveHybridVehicles();
+		void StepInitActions(double dt);
+		void StepObject(Object *obj, double dt);
+		static void StepObjectInitActionsTask(int index, void *args);
+		static void StepObjectTask(int index, void *args);
+		void BuildLiveStory();
+		void StepAct(Act *act);
+		void StepEvent(OSCManeuver *maneuver, Event *event, double dt);
+		bool StepStory(double dt);
+		bool StepLiveStory(double dt);
 	};
 
 }
@@ -13,6 +13,7 @@
 #include "ScenarioGateway.hpp"
 #include "CommonMini.hpp"
 #include "Replay.hpp"
+#include "SharedState.hpp"
 
 using namespace scenarioengine;
 
@@ -20,11 +21,12 @@ using namespace scenarioengine;
 ObjectState::ObjectState()
 {
 	memset(&state_, 0, sizeof(ObjectState));
+	state_.pos.Init();
 	state_.id = -1;
 }
 
 
-ObjectState::ObjectState(int id, std::string name, int model_id, int control, double timestamp, double speed, double wheel_angle, double wheel_rot, roadmanager::Position *pos)
+ObjectState::ObjectState(int id, const std::string &name, int model_id, int control, double timestamp, double speed, double wheel_angle, double wheel_rot, roadmanager::Position *pos)
 {
 	memset(&state_, 0, sizeof(ObjectStateStruct));
 
@@ -39,7 +41,7 @@ ObjectState::ObjectState(int id, std::string name, int model_id, int control, do
 	state_.wheel_rot = (float)wheel_rot;
 }
 
-ObjectState::ObjectState(int id, std::string name, int model_id, int control, double timestamp, double speed, double wheel_angle, double wheel_rot, double x, double y, double z, double h, double p, double r)
+ObjectState::ObjectState(int id, const std::string &name, int model_id, int control, double timestamp, double speed, double wheel_angle, double wheel_rot, double x, double y, double z, double h, double p, double r)
 {
 	memset(&state_, 0, sizeof(ObjectStateStruct));
 
@@ -56,7 +58,7 @@ ObjectState::ObjectState(int id, std::string name, int model_id, int control, do
 	state_.wheel_rot = (float)wheel_rot;
 }
 
-ObjectState::ObjectState(int id, std::string name, int model_id, int control, double timestamp, double speed, double wheel_angle, double wheel_rot, int roadId, int laneId, double laneOffset, double s)
+ObjectState::ObjectState(int id, const std::string &name, int model_id, int control, double timestamp, double speed, double wheel_angle, double wheel_rot, int roadId, int laneId, double laneOffset, double s)
 {
 	memset(&state_, 0, sizeof(ObjectStateStruct));
 
@@ -65,6 +67,7 @@ ObjectState::ObjectState(int id, std::string name, int model_id, int control, do
 	state_.control = control;
 	state_.timeStamp = (float)timestamp;
 	strncpy(state_.name, name.c_str(), NAME_LEN);
+	state_.pos.Init();
 	state_.pos.SetLanePos(roadId, laneId, s, laneOffset);
 	state_.speed = (float)speed;
 	state_.wheel_angle = (float)wheel_angle;
@@ -89,7 +92,7 @@ void ObjectState::Print()
 
 // ScenarioGateway
 
-ScenarioGateway::ScenarioGateway()
+ScenarioGateway::ScenarioGateway() : frame_n_objects_(0), frame_time_(0.0), shared_state_(0), shared_state_full_warned_(false), batch_report_(0)
 {
 	objectState_.clear();
 }
@@ -101,37 +104,35 @@ ScenarioGateway::~ScenarioGateway()
 		delete objectState_[i];
 	}
 	objectState_.clear();
+	objectStateById_.clear();
 
+	flushFrame();
 	data_file_.flush();
 	data_file_.close();
+
+	delete shared_state_;
 }
 
 ObjectState* ScenarioGateway::getObjectStatePtrById(int id)
 {
-	for (size_t i = 0; i < objectState_.size(); i++)
-	{
-		if (objectState_[i]->state_.id == id)
-		{
-			return objectState_[i];
-		}
-	}
+	std::unordered_map<int, ObjectState*>::iterator it = objectStateById_.find(id);
 
-	return 0;
+	return it != objectStateById_.end() ? it->second : 0;
 }
 
 int ScenarioGateway::getObjectStateById(int id, ObjectState &objectState)
 {
-	for (size_t i = 0; i < objectState_.size(); i++)
+	ObjectState *obj_state = getObjectStatePtrById(id);
+
+	if (obj_state == 0)
 	{
-		if (objectState_[i]->state_.id == id)
-		{
-			objectState = *objectState_[i];
-			return 0;
-		}
+		// Indicate not found by returning non zero
+		return -1;
 	}
 
-	// Indicate not found by returning non zero
-	return -1;
+	objectState = *obj_state;
+
+	return 0;
 }
 
 void ScenarioGateway::updateObjectInfo(ObjectState *obj_state, double timestamp, double speed, double wheel_angle, double wheel_rot)
@@ -149,11 +150,90 @@ void ScenarioGateway::updateObjectInfo(ObjectState *obj_state, double timestamp,
 	// Write status to file - for later replay
 	if (data_file_.is_open())
 	{
-		data_file_.write((char*)(&obj_state->state_), sizeof(obj_state->state_));
+		recordObjectState(obj_state);
+	}
+}
+
+void ScenarioGateway::addObjectState(ObjectState *obj_state)
+{
+	objectState_.push_back(obj_state);
+	objectStateById_[obj_state->state_.id] = obj_state;
+
+	if (data_file_.is_open())
+	{
+		recordObjectInfo(obj_state);
 	}
 }
 
-void ScenarioGateway::reportObject(int id, std::string name, int model_id, int control,
+void ScenarioGateway::recordObjectInfo(ObjectState *obj_state)
+{
+	ReplayPacketHeader packet = { REPLAY_PACKET_OBJECT, (int)sizeof(ReplayObjectInfo) };
+	ReplayObjectInfo info;
+
+	memset(&info, 0, sizeof(info));
+	info.id = obj_state->state_.id;
+	info.model_id = obj_state->state_.model_id;
+	info.control = obj_state->state_.control;
+	strncpy(info.name, obj_state->state_.name, NAME_LEN - 1);
+
+	data_file_.write((char*)&packet, sizeof(packet));
+	data_file_.write((char*)&info, sizeof(info));
+}
+
+void ScenarioGateway::recordObjectState(ObjectState *obj_state)
+{
+	ObjectStateStruct *state = &obj_state->state_;
+	ReplayObjectRecord record;
+
+	// A new timestamp marks the start of a new frame
+	if (frame_n_objects_ > 0 && state->timeStamp != frame_time_)
+	{
+		flushFrame();
+	}
+	frame_time_ = state->timeStamp;
+
+	record.x = state->pos.GetX();
+	record.y = state->pos.GetY();
+	record.z = state->pos.GetZ();
+	record.s = state->pos.GetS();
+	record.h = (float)state->pos.GetH();
+	record.p = (float)state->pos.GetP();
+	record.r = (float)state->pos.GetR();
+	record.offset = (float)state->pos.GetOffset();
+	record.speed = state->speed;
+	record.wheel_angle = state->wheel_angle;
+	record.wheel_rot = state->wheel_rot;
+	record.id = state->id;
+	record.road_id = state->pos.GetTrackId();
+	record.lane_id = state->pos.GetLaneId();
+
+	frame_buffer_.insert(frame_buffer_.end(), (char*)&record, (char*)&record + sizeof(record));
+	frame_n_objects_++;
+}
+
+void ScenarioGateway::flushFrame()
+{
+	if (frame_n_objects_ == 0 || !data_file_.is_open())
+	{
+		return;
+	}
+
+	ReplayFrameHeader frame;
+	frame.time = frame_time_;
+	frame.n_objects = frame_n_objects_;
+	frame.reserved = 0;
+
+	ReplayPacketHeader packet = { REPLAY_PACKET_FRAME, (int)(sizeof(frame) + frame_buffer_.size()) };
+
+	data_file_.write((char*)&packet, sizeof(packet));
+	data_file_.write((char*)&frame, sizeof(frame));
+	data_file_.write(frame_buffer_.data(), frame_buffer_.size());
+
+	frame_buffer_.clear();
+	frame_n_objects_ = 0;
+}
+
+void ScenarioGateway::reportObject(int id, const std::string &name, int model_id, int control,
 	double timestamp, double speed, double wheel_angle, double wheel_rot,
 	roadmanager::Position *pos)
 {
@@ -166,7 +246,7 @@ void ScenarioGateway::reportObject(int id, std::string name, int model_id, int c
 		obj_state = new ObjectState(id, name, model_id, control, timestamp, speed, wheel_angle, wheel_rot, pos);
 
 		// Add object to collection
-		objectState_.push_back(obj_state);
+		addObjectState(obj_state);
 	}
 	else
 	{
@@ -176,7 +256,7 @@ void ScenarioGateway::reportObject(int id, std::string name, int model_id, int c
 	}
 }
 
-void ScenarioGateway::reportObject(int id, std::string name, int model_id, int control, 
+void ScenarioGateway::reportObject(int id, const std::string &name, int model_id, int control, 
 	double timestamp, double speed, double wheel_angle, double wheel_rot,
 	double x, double y, double z, double h, double p, double r)
 {
@@ -189,7 +269,7 @@ void ScenarioGateway::reportObject(int id, std::string name, int model_id, int c
 		obj_state = new ObjectState(id, name, model_id, control, timestamp, speed, wheel_angle, wheel_rot, x, y, z, h, p, r);
 
 		// Add object to collection
-		objectState_.push_back(obj_state);
+		addObjectState(obj_state);
 	}
 	else
 	{
@@ -199,7 +279,7 @@ void ScenarioGateway::reportObject(int id, std::string name, int model_id, int c
 	}
 }
 
-void ScenarioGateway::reportObject(int id, std::string name, int model_id, int control, 
+void ScenarioGateway::reportObject(int id, const std::string &name, int model_id, int control, 
 	double timestamp, double speed, double wheel_angle, double wheel_rot,
 	int roadId, int laneId, double laneOffset, double s)
 {
@@ -212,7 +292,7 @@ void ScenarioGateway::reportObject(int id, std::string name, int model_id, int c
 		obj_state = new ObjectState(id, name, model_id, control, timestamp, speed, wheel_angle, wheel_rot, roadId, laneId, laneOffset, s);
 
 		// Add object to collection
-		objectState_.push_back(obj_state);
+		addObjectState(obj_state);
 	}
 	else
 	{
@@ -222,6 +302,130 @@ void ScenarioGateway::reportObject(int id, std::string name, int model_id, int c
 	}
 }
 
+void ScenarioGateway::resolveReport(int index, void *args)
+{
+	ScenarioGateway *gateway = (ScenarioGateway*)args;
+	ObjectState *obj_state = gateway->batch_state_[index];
+	ObjectReport *report = &gateway->batch_report_[index];
+
+	if (obj_state == 0)
+	{
+		return;
+	}
+
+	if (report->road_pos)
+	{
+		obj_state->state_.pos.SetLanePos(report->roadId, report->laneId, report->s, report->laneOffset);
+	}
+	else
+	{
+		obj_state->state_.pos.SetInertiaPos(report->x, report->y, report->z, report->h, report->p, report->r);
+	}
+	obj_state->state_.speed = (float)report->speed;
+	obj_state->state_.timeStamp = (float)report->timestamp;
+	obj_state->state_.wheel_angle = (float)report->wheel_angle;
+	obj_state->state_.wheel_rot = (float)report->wheel_rot;
+}
+
+int ScenarioGateway::reportObjects(ObjectReport *report, int n_objects, int *status)
+{
+	int n_reported = 0;
+
+	batch_report_ = report;
+	batch_state_.resize(n_objects);
+
+	// Only the last report of an object counts, since each object state may be resolved by one thread only
+	batch_last_report_.clear();
+	for (int i = 0; i < n_objects; i++)
+	{
+		batch_last_report_[report[i].id] = i;
+	}
+
+	// Look up all objects and register any new ones, in order of the reports
+	for (int i = 0; i < n_objects; i++)
+	{
+		ObjectReport *r = &report[i];
+
+		batch_state_[i] = 0;
+
+		if (batch_last_report_[r->id] != i)
+		{
+			LOG("Object %d reported more than once, skipping all but last report", r->id);
+			if (status)
+			{
+				status[i] = -1;
+			}
+			continue;
+		}
+
+		ObjectState *obj_state = getObjectStatePtrById(r->id);
+		roadmanager::OpenDrive *odr = obj_state ? obj_state->state_.pos.GetOpenDrive() : roadmanager::Position::GetDefaultOpenDrive();
+
+		if (r->road_pos && odr->GetRoadById(r->roadId) == 0)
+		{
+			LOG("Object %d reported on unknown road %d, skipping", r->id, r->roadId);
+			if (status)
+			{
+				status[i] = -1;
+			}
+			continue;
+		}
+
+		if (obj_state == 0)
+		{
+			const std::string &name = r->name ? *r->name : "";
+
+			LOG("Creating new object \"%s\" (id %d, timestamp %.2f)", name.c_str(), r->id, r->timestamp);
+			if (r->road_pos)
+			{
+				obj_state = new ObjectState(r->id, name, r->model_id, r->control, r->timestamp, r->speed, r->wheel_angle, r->wheel_rot,
+					r->roadId, r->laneId, r->laneOffset, r->s);
+			}
+			else
+			{
+				obj_state = new ObjectState(r->id, name, r->model_id, r->control, r->timestamp, r->speed, r->wheel_angle, r->wheel_rot,
+					r->x, r->y, r->z, r->h, r->p, r->r);
+			}
+			addObjectState(obj_state);
+		}
+		else
+		{
+			batch_state_[i] = obj_state;
+		}
+
+		if (status)
+		{
+			status[i] = 0;
+		}
+		n_reported++;
+	}
+
+	// Resolve road positions, the costly part. Each report updates its own object state.
+	report_pool_.Run(resolveReport, n_objects, this);
+
+	// Write status to file - for later replay
+	if (data_file_.is_open())
+	{
+		for (int i = 0; i < n_objects; i++)
+		{
+			if (batch_state_[i])
+			{
+				recordObjectState(batch_state_[i]);
+			}
+		}
+	}
+
+	batch_report_ = 0;
+
+	return n_reported;
+}
+
+void ScenarioGateway::SetReportThreads(int n_threads)
+{
+	report_pool_.Start(MAX(0, n_threads - 1));
+	LOG("Resolve reported positions using %d thread%s", report_pool_.GetNumberOfWorkers() + 1, report_pool_.GetNumberOfWorkers() > 0 ? "s" : "");
+}
+
 int ScenarioGateway::RecordToFile(std::string filename, std::string odr_filename, std::string  model_filename)
 {
 	if (!filename.empty())
@@ -232,12 +436,89 @@ int ScenarioGateway::RecordToFile(std::string filename, std::string odr_filename
 			LOG("Cannot open file: %s", filename.c_str());
 			return -1;
 		}
-		ReplayHeader header;
-		strncpy(header.odr_filename, FileNameOf(odr_filename).c_str(), REPLAY_FILENAME_SIZE);
-		strncpy(header.model_filename, FileNameOf(model_filename).c_str(), REPLAY_FILENAME_SIZE);
+		ReplayFileHeader file_header;
+		memset(&file_header, 0, sizeof(file_header));
+		strncpy(file_header.magic, REPLAY_MAGIC, sizeof(file_header.magic));
+		file_header.version = REPLAY_VERSION;
+		strncpy(file_header.header.odr_filename, FileNameOf(odr_filename).c_str(), REPLAY_FILENAME_SIZE - 1);
+		strncpy(file_header.header.model_filename, FileNameOf(model_filename).c_str(), REPLAY_FILENAME_SIZE - 1);
+
+		data_file_.write((char*)&file_header, sizeof(file_header));
+
+		// Register any objects already existing
+		for (size_t i = 0; i < objectState_.size(); i++)
+		{
+			recordObjectInfo(objectState_[i]);
+		}
+	}
+
+	return 0;
+}
+
+int ScenarioGateway::PublishToSharedMemory(std::string name, int max_objects)
+{
+	if (shared_state_ == 0)
+	{
+		shared_state_ = new SharedStateWriter;
+	}
 
-		data_file_.write((char*)&header, sizeof(header));
+	if (shared_state_->Create(name, max_objects > 0 ? max_objects : SHARED_STATE_MAX_OBJECTS) != 0)
+	{
+		LOG("Failed to create shared memory %s", name.c_str());
+		delete shared_state_;
+		shared_state_ = 0;
+		return -1;
 	}
 
+	LOG("Publishing states of up to %d objects into shared memory %s", shared_state_->GetMaxObjects(), name.c_str());
+	shared_state_full_warned_ = false;
+
 	return 0;
 }
+
+void ScenarioGateway::PublishFrame(double time)
+{
+	if (shared_state_ == 0)
+	{
+		return;
+	}
+
+	SharedObjectState *objects = shared_state_->BeginFrame();
+	int n_objects = MIN((int)objectState_.size(), shared_state_->GetMaxObjects());
+
+	if (n_objects < (int)objectState_.size())
+	{
+		if (!shared_state_full_warned_)
+		{
+			LOG("Shared memory capacity %d objects exceeded, skipping the rest", shared_state_->GetMaxObjects());
+			shared_state_full_warned_ = true;
+		}
+	}
+
+	for (int i = 0; i < n_objects; i++)
+	{
+		ObjectStateStruct *state = &objectState_[i]->state_;
+		SharedObjectState *obj = &objects[i];
+
+		obj->id = state->id;
+		obj->model_id = state->model_id;
+		obj->control = state->control;
+		strncpy(obj->name, state->name, SHARED_STATE_NAME_SIZE - 1);
+		obj->name[SHARED_STATE_NAME_SIZE - 1] = 0;
+		obj->x = state->pos.GetX();
+		obj->y = state->pos.GetY();
+		obj->z = state->pos.GetZ();
+		obj->h = (float)state->pos.GetH();
+		obj->p = (float)state->pos.GetP();
+		obj->r = (float)state->pos.GetR();
+		obj->road_id = state->pos.GetTrackId();
+		obj->lane_id = state->pos.GetLaneId();
+		obj->lane_offset = (float)state->pos.GetOffset();
+		obj->s = state->pos.GetS();
+		obj->speed = state->speed;
+		obj->wheel_angle = state->wheel_angle;
+		obj->wheel_rot = state->wheel_rot;
+	}
+
+	shared_state_->EndFrame(time, n_objects);
+}
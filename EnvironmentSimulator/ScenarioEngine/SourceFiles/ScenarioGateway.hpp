@@ -12,13 +12,17 @@
 
 #pragma once
 #include "RoadManager.hpp"
+#include "CommonMini.hpp"
 
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <math.h>
 
+class SharedStateWriter;
+
 namespace scenarioengine
 {
 
@@ -41,9 +45,9 @@ namespace scenarioengine
 	{
 	public:
 		ObjectState();
-		ObjectState(int id, std::string name, int model_id, int control, double timestamp, double speed, double wheel_angle, double wheel_rot, roadmanager::Position *pos);
-		ObjectState(int id, std::string name, int model_id, int control, double timestamp, double speed, double wheel_angle, double wheel_rot, double x, double y, double z, double h, double p, double r);
-		ObjectState(int id, std::string name, int model_id, int control, double timestamp, double speed, double wheel_angle, double wheel_rot, int roadId, int laneId, double laneOffset, double s);
+		ObjectState(int id, const std::string &name, int model_id, int control, double timestamp, double speed, double wheel_angle, double wheel_rot, roadmanager::Position *pos);
+		ObjectState(int id, const std::string &name, int model_id, int control, double timestamp, double speed, double wheel_angle, double wheel_rot, double x, double y, double z, double h, double p, double r);
+		ObjectState(int id, const std::string &name, int model_id, int control, double timestamp, double speed, double wheel_angle, double wheel_rot, int roadId, int laneId, double laneOffset, double s);
 
 		ObjectStateStruct getStruct() { return state_; }
 
@@ -57,6 +61,30 @@ namespace scenarioengine
 	};
 
 
+	// Object state input to ScenarioGateway::reportObjects
+	typedef struct
+	{
+		int id;
+		const std::string *name;  // only used when the object is reported the first time
+		int model_id;
+		int control;
+		double timestamp;
+		double speed;
+		double wheel_angle;
+		double wheel_rot;
+		bool road_pos;  // true: position given by roadId, laneId, laneOffset and s, false: by x, y, z, h, p, r
+		double x;
+		double y;
+		double z;
+		double h;
+		double p;
+		double r;
+		int roadId;
+		int laneId;
+		double laneOffset;
+		double s;
+	} ObjectReport;
+
 	class ScenarioGateway
 	{
 	public:
@@ -64,18 +92,36 @@ namespace scenarioengine
 		ScenarioGateway();
 		~ScenarioGateway();
 
-		void reportObject(int id, std::string name, int model_id, int control,
+		void reportObject(int id, const std::string &name, int model_id, int control,
 			double timestamp, double speed, double wheel_angle, double wheel_rot,
 			roadmanager::Position *pos);
 
-		void reportObject(int id, std::string name, int model_id, int control,
+		void reportObject(int id, const std::string &name, int model_id, int control,
 			double timestamp, double speed, double wheel_angle, double wheel_rot,
 			double x, double y, double z, double h, double p, double r);
 
-		void reportObject(int id, std::string name, int model_id, int control,
+		void reportObject(int id, const std::string &name, int model_id, int control,
 			double timestamp, double speed, double wheel_angle, double wheel_rot,
 			int roadId, int laneId, double laneOffset, double s);
 
+		/**
+		Report states of multiple objects in one call. Objects are looked up and registered first, then all
+		road positions are resolved - in parallel if threads have been set - and finally the states are 
+		recorded in the given order. If an object is reported more than once, only its last report is used.
+		@param report Array of object states
+		@param n_objects Number of elements in report
+		@param status Optional array receiving per object result: 0 if successful, -1 if not (e.g. unknown road
+		or superseded by a later report of the same object)
+		@return Number of successfully reported objects
+		*/
+		int reportObjects(ObjectReport *report, int n_objects, int *status = 0);
+
+		/**
+		Set number of threads resolving road positions in reportObjects
+		@param n_threads Number of threads, including the calling one. 1 for sequential resolve.
+		*/
+		void SetReportThreads(int n_threads);
+
 		int getNumberOfObjects() { return (int)objectState_.size(); }
 		ObjectState getObjectStateByIdx(int idx) { return *objectState_[idx]; }
 		ObjectState *getObjectStatePtrByIdx(int idx) { return objectState_[idx]; }
@@ -83,11 +129,40 @@ namespace scenarioengine
 		int getObjectStateById(int idx, ObjectState &objState);
 		int RecordToFile(std::string filename, std::string odr_filename, std::string model_filename);
 
+		/**
+		Publish object states into shared memory for local consumers, see SharedState.hpp
+		@param name Name of the shared memory area
+		@param max_objects Capacity, number of objects per frame. 0 for default.
+		@return 0 if successful, -1 if not
+		*/
+		int PublishToSharedMemory(std::string name, int max_objects = 0);
+
+		/**
+		Publish current states of all objects as one frame, if publishing to shared memory
+		@param time Simulation time of the frame
+		*/
+		void PublishFrame(double time);
+
 	private:
 		void updateObjectInfo(ObjectState* obj_state, double timestamp, double speed, double wheel_angle, double wheel_rot);
+		void addObjectState(ObjectState* obj_state);
+		void recordObjectInfo(ObjectState* obj_state);
+		void recordObjectState(ObjectState* obj_state);
+		void flushFrame();
+		static void resolveReport(int index, void *args);
 
 		std::vector<ObjectState*> objectState_;
+		std::unordered_map<int, ObjectState*> objectStateById_;  // lookup of reported objects by id
 		std::ofstream data_file_;
+		std::vector<char> frame_buffer_;  // object records of current frame, pending write
+		int frame_n_objects_;
+		double frame_time_;
+		SharedStateWriter *shared_state_;
+		bool shared_state_full_warned_;  // capacity exceeded logged, once per shared memory
+		SE_TaskPool report_pool_;
+		ObjectReport *batch_report_;  // reports of ongoing reportObjects call
+		std::unordered_map<int, int> batch_last_report_;  // index of last report per object id, ongoing reportObjects call
+		std::vector<ObjectState*> batch_state_;  // state per report, 0 if not to be updated
 	};
 
 }
\ No newline at end of file
@@ -38,6 +38,25 @@ void ScenarioReader::parseGlobalParameterDeclarations()
 	paramDeclarationsSize_ = (int)parameterDeclarations_.Parameter.size();
 }
 
+int ScenarioReader::SetParameterValue(std::string name, std::string value)
+{
+	pugi::xml_node paramDecl = doc_.child("OpenSCENARIO").child("ParameterDeclarations");
+
+	for (pugi::xml_node param = paramDecl.first_child(); param; param = param.next_sibling())
+	{
+		if (name == param.attribute("name").value())
+		{
+			LOG("Setting parameter %s = %s", name.c_str(), value.c_str());
+			param.attribute("value").set_value(value.c_str());
+			return 0;
+		}
+	}
+
+	LOG("Parameter %s not declared", name.c_str());
+
+	return -1;
+}
+
 void ScenarioReader::RestoreParameterDeclarations()
 {
 	parameterDeclarations_.Parameter.erase(
@@ -501,11 +520,51 @@ roadmanager::Trajectory* ScenarioReader::parseTrajectory(pugi::xml_node node)
 			}
 			else if (shapeType == "Clothoid")
 			{
-				LOG("Trajectory type Clothoid not supported yet");
+				LOG("Parsing Clothoid");
+				pugi::xml_node posNode = shapeNode.child("Position");
+				if (!posNode)
+				{
+					throw std::runtime_error("Missing Trajectory/Clothoid/Position node");
+				}
+				OSCPosition* pos = parseOSCPosition(posNode);
+				double length = strtod(ReadAttribute(shapeNode, "length"));
+				if (length < SMALL_NUMBER)
+				{
+					throw std::runtime_error("Trajectory/Clothoid length must be positive");
+				}
+				shape = new roadmanager::Clothoid(*pos->GetRMPos(),
+					strtod(ReadAttribute(shapeNode, "curvature")),
+					// curvatureDot renamed curvaturePrime in OpenSCENARIO 1.1
+					strtod(ReadAttribute(shapeNode, shapeNode.attribute("curvaturePrime") ? "curvaturePrime" : "curvatureDot")),
+					length,
+					strtod(ReadAttribute(shapeNode, "startTime")),
+					strtod(ReadAttribute(shapeNode, "stopTime")));
 			}
 			else if (shapeType == "Nurbs")
 			{
-				LOG("Trajectory type Nurbs not supported yet");
+				LOG("Parsing Nurbs");
+				roadmanager::Nurbs* nurbs = new roadmanager::Nurbs(strtoi(ReadAttribute(shapeNode, "order")));
+				for (pugi::xml_node cpNode = shapeNode.child("ControlPoint"); cpNode; cpNode = cpNode.next_sibling("ControlPoint"))
+				{
+					pugi::xml_node posNode = cpNode.child("Position");
+					if (!posNode)
+					{
+						throw std::runtime_error("Missing Trajectory/Nurbs/ControlPoint/Position node");
+					}
+					OSCPosition* pos = parseOSCPosition(posNode);
+					double weight = cpNode.attribute("weight") ? strtod(ReadAttribute(cpNode, "weight")) : 1.0;
+					nurbs->AddControlPoint(*pos->GetRMPos(), strtod(ReadAttribute(cpNode, "time")), weight);
+				}
+				for (pugi::xml_node knotNode = shapeNode.child("Knot"); knotNode; knotNode = knotNode.next_sibling("Knot"))
+				{
+					nurbs->AddKnot(strtod(ReadAttribute(knotNode, "value")));
+				}
+				if (nurbs->order_ < 1 || (int)nurbs->ctrlPoint_.size() < nurbs->order_ ||
+					nurbs->knot_.size() != nurbs->ctrlPoint_.size() + nurbs->order_)
+				{
+					throw std::runtime_error("Trajectory/Nurbs expects order > 0, at least order control points and control points + order knots");
+				}
+				shape = nurbs;
 			}
 			else
 			{
@@ -2183,6 +2242,9 @@ int ScenarioReader::parseStoryBoard(StoryBoard &storyBoard)
 		}
 	}
 
+	// All elements known, resolve references by name once instead of at each evaluation
+	storyBoard.ResolveReferences();
+
 	return 0;
 }
 
@@ -46,6 +46,15 @@ namespace scenarioengine
 		// ParameterDeclarations
 		void parseGlobalParameterDeclarations();
 
+		/**
+		Override the default value of a global parameter. Must be called after loading
+		the scenario but before parsing it.
+		@param name Name of the parameter, as declared in the global ParameterDeclarations
+		@param value New value, replacing the one specified in the scenario file
+		@return 0 if OK, -1 if the parameter was not found
+		*/
+		int SetParameterValue(std::string name, std::string value);
+
 		// Catalogs
 		void parseCatalogs();
 		Catalog* LoadCatalog(std::string name);
@@ -24,25 +24,46 @@
 #else
 	 /* Assume that any non-Windows platform uses POSIX-style sockets instead. */
 	#include <sys/socket.h>
+	#include <sys/select.h>
 	#include <arpa/inet.h>
 	#include <netdb.h>  /* Needed for getaddrinfo() and freeaddrinfo() */
 	#include <unistd.h> /* Needed for close() */
+	#include <fcntl.h>
 #endif
 
+#include <map>
+#include <set>
+
 
 using namespace scenarioengine;
 
 #define DEFAULT_INPORT 48199 
 #define ES_SERV_TIMEOUT 500
+#define ES_SERV_MAX_DATAGRAM 1472  // max UDP payload without fragmentation on ethernet
+#define ES_SERV_BATCH_SIZE 64      // datagrams per receive call
+#define ES_SERV_RCVBUF (1 << 20)   // socket buffer, absorbing bursts between wake-ups
 
 // #define SWAP_BYTE_ORDER_ESMINI  // Set when Ego state is sent from non Intel platforms, such as dSPACE
 
 enum { SERV_NOT_STARTED, SERV_RUNNING, SERV_STOP, SERV_STOPPED };
 
+typedef struct
+{
+	ObjectStateBuffer_t buf;  // latest received state
+	double wheel_rot;         // integrated from displacement between received states
+	std::string name;
+	bool updated;             // received since last reported to the gateway
+} ServerObjectState;
+
 static int state = SERV_NOT_STARTED;
 static SE_Thread thread;
-static SE_Mutex mutex;
+static SE_Mutex mutex;  // guards object_state and state changes
+static ScenarioEngine *scenarioEngine = 0;
 static ScenarioGateway *scenarioGateway = 0;
+static double log_interval = DEFAULT_SERVER_LOG_INTERVAL;
+static std::map<int, ServerObjectState> object_state;  // by object id
+static std::set<int> unknown_id;  // received ids not in the scenario, logged once each
+static std::vector<ObjectReport> server_report;  // reused between steps
 
 namespace scenarioengine
 {
@@ -62,16 +83,108 @@ namespace scenarioengine
 #endif
 	}
 
+	static bool WaitForData(int sock, int timeout_ms)
+	{
+		fd_set fds;
+		struct timeval tv;
+
+		FD_ZERO(&fds);
+		FD_SET(sock, &fds);
+		tv.tv_sec = timeout_ms / 1000;
+		tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+		return select(sock + 1, &fds, NULL, NULL, &tv) > 0;
+	}
+
+	// Receive pending datagrams, without blocking. Returns number of datagrams, sizes in len.
+	static int ReceiveBatch(int sock, char *buf, int *len)
+	{
+#ifdef __linux__
+		struct mmsghdr msgs[ES_SERV_BATCH_SIZE];
+		struct iovec iovecs[ES_SERV_BATCH_SIZE];
+
+		for (int i = 0; i < ES_SERV_BATCH_SIZE; i++)
+		{
+			iovecs[i].iov_base = buf + i * ES_SERV_MAX_DATAGRAM;
+			iovecs[i].iov_len = ES_SERV_MAX_DATAGRAM;
+			memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int n = recvmmsg(sock, msgs, ES_SERV_BATCH_SIZE, MSG_DONTWAIT, NULL);
+		for (int i = 0; i < n; i++)
+		{
+			len[i] = (int)msgs[i].msg_len;
+		}
+
+		return MAX(n, 0);
+#else
+		int n = 0;
+
+		// Socket is non blocking, read until empty
+		while (n < ES_SERV_BATCH_SIZE)
+		{
+			int ret = recvfrom(sock, buf + n * ES_SERV_MAX_DATAGRAM, ES_SERV_MAX_DATAGRAM, 0, NULL, NULL);
+			if (ret < 0)
+			{
+				break;
+			}
+			len[n++] = ret;
+		}
+
+		return n;
+#endif
+	}
+
+	// Keep the state, replacing any previous one of the same object. Call with mutex locked.
+	// Returns 0 if successful, -1 if the object is not part of the scenario
+	static int UpdateObjectState(ObjectStateBuffer_t *buf)
+	{
+		std::map<int, ServerObjectState>::iterator it = object_state.find(buf->id);
+
+		if (it == object_state.end())
+		{
+			if (buf->id < 0 || buf->id >= (int)scenarioEngine->entities.object_.size())
+			{
+				if (unknown_id.insert(buf->id).second)
+				{
+					LOG("Server: Object %d not in scenario, skipping its states", buf->id);
+				}
+				return -1;
+			}
+
+			ServerObjectState obj;
+
+			obj.buf = *buf;
+			obj.wheel_rot = 0.0;
+			obj.name = scenarioEngine->entities.object_[buf->id]->name_;
+			obj.updated = true;
+			object_state[buf->id] = obj;
+
+			return 0;
+		}
+
+		ServerObjectState *obj = &it->second;
+
+		// Find out wheel rotation from x, y displacement
+		double ds = GetLengthOfLine2D(buf->x, buf->y, obj->buf.x, obj->buf.y);
+		obj->wheel_rot += SIGN(buf->speed) * fmod(ds / 0.35, 2 * M_PI); // wheel radius = 0.35 m
+		obj->buf = *buf;
+		obj->updated = true;
+
+		return 0;
+	}
+
 	void ServerThread(void *args)
 	{
+		(void)args;
+
 		static int sock;
 		struct sockaddr_in server_addr;
-		struct sockaddr_in sender_addr;
 		static int iPortIn = DEFAULT_INPORT;   // Port for incoming packages
-		EgoStateBuffer_t buf;
-		socklen_t sender_addr_size = sizeof(sender_addr);
-
-		state = SERV_NOT_STARTED;
+		std::vector<char> buf(ES_SERV_BATCH_SIZE * ES_SERV_MAX_DATAGRAM);
+		int len[ES_SERV_BATCH_SIZE];
 
 #ifdef _WIN32
 		WSADATA wsa_data;
@@ -90,9 +203,16 @@ namespace scenarioengine
 			return;
 		}
 
-		//set timer for recv_socket
-		static int timeout = ES_SERV_TIMEOUT;
-		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(timeout));
+		int rcvbuf = ES_SERV_RCVBUF;
+		setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char*)&rcvbuf, sizeof(rcvbuf));
+
+		// Wait for data by select, then drain the socket without blocking
+#ifdef _WIN32
+		u_long non_blocking = 1;
+		ioctlsocket(sock, FIONBIO, &non_blocking);
+#else
+		fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
 
 		server_addr.sin_family = AF_INET;
 		server_addr.sin_port = htons(iPortIn);
@@ -104,40 +224,98 @@ namespace scenarioengine
 			CloseGracefully(sock);
 			return;
 		}
-		state = SERV_RUNNING;
-		
-		double x_old = 0.0;
-		double y_old = 0.0;
-		double wheel_rot = 0.0;
 
+		// Unless already asked to stop
+		mutex.Lock();
+		if (state == SERV_NOT_STARTED)
+		{
+			state = SERV_RUNNING;
+		}
+		mutex.Unlock();
+
+		int n_datagrams = 0;
+		int n_states = 0;
+		int n_invalid = 0;
+		int n_unknown = 0;  // states of objects not in the scenario
+		__int64 log_time = SE_getSystemTime();
 
 		while (state == SERV_RUNNING)
 		{
-			int ret = recvfrom(sock, (char*)&buf, sizeof(EgoStateBuffer_t), 0, (struct sockaddr *)&sender_addr, &sender_addr_size);
-			
+			if (WaitForData(sock, ES_SERV_TIMEOUT))
+			{
+				int n;
+
+				while ((n = ReceiveBatch(sock, buf.data(), len)) > 0)
+				{
+					mutex.Lock();
+
+					for (int i = 0; i < n; i++)
+					{
+						char *data = buf.data() + i * ES_SERV_MAX_DATAGRAM;
+
 #ifdef SWAP_BYTE_ORDER_ESMINI
-			SwapByteOrder((unsigned char*)&buf, 4, sizeof(buf));
+						SwapByteOrder((unsigned char*)data, 4, len[i]);
 #endif
+						if (len[i] == sizeof(EgoStateBuffer_t))
+						{
+							ObjectStateBuffer_t obj_buf;
+							obj_buf.id = 0;
+							memcpy(&obj_buf.x, data, sizeof(EgoStateBuffer_t));
+							if (UpdateObjectState(&obj_buf) == 0)
+							{
+								n_states++;
+							}
+							else
+							{
+								n_unknown++;
+							}
+						}
+						else if (len[i] > 0 && len[i] % sizeof(ObjectStateBuffer_t) == 0)
+						{
+							for (int j = 0; j < len[i] / (int)sizeof(ObjectStateBuffer_t); j++)
+							{
+								if (UpdateObjectState((ObjectStateBuffer_t*)data + j) == 0)
+								{
+									n_states++;
+								}
+								else
+								{
+									n_unknown++;
+								}
+							}
+						}
+						else
+						{
+							n_invalid++;
+						}
+					}
+					n_datagrams += n;
 
-			// Find out wheel rotation from x, y displacement
-			double ds = GetLengthOfLine2D(buf.x, buf.y, x_old, y_old);
-			wheel_rot += SIGN(buf.speed) * fmod(ds / 0.35, 2 * M_PI); // wheel radius = 0.35 m
-			x_old = buf.x;
-			y_old = buf.y;
+					mutex.Unlock();
+				}
+			}
 
-			if (ret >= 0)
+			// Summarize instead of logging every datagram, which would stall the server at high rates
+			__int64 now = SE_getSystemTime();
+			if (log_interval > 0 && now - log_time >= 1000 * log_interval)
 			{
-				printf("Server: Received Ego pos (%.2f, %.2f, %.2f) rot: (%.2f, %.2f, %.2f) speed: %.2f (%.2f km/h) wheel_angle: %.2f (%.2f deg)\n",
-					buf.x, buf.y, buf.z, buf.h, buf.p, buf.r, buf.speed, 3.6 * buf.speed, buf.wheel_angle, 180 * buf.wheel_angle / M_PI);
-
-				// Update Ego state
-				mutex.Lock();
-
-				scenarioGateway->reportObject(0, "Ego", 0, 1, 0, buf.speed, buf.wheel_angle, wheel_rot, buf.x, buf.y, buf.z, buf.h, buf.p, buf.r);
+				if (n_datagrams > 0)
+				{
+					LOG("Server: Received %d datagrams (%d invalid), %d object states in %.2f s, skipped %d states of unknown objects",
+						n_datagrams, n_invalid, n_states, 0.001 * (now - log_time), n_unknown);
 
-				mutex.Unlock();
+					mutex.Lock();
+					for (std::map<int, ServerObjectState>::iterator it = object_state.begin(); it != object_state.end(); it++)
+					{
+						ObjectStateBuffer_t *b = &it->second.buf;
+						LOG("Server: Object %d pos (%.2f, %.2f, %.2f) rot: (%.2f, %.2f, %.2f) speed: %.2f (%.2f km/h) wheel_angle: %.2f (%.2f deg)",
+							b->id, b->x, b->y, b->z, b->h, b->p, b->r, b->speed, 3.6 * b->speed, b->wheel_angle, 180 * b->wheel_angle / M_PI);
+					}
+					mutex.Unlock();
+				}
+				n_datagrams = n_states = n_invalid = n_unknown = 0;
+				log_time = now;
 			}
-
 		}
 
 		CloseGracefully(sock);
@@ -145,27 +323,78 @@ namespace scenarioengine
 		state = SERV_STOPPED;
 	}
 
-	void StartServer(ScenarioEngine *scenarioEngine)
+	void StartServer(ScenarioEngine *engine, double interval)
 	{
 		// Fetch ScenarioGateway 
+		scenarioEngine = engine;
 		scenarioGateway = scenarioEngine->getScenarioGateway();
+		log_interval = interval;
+		object_state.clear();
+		unknown_id.clear();
+		state = SERV_NOT_STARTED;
 
 		thread.Start(ServerThread, NULL);
 	}
 
 	void StopServer()
 	{
-		// Flag time to stop
-		if (state == SERV_RUNNING)
+		// Flag time to stop, also if the thread did not yet get to start running
+		mutex.Lock();
+		state = SERV_STOP;
+		mutex.Unlock();
+		
+		// Wait/block until UDP server closed gracefully
+		thread.Wait();
+	}
+
+	int ReportServerStates()
+	{
+		if (scenarioGateway == 0)
 		{
-			state = SERV_STOP;
+			return 0;
 		}
-		else
+
+		server_report.clear();
+
+		mutex.Lock();
+
+		for (std::map<int, ServerObjectState>::iterator it = object_state.begin(); it != object_state.end(); it++)
 		{
-			state = SERV_STOPPED;
+			ServerObjectState *obj = &it->second;
+			ObjectReport r;
+
+			if (!obj->updated)
+			{
+				continue;
+			}
+
+			r.id = obj->buf.id;
+			r.name = &obj->name;  // not modified once added, and map elements stay in place
+			r.model_id = 0;
+			r.control = 1;
+			r.timestamp = scenarioEngine->getSimulationTime();
+			r.speed = obj->buf.speed;
+			r.wheel_angle = obj->buf.wheel_angle;
+			r.wheel_rot = obj->wheel_rot;
+			r.road_pos = false;
+			r.x = obj->buf.x;
+			r.y = obj->buf.y;
+			r.z = obj->buf.z;
+			r.h = obj->buf.h;
+			r.p = obj->buf.p;
+			r.r = obj->buf.r;
+			r.roadId = 0;
+			r.laneId = 0;
+			r.laneOffset = 0.0;
+			r.s = 0.0;
+
+			server_report.push_back(r);
+			obj->updated = false;
 		}
-		
-		// Wait/block until UDP server closed gracefully
-		thread.Wait();
+
+		mutex.Unlock();
+
+		// Resolve road positions outside the lock, not to hold up the receiving thread
+		return scenarioGateway->reportObjects(server_report.data(), (int)server_report.size());
 	}
 }
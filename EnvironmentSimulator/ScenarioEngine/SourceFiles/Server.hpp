@@ -23,6 +23,9 @@
 #define DEFAULT_INPORT 48199 
 
 
+#define DEFAULT_SERVER_LOG_INTERVAL 1.0  // s
+
+// Datagram of exactly this size is the state of the Ego (object id 0)
 typedef struct
 {
 	float x;		// m
@@ -35,9 +38,36 @@ typedef struct
 	float wheel_angle; // rad
 } EgoStateBuffer_t;
 
+// Datagram of any other size holds one or more of these, e.g. states of all external objects
+typedef struct
+{
+	int id;         // object id
+	float x;		// m
+	float y;		// m
+	float z;		// m
+	float h;		// rad
+	float p;		// rad
+	float r;		// rad
+	float speed;	// m/s
+	float wheel_angle; // rad
+} ObjectStateBuffer_t;
+
 
 namespace scenarioengine
 {
-	void StartServer(ScenarioEngine *scenarioEngine);
+	/**
+	Launch UDP server receiving states of externally controlled objects. Received states are buffered, 
+	keeping the latest one per object, until handed to the gateway by ReportServerStates. States of 
+	object ids not present in the scenario are dropped.
+	@param scenarioEngine Engine of which the gateway will receive the states
+	@param log_interval Time between log summaries of received data, in seconds. 0 to disable.
+	*/
+	void StartServer(ScenarioEngine *scenarioEngine, double log_interval = DEFAULT_SERVER_LOG_INTERVAL);
 	void StopServer();
+
+	/**
+	Report the latest state of each object received since last call to the gateway. Call once per step, before stepping the engine.
+	@return Number of reported objects
+	*/
+	int ReportServerStates();
 }
@@ -90,6 +90,12 @@ void Story::Print()
 
 Act* StoryBoard::FindActByName(std::string name)
 {
+	if (indexed_)
+	{
+		std::unordered_map<std::string, Act*>::iterator it = act_by_name_.find(name);
+		return it != act_by_name_.end() ? it->second : 0;
+	}
+
 	Act *act = 0;
 	for (size_t i = 0; i < story_.size(); i++)
 	{
@@ -104,6 +110,12 @@ Act* StoryBoard::FindActByName(std::string name)
 
 Event* StoryBoard::FindEventByName(std::string name)
 {
+	if (indexed_)
+	{
+		std::unordered_map<std::string, Event*>::iterator it = event_by_name_.find(name);
+		return it != event_by_name_.end() ? it->second : 0;
+	}
+
 	Event *event = 0;
 	for (size_t i = 0; i < story_.size(); i++)
 	{
@@ -118,6 +130,12 @@ Event* StoryBoard::FindEventByName(std::string name)
 
 OSCAction* StoryBoard::FindActionByName(std::string name)
 {
+	if (indexed_)
+	{
+		std::unordered_map<std::string, OSCAction*>::iterator it = action_by_name_.find(name);
+		return it != action_by_name_.end() ? it->second : 0;
+	}
+
 	OSCAction *action = 0;
 	for (size_t i = 0; i < story_.size(); i++)
 	{
@@ -130,6 +148,105 @@ OSCAction* StoryBoard::FindActionByName(std::string name)
 	return 0;
 }
 
+void StoryBoard::BuildIndex()
+{
+	act_by_name_.clear();
+	event_by_name_.clear();
+	action_by_name_.clear();
+
+	// emplace keeps the first element of any name, same as the sequential search
+	for (size_t i = 0; i < story_.size(); i++)
+	{
+		for (size_t j = 0; j < story_[i]->act_.size(); j++)
+		{
+			Act *act = story_[i]->act_[j];
+			act_by_name_.emplace(act->name_, act);
+
+			for (size_t k = 0; k < act->maneuverGroup_.size(); k++)
+			{
+				for (size_t l = 0; l < act->maneuverGroup_[k]->maneuver_.size(); l++)
+				{
+					OSCManeuver *maneuver = act->maneuverGroup_[k]->maneuver_[l];
+					for (size_t m = 0; m < maneuver->event_.size(); m++)
+					{
+						Event *event = maneuver->event_[m];
+						event_by_name_.emplace(event->name_, event);
+
+						for (size_t n = 0; n < event->action_.size(); n++)
+						{
+							action_by_name_.emplace(event->action_[n]->name_, event->action_[n]);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	indexed_ = true;
+}
+
+int StoryBoard::ResolveTrigger(Trigger *trigger)
+{
+	int n_unresolved = 0;
+
+	if (trigger == 0)
+	{
+		return 0;
+	}
+
+	for (size_t i = 0; i < trigger->conditionGroup_.size(); i++)
+	{
+		for (size_t j = 0; j < trigger->conditionGroup_[i]->condition_.size(); j++)
+		{
+			OSCCondition *condition = trigger->conditionGroup_[i]->condition_[j];
+			if (condition->base_type_ == OSCCondition::ConditionType::BY_STATE)
+			{
+				TrigByState *trig = (TrigByState*)condition;
+				if (trig->ResolveElement(this) == 0 && trig->element_type_ != StoryBoardElement::ElementType::STORY)
+				{
+					LOG("Condition %s: Failed to resolve storyboard element %s", trig->name_.c_str(), trig->element_name_.c_str());
+					n_unresolved++;
+				}
+			}
+		}
+	}
+
+	return n_unresolved;
+}
+
+int StoryBoard::ResolveReferences()
+{
+	int n_unresolved = 0;
+
+	BuildIndex();
+
+	n_unresolved += ResolveTrigger(stop_trigger_);
+
+	for (size_t i = 0; i < story_.size(); i++)
+	{
+		for (size_t j = 0; j < story_[i]->act_.size(); j++)
+		{
+			Act *act = story_[i]->act_[j];
+			n_unresolved += ResolveTrigger(act->start_trigger_);
+			n_unresolved += ResolveTrigger(act->stop_trigger_);
+
+			for (size_t k = 0; k < act->maneuverGroup_.size(); k++)
+			{
+				for (size_t l = 0; l < act->maneuverGroup_[k]->maneuver_.size(); l++)
+				{
+					OSCManeuver *maneuver = act->maneuverGroup_[k]->maneuver_[l];
+					for (size_t m = 0; m < maneuver->event_.size(); m++)
+					{
+						n_unresolved += ResolveTrigger(maneuver->event_[m]->start_trigger_);
+					}
+				}
+			}
+		}
+	}
+
+	return n_unresolved;
+}
+
 void StoryBoard::Print()
 {
 	LOG("Storyboard:");
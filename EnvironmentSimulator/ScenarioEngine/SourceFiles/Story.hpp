@@ -18,6 +18,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <unordered_map>
 
 namespace scenarioengine
 {
@@ -67,13 +68,29 @@ namespace scenarioengine
 	class StoryBoard
 	{
 	public:
-		StoryBoard() : stop_trigger_(0) {}
+		StoryBoard() : stop_trigger_(0), indexed_(false) {}
 		Act* FindActByName(std::string name);
 		Event* FindEventByName(std::string name);
 		OSCAction* FindActionByName(std::string name); 
 		void Print();
 
+		/**
+		Build the name index of acts, events and actions and resolve the element referred by each
+		StoryboardElementStateCondition to a direct pointer. Call once when the storyboard is completely parsed.
+		@return Number of state conditions which could not be resolved
+		*/
+		int ResolveReferences();
+
 		std::vector<Story*> story_;
 		Trigger *stop_trigger_;
+
+	private:
+		bool indexed_;
+		std::unordered_map<std::string, Act*> act_by_name_;
+		std::unordered_map<std::string, Event*> event_by_name_;
+		std::unordered_map<std::string, OSCAction*> action_by_name_;
+
+		void BuildIndex();
+		int ResolveTrigger(Trigger *trigger);
 	};
 }
\ No newline at end of file
@@ -14,26 +14,57 @@
 #include "Trail.hpp"
 #include "RoadManager.hpp"
 
-#define TRAIL_DT 0.5
-
 using namespace scenarioengine;
 
+void ObjectTrail::Enable(int max_states, double dt)
+{
+	Disable();
+	max_states_ = MAX(2, max_states);
+	dt_ = dt;
+	enabled_ = true;
+}
+
+void ObjectTrail::Disable()
+{
+	std::vector<ObjectTrailState>().swap(state_);
+	n_states_ = 0;
+	current_ = 0;
+	enabled_ = false;
+}
 
 void ObjectTrail::AddState(float timestamp, float x, float y, float z, float speed)
 {
 	ObjectTrailState *previous_state = 0;
+
+	if (!enabled_)
+	{
+		return;
+	}
 	
 	if (n_states_ > 0)
 	{
 		previous_state = GetStateLast();
 
 		// Check timestamp of previous state - add only if delta time has passed
-		if (previous_state && timestamp < previous_state->timeStamp_ + TRAIL_DT)
+		if (previous_state && timestamp < previous_state->timeStamp_ + dt_)
 		{
 			return;
 		}
 	}
 
+	if (n_states_ < max_states_)
+	{
+		// Still filling up, grow the buffer but not beyond max number of states
+		if (state_.size() == state_.capacity())
+		{
+			// Keep previous state valid by growing before it's referred
+			int previous_index = previous_state ? (int)(previous_state - &state_[0]) : -1;
+			state_.reserve(MIN(max_states_, MAX(64, 2 * (int)state_.capacity())));
+			previous_state = previous_index < 0 ? 0 : &state_[previous_index];
+		}
+		state_.push_back(ObjectTrailState());
+	}
+
 	state_[current_].timeStamp_ = timestamp;
 	state_[current_].x_ = x;
 	state_[current_].y_ = y;
@@ -55,14 +86,15 @@ void ObjectTrail::AddState(float timestamp, float x, float y, float z, float spe
 		state_[current_].h_ = 0;  // First point, direction not defined yet
 	}
 
-	current_ = (current_ + 1) % TRAIL_MAX_STATES;
+	current_ = (current_ + 1) % max_states_;
 
-	if (n_states_ == TRAIL_MAX_STATES - 1)
+	if (n_states_ == max_states_ - 1)
 	{
-		LOG("Trace array now full (%d entries) - for next entry buffer will wrap around", n_states_ + 1);
+		LOG("Trace array now full (%d entries, %d kB) - for next entry buffer will wrap around", 
+			n_states_ + 1, (int)(GetMemoryUsage() / 1024));
 	}
 
-	n_states_ = MIN(TRAIL_MAX_STATES, n_states_ + 1);
+	n_states_ = MIN(max_states_, n_states_ + 1);
 }
 
 ObjectTrailState* ObjectTrail::GetStateByTime(float timestamp)
@@ -122,7 +154,7 @@ int ObjectTrail::GetNextSegmentIndex(int index)
 
 	if (index == n_states_ - 1)
 	{
-		if (n_states_ == TRAIL_MAX_STATES)
+		if (n_states_ == max_states_)
 		{
 			// wrap around
 			next_index_candidate = 0;
@@ -159,7 +191,7 @@ int ObjectTrail::GetPreviousSegmentIndex(int index)
 	}
 	else if (index == 0)
 	{
-		if (n_states_ == TRAIL_MAX_STATES)
+		if (n_states_ == max_states_)
 		{
 			// All buckets in use, previous is last index
 			previous_index_candidate = n_states_ - 1;
@@ -10,9 +10,11 @@
  * https://sites.google.com/view/simulationscenarios
  */
 
+#include <vector>
 #include "RoadManager.hpp"
 
-#define TRAIL_MAX_STATES 4096
+#define TRAIL_MAX_STATES 4096  // default capacity
+#define TRAIL_DT 0.5  // default minimum time between states
 
 namespace scenarioengine
 {
@@ -30,11 +32,35 @@ namespace scenarioengine
 	{
 	public:
 
-		ObjectTrailState state_[TRAIL_MAX_STATES];
+		std::vector<ObjectTrailState> state_;  // ring buffer, grown on demand up to max number of states
 		int n_states_;
 		int current_;
 
-		ObjectTrail() : n_states_(0), current_(0) {}
+		ObjectTrail() : n_states_(0), current_(0), max_states_(TRAIL_MAX_STATES), dt_(TRAIL_DT), enabled_(false) {}
+
+		/**
+		Start recording states. Trails are off by default, since only some objects need one, e.g. ghosts 
+		followed by an external vehicle. Memory is allocated on demand as states are added. Any recorded 
+		states are discarded.
+		@param max_states Capacity, when reached the oldest states will be overwritten
+		@param dt Minimum time between recorded states
+		*/
+		void Enable(int max_states = TRAIL_MAX_STATES, double dt = TRAIL_DT);
+
+		/**
+		Stop recording and release all memory
+		*/
+		void Disable();
+		bool IsEnabled() { return enabled_; }
+		int GetMaxStates() { return max_states_; }
+		double GetDT() { return dt_; }
+
+		/**
+		Get memory currently allocated for recorded states
+		@return Number of bytes
+		*/
+		size_t GetMemoryUsage() { return state_.capacity() * sizeof(ObjectTrailState); }
+
 		void AddState(float timestamp, float x, float y, float z, float speed);
 		ObjectTrailState* GetStateByTime(float timestamp);
 		ObjectTrailState* GetStateLast();
@@ -62,6 +88,11 @@ namespace scenarioengine
 
 
 		int FindClosestPoint(double x0, double y0, double &x, double &y, double &s, int &idx, int start_search_index);
+
+	private:
+		int max_states_;
+		double dt_;
+		bool enabled_;
 	};
 
 }
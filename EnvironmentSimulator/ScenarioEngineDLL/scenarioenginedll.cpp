@@ -1,11 +1,11 @@
-/* 
- * esmini - Environment Simulator Minimalistic 
+/*
+ * esmini - Environment Simulator Minimalistic
  * https://github.com/esmini/esmini
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at https://mozilla.org/MPL/2.0/.
- * 
+ *
  * Copyright (c) partners of Simulation Scenarios
  * https://sites.google.com/view/simulationscenarios
  */
@@ -18,20 +18,42 @@ using namespace scenarioengine;
 
 #define EGO_ID 0	// need to match appearing order in the OpenSCENARIO file
 
+// Scenario instance created by SE_InitInstance, owning all data of the simulation
+typedef struct
+{
+	ScenarioPlayer *player;
+	roadmanager::OpenDrive *odr;  // road network of the instance
+	int argc;
+	char **argv;
+	SE_Mutex mutex;  // serialize calls on the instance
+} ScenarioInstance;
+
+// Locks an instance and binds its road network to the calling thread while in scope
+class InstanceAccess
+{
+public:
+	InstanceAccess(ScenarioInstance *instance) : instance_(instance), odr_binding_(instance->odr)
+	{
+		instance_->mutex.Lock();
+	}
+	~InstanceAccess()
+	{
+		instance_->mutex.Unlock();
+	}
+
+private:
+	ScenarioInstance *instance_;
+	roadmanager::OpenDriveThreadBinding odr_binding_;
+};
+
 static ScenarioPlayer *player = 0;
 
 static char **argv = 0;
 static int argc = 0;
 static std::vector<std::string> args_v;
 
-static void resetScenario(void)
+static void FreeArguments(char **&argv, int &argc)
 {
-	if (player)
-	{
-		delete player;
-		player = 0;
-	}
-	args_v.clear();
 	if (argv)
 	{
 		for (int i = 0; i < argc; i++)
@@ -44,7 +66,18 @@ static void resetScenario(void)
 	}
 }
 
-static void AddArgument(const char *str)
+static void resetScenario(void)
+{
+	if (player)
+	{
+		delete player;
+		player = 0;
+	}
+	args_v.clear();
+	FreeArguments(argv, argc);
+}
+
+static void AddArgument(std::vector<std::string> &args_v, const char *str)
 {
 	// split separate argument strings
 	std::vector<std::string> args = SplitString(std::string(str), ' ');
@@ -55,7 +88,7 @@ static void AddArgument(const char *str)
 	}
 }
 
-static void ConvertArguments()
+static void ConvertArguments(std::vector<std::string> &args_v, char **&argv, int &argc)
 {
 	argc = (int)args_v.size();
 	argv = (char**)malloc(argc * sizeof(char*));
@@ -67,6 +100,51 @@ static void ConvertArguments()
 	}
 }
 
+static void CreateArguments(std::vector<std::string> &args_v, const char *oscFilename, int control,
+	bool use_viewer, bool threads, const char *record_filename, float headstart_time)
+{
+	AddArgument(args_v, "viewer");  // name of application
+	AddArgument(args_v, "--osc");
+	AddArgument(args_v, oscFilename);
+	AddArgument(args_v, "--control");
+	if (control == 0)
+	{
+		AddArgument(args_v, "osc");
+	}
+	else if (control == 1)
+	{
+		AddArgument(args_v, "internal");
+	}
+	else if (control == 2)
+	{
+		AddArgument(args_v, "external");
+	}
+	else if (control == 3)
+	{
+		AddArgument(args_v, "hybrid");
+	}
+	if (record_filename && record_filename[0] != 0)
+	{
+		AddArgument(args_v, "--record");
+		args_v.push_back(record_filename);
+	}
+	if (use_viewer)
+	{
+		AddArgument(args_v, "--window 30 30 800 400");
+	}
+	else
+	{
+		AddArgument(args_v, "--headless");
+	}
+	if (threads)
+	{
+		AddArgument(args_v, "--threads");
+		LOG("Threads arg created");
+	}
+
+	AddArgument(args_v, std::string("--ghost_headstart " + std::to_string((long double)headstart_time)).c_str());
+}
+
 static void copyStateFromScenarioGateway(SE_ScenarioObjectState *state, ObjectStateStruct *gw_state)
 {
 	state->id = gw_state->id;
@@ -89,7 +167,7 @@ static void copyStateFromScenarioGateway(SE_ScenarioObjectState *state, ObjectSt
 
 }
 
-static int GetRoadInfoAtDistance(int object_id, float lookahead_distance, SE_RoadInfo *r_data, int lookAheadMode)
+static int GetRoadInfoAtDistance(ScenarioPlayer *player, int object_id, float lookahead_distance, SE_RoadInfo *r_data, int lookAheadMode)
 {
 	roadmanager::RoadProbeInfo s_data;
 
@@ -105,7 +183,7 @@ static int GetRoadInfoAtDistance(int object_id, float lookahead_distance, SE_Roa
 	}
 
 	roadmanager::Position *pos = &player->scenarioGateway->getObjectStatePtrByIdx(object_id)->state_.pos;
-	
+
 	if (pos->GetProbeInfo(lookahead_distance, &s_data, (roadmanager::Position::LookAheadMode)lookAheadMode) != 0)
 	{
 		return -1;
@@ -131,7 +209,7 @@ static int GetRoadInfoAtDistance(int object_id, float lookahead_distance, SE_Roa
 	}
 }
 
-static int GetRoadInfoAlongGhostTrail(int object_id, float lookahead_distance, SE_RoadInfo *r_data, float *speed_ghost)
+static int GetRoadInfoAlongGhostTrail(ScenarioPlayer *player, int object_id, float lookahead_distance, SE_RoadInfo *r_data, float *speed_ghost)
 {
 	roadmanager::RoadProbeInfo s_data;
 
@@ -196,7 +274,7 @@ static int GetRoadInfoAlongGhostTrail(int object_id, float lookahead_distance, S
 	return 0;
 }
 
-static int GetRoadLaneInfo(int object_id, float lookahead_distance, SE_LaneInfo *dll_data, int lookAheadMode)
+static int GetRoadLaneInfo(ScenarioPlayer *player, int object_id, float lookahead_distance, SE_LaneInfo *dll_data, int lookAheadMode)
 {
 	roadmanager::RoadLaneInfo rm_data;
 
@@ -228,60 +306,228 @@ static int GetRoadLaneInfo(int object_id, float lookahead_distance, SE_LaneInfo
 	return 0;
 }
 
-extern "C"
+static int ReportObjectPos(ScenarioPlayer *player, int id, float timestamp, float x, float y, float z, float h, float p, float r, float speed)
 {
-	SE_DLL_API int SE_Init(const char *oscFilename, int control, int use_viewer, int threads, int record, float headstart_time)
+	if (player)
 	{
-		resetScenario();
-
-#ifndef _SCENARIO_VIEWER
-		if (use_viewer)
+		if (id < player->scenarioEngine->entities.object_.size())
 		{
-			LOG("use_viewer flag set, but no viewer available (compiled without -D _SCENARIO_VIEWER");
+			// reuse some values
+			Object *obj = player->scenarioEngine->entities.object_[id];
+			int control = obj->control_ == Object::Control::EXTERNAL || obj->control_ == Object::Control::HYBRID_EXTERNAL;
+			player->scenarioGateway->reportObject(id, obj->name_, obj->model_id_, control, timestamp, speed, 0, 0, x, y, z, h, p, r);
 		}
-#endif	
+	}
 
-		AddArgument("viewer");  // name of application
-		AddArgument("--osc");
-		AddArgument(oscFilename);
-		AddArgument("--control");
-		if (control == 0)
+	return 0;
+}
+
+static int ReportObjectRoadPos(ScenarioPlayer *player, int id, float timestamp, int roadId, int laneId, float laneOffset, float s, float speed)
+{
+	if (player)
+	{
+		if (id < player->scenarioEngine->entities.object_.size())
 		{
-			AddArgument("osc");
+			// reuse some values
+			Object *obj = player->scenarioEngine->entities.object_[id];
+			int control = obj->control_ == Object::Control::EXTERNAL || obj->control_ == Object::Control::HYBRID_EXTERNAL;
+			player->scenarioGateway->reportObject(id, obj->name_, obj->model_id_, control, timestamp, speed, 0, 0, roadId, laneId, laneOffset, s);
 		}
-		else if (control == 1)
+	}
+
+	return 0;
+}
+
+static int ReportObjectStates(ScenarioPlayer *player, int n_objects, SE_ObjectReport *report, int *status)
+{
+	// Reused between calls, per thread since instances may be stepped concurrently
+	static thread_local std::vector<ObjectReport> gw_report;
+	static thread_local std::vector<int> gw_status;
+	static thread_local std::vector<int> report_idx;
+
+	if (player == 0 || report == 0)
+	{
+		return -1;
+	}
+
+	gw_report.clear();
+	report_idx.clear();
+
+	for (int i = 0; i < n_objects; i++)
+	{
+		SE_ObjectReport *r = &report[i];
+
+		int n_available = (int)player->scenarioEngine->entities.object_.size();
+
+		if (r->id < 0 || r->id >= n_available)
 		{
-			AddArgument("internal");
+			LOG("Invalid object id %d (%d available)", r->id, n_available);
+			if (status)
+			{
+				status[i] = -1;
+			}
+			continue;
 		}
-		else if (control == 2)
+
+		// reuse some values
+		Object *obj = player->scenarioEngine->entities.object_[r->id];
+		ObjectReport gr;
+
+		gr.id = r->id;
+		gr.name = &obj->name_;
+		gr.model_id = obj->model_id_;
+		gr.control = obj->control_ == Object::Control::EXTERNAL || obj->control_ == Object::Control::HYBRID_EXTERNAL;
+		gr.timestamp = r->timestamp;
+		gr.speed = r->speed;
+		gr.wheel_angle = 0;
+		gr.wheel_rot = 0;
+		gr.road_pos = r->pos_type == 1;
+		gr.x = r->x;
+		gr.y = r->y;
+		gr.z = r->z;
+		gr.h = r->h;
+		gr.p = r->p;
+		gr.r = r->r;
+		gr.roadId = r->roadId;
+		gr.laneId = r->laneId;
+		gr.laneOffset = r->laneOffset;
+		gr.s = r->s;
+
+		gw_report.push_back(gr);
+		report_idx.push_back(i);
+	}
+
+	gw_status.resize(gw_report.size());
+	int n_reported = player->scenarioGateway->reportObjects(gw_report.data(), (int)gw_report.size(), gw_status.data());
+
+	if (status)
+	{
+		for (size_t i = 0; i < report_idx.size(); i++)
 		{
-			AddArgument("external");
+			status[report_idx[i]] = gw_status[i];
 		}
-		else if (control == 3)
+	}
+
+	return n_reported;
+}
+
+static int GetNumberOfObjects(ScenarioPlayer *player)
+{
+	if (player)
+	{
+		return player->scenarioGateway->getNumberOfObjects();
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+static int GetObjectState(ScenarioPlayer *player, int index, SE_ScenarioObjectState *state)
+{
+	if (player)
+	{
+		copyStateFromScenarioGateway(state, &player->scenarioGateway->getObjectStatePtrByIdx(index)->state_);
+	}
+
+	return 0;
+}
+
+static int GetObjectGhostState(ScenarioPlayer *player, int index, SE_ScenarioObjectState *state)
+{
+	if (player)
+	{
+		if (index < player->scenarioEngine->entities.object_.size())
 		{
-			AddArgument("hybrid");
+			for (size_t i = 0; i < player->scenarioEngine->entities.object_.size(); i++)  // ghost index always higher than external buddy
+			{
+				if (player->scenarioEngine->entities.object_[index]->ghost_)
+				{
+					scenarioengine::ObjectState obj_state;
+					player->scenarioGateway->getObjectStateById(player->scenarioEngine->entities.object_[index]->ghost_->id_, obj_state);
+					copyStateFromScenarioGateway(state, &obj_state.state_);
+				}
+			}
 		}
-		if (record)
+	}
+
+	return 0;
+}
+
+static int GetObjectStates(ScenarioPlayer *player, int *nObjects, SE_ScenarioObjectState* state)
+{
+	int i;
+
+	if (player)
+	{
+		for (i = 0; i < *nObjects && i < player->scenarioGateway->getNumberOfObjects(); i++)
 		{
-			AddArgument("--record scenario.dat");
+			copyStateFromScenarioGateway(&state[i], &player->scenarioGateway->getObjectStatePtrByIdx(i)->state_);
 		}
-		if (use_viewer)
+		*nObjects = i;
+	}
+	else
+	{
+		*nObjects = 0;
+	}
+	return 0;
+}
+
+static int AddObjectSensor(ScenarioPlayer *player, int object_id, float x, float y, float z, float h, float rangeNear, float rangeFar, float fovH, int maxObj)
+{
+	if (player == 0)
+	{
+		return -1;
+	}
+
+	if (object_id < 0 || object_id >= player->scenarioEngine->entities.object_.size())
+	{
+		LOG("Invalid object_id (%d/%d)", object_id, player->scenarioEngine->entities.object_.size());
+		return -1;
+	}
+
+	player->AddObjectSensor(object_id, x, y, z, h, rangeNear, rangeFar, fovH, maxObj);
+	player->ShowObjectSensors(true);
+
+	return 0;
+}
+
+static int FetchSensorObjectList(ScenarioPlayer *player, int sensor_id, int *list)
+{
+	if (player)
+	{
+		if (sensor_id < 0 || sensor_id >= player->sensor.size())
 		{
-			AddArgument("--window 30 30 800 400");
+			LOG("Invalid sensor_id (%d specified / %d available)", sensor_id, player->sensor.size());
+			return -1;
 		}
-		else
+
+		for (int i = 0; i < player->sensor[sensor_id]->nObj_; i++)
 		{
-			AddArgument("--headless");
+			list[i] = player->sensor[sensor_id]->hitList_[i].obj_->id_;
 		}
-		if (threads)
+
+		return player->sensor[sensor_id]->nObj_;
+	}
+
+	return -1;
+}
+
+extern "C"
+{
+	SE_DLL_API int SE_Init(const char *oscFilename, int control, int use_viewer, int threads, int record, float headstart_time)
+	{
+		resetScenario();
+
+#ifndef _SCENARIO_VIEWER
+		if (use_viewer)
 		{
-			AddArgument("--threads");
-			LOG("Threads arg created");
+			LOG("use_viewer flag set, but no viewer available (compiled without -D _SCENARIO_VIEWER");
 		}
+#endif
 
-		AddArgument(std::string("--ghost_headstart " + std::to_string((long double)headstart_time)).c_str());
-
-		ConvertArguments();
+		CreateArguments(args_v, oscFilename, control, use_viewer != 0, threads != 0, record ? "scenario.dat" : 0, headstart_time);
+		ConvertArguments(args_v, argv, argc);
 
 		// Create scenario engine
 		try
@@ -306,6 +552,11 @@ extern "C"
 		return 0;
 	}
 
+	SE_DLL_API void SE_SetSeed(unsigned int seed)
+	{
+		SE_Random::SetGlobalSeed(seed);
+	}
+
 	SE_DLL_API void SE_Close()
 	{
 		resetScenario();
@@ -336,7 +587,7 @@ extern "C"
 			return -1;
 		}
 	}
-	
+
 	SE_DLL_API float SE_GetSimulationTime()
 	{
 		return (float)player->scenarioEngine->getSimulationTime();
@@ -344,178 +595,445 @@ extern "C"
 
 	SE_DLL_API int SE_ReportObjectPos(int id, float timestamp, float x, float y, float z, float h, float p, float r, float speed)
 	{
-		if (player)
+		return ReportObjectPos(player, id, timestamp, x, y, z, h, p, r, speed);
+	}
+
+	SE_DLL_API int SE_ReportObjectRoadPos(int id, float timestamp, int roadId, int laneId, float laneOffset, float s, float speed)
+	{
+		return ReportObjectRoadPos(player, id, timestamp, roadId, laneId, laneOffset, s, speed);
+	}
+
+	SE_DLL_API int SE_ReportObjectStates(int nObjects, SE_ObjectReport *report, int *status)
+	{
+		return ReportObjectStates(player, nObjects, report, status);
+	}
+
+	SE_DLL_API int SE_SetReportThreads(int n_threads)
+	{
+		if (player == 0)
 		{
-			if (id < player->scenarioEngine->entities.object_.size())
-			{
-				// reuse some values
-				Object *obj = player->scenarioEngine->entities.object_[id];
-				int control = obj->control_ == Object::Control::EXTERNAL || obj->control_ == Object::Control::HYBRID_EXTERNAL;
-				player->scenarioGateway->reportObject(id, obj->name_, obj->model_id_, control, timestamp, speed, 0, 0, x, y, z, h, p, r);
-			}
+			return -1;
 		}
 
+		player->scenarioGateway->SetReportThreads(n_threads);
+
 		return 0;
 	}
 
-	SE_DLL_API int SE_ReportObjectRoadPos(int id, float timestamp, int roadId, int laneId, float laneOffset, float s, float speed)
+	SE_DLL_API int SE_GetNumberOfObjects()
 	{
-		if (player)
+		return GetNumberOfObjects(player);
+	}
+
+	SE_DLL_API int SE_GetObjectState(int index, SE_ScenarioObjectState *state)
+	{
+		return GetObjectState(player, index, state);
+	}
+
+	SE_DLL_API int SE_GetObjectGhostState(int index, SE_ScenarioObjectState *state)
+	{
+		return GetObjectGhostState(player, index, state);
+	}
+
+	SE_DLL_API int SE_GetObjectStates(int *nObjects, SE_ScenarioObjectState* state)
+	{
+		return GetObjectStates(player, nObjects, state);
+	}
+
+	SE_DLL_API int SE_AddObjectSensor(int object_id, float x, float y, float z, float h, float rangeNear, float rangeFar, float fovH, int maxObj)
+	{
+		return AddObjectSensor(player, object_id, x, y, z, h, rangeNear, rangeFar, fovH, maxObj);
+	}
+
+	SE_DLL_API int SE_FetchSensorObjectList(int sensor_id, int *list)
+	{
+		return FetchSensorObjectList(player, sensor_id, list);
+	}
+
+	SE_DLL_API int SE_SetSensorThreads(int n_threads)
+	{
+		if (player == 0)
 		{
-			if (id < player->scenarioEngine->entities.object_.size())
-			{
-				// reuse some values
-				Object *obj = player->scenarioEngine->entities.object_[id];
-				int control = obj->control_ == Object::Control::EXTERNAL || obj->control_ == Object::Control::HYBRID_EXTERNAL;
-				player->scenarioGateway->reportObject(id, obj->name_, obj->model_id_, control, timestamp, speed, 0, 0, roadId, laneId, laneOffset, s);
-			}
+			return -1;
 		}
 
+		player->SetSensorThreads(n_threads);
+
 		return 0;
 	}
 
-	SE_DLL_API int SE_GetNumberOfObjects()
+	SE_DLL_API int SE_SetObjectThreads(int n_threads)
 	{
-		if (player)
+		if (player == 0)
 		{
-			return player->scenarioGateway->getNumberOfObjects();
+			return -1;
 		}
-		else
+
+		player->scenarioEngine->SetObjectThreads(n_threads);
+
+		return 0;
+	}
+
+	SE_DLL_API int SE_GetRoadInfoAtDistance(int object_id, float lookahead_distance, SE_RoadInfo *data, int lookAheadMode)
+	{
+		if (player == 0 || object_id >= player->scenarioGateway->getNumberOfObjects())
 		{
-			return 0;
+			return -1;
 		}
+
+		if (GetRoadInfoAtDistance(player, object_id, lookahead_distance, data, lookAheadMode) != 0)
+		{
+			return -1;
+		}
+
+//		Set_se_steering_target_pos(object_id, data->global_pos_x, data->global_pos_y, data->global_pos_z);
+
+		return 0;
 	}
 
-	SE_DLL_API int SE_GetObjectState(int index, SE_ScenarioObjectState *state)
+	SE_DLL_API int SE_GetLaneInfoAtDistance(int object_id, float lookahead_distance, SE_LaneInfo *data, int lookAheadMode)
 	{
-		if (player)
+		GetRoadLaneInfo(player, object_id, lookahead_distance, data, lookAheadMode);
+
+		return 0;
+	}
+
+	SE_DLL_API int SE_GetRoadInfoAlongGhostTrail(int object_id, float lookahead_distance, SE_RoadInfo *data, float *speed_ghost)
+	{
+		if (player == 0 || object_id >= player->scenarioGateway->getNumberOfObjects())
+		{
+			return -1;
+		}
+
+		if (GetRoadInfoAlongGhostTrail(player, object_id, lookahead_distance, data, speed_ghost) != 0)
 		{
-			copyStateFromScenarioGateway(state, &player->scenarioGateway->getObjectStatePtrByIdx(index)->state_);
+			return -1;
 		}
 
+//		Set_se_ghost_pos(object_id, data->global_pos_x, data->global_pos_y, data->global_pos_z);
+		//LOG("id %d dist %.2f x %.2f y %.2f z %.2f", object_id, lookahead_distance, data->global_pos_x, data->global_pos_y, data->global_pos_z);
 		return 0;
 	}
 
-	SE_DLL_API int SE_GetObjectGhostState(int index, SE_ScenarioObjectState *state)
+	// Instance API
+
+	SE_DLL_API void *SE_InitInstance(const char *oscFilename, int control, const char *record_filename, float headstart_time)
 	{
-		if (player)
+		ScenarioInstance *instance = new ScenarioInstance;
+		std::vector<std::string> args;
+
+		instance->player = 0;
+		instance->odr = new roadmanager::OpenDrive;
+
+		CreateArguments(args, oscFilename, control, false, false, record_filename, headstart_time);
+		ConvertArguments(args, instance->argv, instance->argc);
+
+		try
 		{
-			if (index < player->scenarioEngine->entities.object_.size())
-			{
-				for (size_t i = 0; i < player->scenarioEngine->entities.object_.size(); i++)  // ghost index always higher than external buddy
-				{
-					if (player->scenarioEngine->entities.object_[index]->ghost_)
-					{
-						scenarioengine::ObjectState obj_state;
-						player->scenarioGateway->getObjectStateById(player->scenarioEngine->entities.object_[index]->ghost_->id_, obj_state);
-						copyStateFromScenarioGateway(state, &obj_state.state_);
-					}
-				}
-			}
+			// Road network will be loaded into the one of the instance
+			InstanceAccess access(instance);
+
+			instance->player = new ScenarioPlayer(instance->argc, instance->argv);
+		}
+		catch (const std::exception& e)
+		{
+			LOG("%s", e.what());
+			SE_CloseInstance(instance);
+			return 0;
 		}
 
-		return 0;
+		return instance;
 	}
 
-	SE_DLL_API int SE_GetObjectStates(int *nObjects, SE_ScenarioObjectState* state)
+	SE_DLL_API void SE_CloseInstance(void *handle)
 	{
-		int i;
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
 
-		if (player)
+		if (instance == 0)
 		{
-			for (i = 0; i < *nObjects && i < player->scenarioGateway->getNumberOfObjects(); i++)
-			{
-				copyStateFromScenarioGateway(&state[i], &player->scenarioGateway->getObjectStatePtrByIdx(i)->state_);
-			}
-			*nObjects = i;
+			return;
 		}
-		else
+
+		// Caller guarantees no other call on the instance is in progress, see header. The lock only 
+		// binds the road network, it can't protect the instance from being used after deletion.
 		{
-			*nObjects = 0;
+			InstanceAccess access(instance);
+
+			delete instance->player;
+			FreeArguments(instance->argv, instance->argc);
 		}
+
+		delete instance->odr;
+		delete instance;
+	}
+
+	SE_DLL_API int SE_StepInstance(void *handle, float dt)
+	{
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
+		{
+			return -1;
+		}
+
+		InstanceAccess access(instance);
+		instance->player->Frame(dt);
+
 		return 0;
 	}
 
-	SE_DLL_API int SE_AddObjectSensor(int object_id, float x, float y, float z, float h, float rangeNear, float rangeFar, float fovH, int maxObj)
+	SE_DLL_API int SE_GetQuitFlagInstance(void *handle)
 	{
-		if (player)
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
 		{
+			return -1;
+		}
 
-			if (object_id < 0 || object_id >= player->scenarioEngine->entities.object_.size())
-			{
-				LOG("Invalid object_id (%d/%d)", object_id, player->scenarioEngine->entities.object_.size());
-				return -1;
-			}
+		InstanceAccess access(instance);
+
+		return instance->player->IsQuitRequested() ? 1 : 0;
+	}
+
+	SE_DLL_API float SE_GetSimulationTimeInstance(void *handle)
+	{
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
+		{
+			return 0.0f;
+		}
+
+		InstanceAccess access(instance);
 
-			player->AddObjectSensor(object_id, x, y, z, h, rangeNear, rangeFar, fovH, maxObj);
+		return (float)instance->player->scenarioEngine->getSimulationTime();
+	}
+
+	SE_DLL_API int SE_ReportObjectPosInstance(void *handle, int id, float timestamp, float x, float y, float z, float h, float p, float r, float speed)
+	{
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
+		{
+			return -1;
 		}
-		
-		player->ShowObjectSensors(true);
+
+		InstanceAccess access(instance);
+
+		return ReportObjectPos(instance->player, id, timestamp, x, y, z, h, p, r, speed);
+	}
+
+	SE_DLL_API int SE_ReportObjectRoadPosInstance(void *handle, int id, float timestamp, int roadId, int laneId, float laneOffset, float s, float speed)
+	{
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
+		{
+			return -1;
+		}
+
+		InstanceAccess access(instance);
+
+		return ReportObjectRoadPos(instance->player, id, timestamp, roadId, laneId, laneOffset, s, speed);
+	}
+
+	SE_DLL_API int SE_ReportObjectStatesInstance(void *handle, int nObjects, SE_ObjectReport *report, int *status)
+	{
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
+		{
+			return -1;
+		}
+
+		InstanceAccess access(instance);
+
+		return ReportObjectStates(instance->player, nObjects, report, status);
+	}
+
+	SE_DLL_API int SE_SetReportThreadsInstance(void *handle, int n_threads)
+	{
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
+		{
+			return -1;
+		}
+
+		InstanceAccess access(instance);
+
+		instance->player->scenarioGateway->SetReportThreads(n_threads);
 
 		return 0;
 	}
 
-	SE_DLL_API int SE_FetchSensorObjectList(int sensor_id, int *list)
+	SE_DLL_API int SE_GetNumberOfObjectsInstance(void *handle)
 	{
-		if (player)
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
 		{
-			if (sensor_id < 0 || sensor_id >= player->sensor.size())
-			{
-				LOG("Invalid sensor_id (%d specified / %d available)", sensor_id, player->sensor.size());
-				return -1;
-			}
+			return 0;
+		}
 
-			for (int i = 0; i < player->sensor[sensor_id]->nObj_; i++)
-			{
-				list[i] = player->sensor[sensor_id]->hitList_[i].obj_->id_;
-			}
-			
-			return player->sensor[sensor_id]->nObj_;
+		InstanceAccess access(instance);
+
+		return GetNumberOfObjects(instance->player);
+	}
+
+	SE_DLL_API int SE_GetObjectStateInstance(void *handle, int index, SE_ScenarioObjectState *state)
+	{
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
+		{
+			return -1;
 		}
-		
-		return -1;
+
+		InstanceAccess access(instance);
+
+		if (index < 0 || index >= GetNumberOfObjects(instance->player))
+		{
+			return -1;
+		}
+
+		return GetObjectState(instance->player, index, state);
 	}
 
-	SE_DLL_API int SE_GetRoadInfoAtDistance(int object_id, float lookahead_distance, SE_RoadInfo *data, int lookAheadMode)
+	SE_DLL_API int SE_GetObjectGhostStateInstance(void *handle, int index, SE_ScenarioObjectState *state)
 	{
-		if (player == 0 || object_id >= player->scenarioGateway->getNumberOfObjects())
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
 		{
 			return -1;
 		}
 
-		if (GetRoadInfoAtDistance(object_id, lookahead_distance, data, lookAheadMode) != 0)
+		InstanceAccess access(instance);
+
+		return GetObjectGhostState(instance->player, index, state);
+	}
+
+	SE_DLL_API int SE_GetObjectStatesInstance(void *handle, int *nObjects, SE_ScenarioObjectState* state)
+	{
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
 		{
+			*nObjects = 0;
 			return -1;
 		}
 
-//		Set_se_steering_target_pos(object_id, data->global_pos_x, data->global_pos_y, data->global_pos_z);
+		InstanceAccess access(instance);
+
+		return GetObjectStates(instance->player, nObjects, state);
+	}
+
+	SE_DLL_API int SE_AddObjectSensorInstance(void *handle, int object_id, float x, float y, float z, float h, float rangeNear, float rangeFar, float fovH, int maxObj)
+	{
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
+		{
+			return -1;
+		}
+
+		InstanceAccess access(instance);
+
+		if (AddObjectSensor(instance->player, object_id, x, y, z, h, rangeNear, rangeFar, fovH, maxObj) != 0)
+		{
+			return -1;
+		}
+
+		return (int)instance->player->sensor.size() - 1;
+	}
+
+	SE_DLL_API int SE_FetchSensorObjectListInstance(void *handle, int sensor_id, int *list)
+	{
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
+		{
+			return -1;
+		}
+
+		InstanceAccess access(instance);
+
+		return FetchSensorObjectList(instance->player, sensor_id, list);
+	}
+
+	SE_DLL_API int SE_SetSensorThreadsInstance(void *handle, int n_threads)
+	{
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
+		{
+			return -1;
+		}
+
+		InstanceAccess access(instance);
+
+		instance->player->SetSensorThreads(n_threads);
 
 		return 0;
 	}
 
-	SE_DLL_API int SE_GetLaneInfoAtDistance(int object_id, float lookahead_distance, SE_LaneInfo *data, int lookAheadMode)
+	SE_DLL_API int SE_SetObjectThreadsInstance(void *handle, int n_threads)
 	{
-		roadmanager::RoadLaneInfo s_data;
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
 
-		GetRoadLaneInfo(object_id, lookahead_distance, data, lookAheadMode);
+		if (instance == 0)
+		{
+			return -1;
+		}
+
+		InstanceAccess access(instance);
+
+		instance->player->scenarioEngine->SetObjectThreads(n_threads);
 
 		return 0;
 	}
 
-	SE_DLL_API int SE_GetRoadInfoAlongGhostTrail(int object_id, float lookahead_distance, SE_RoadInfo *data, float *speed_ghost)
+	SE_DLL_API int SE_GetRoadInfoAtDistanceInstance(void *handle, int object_id, float lookahead_distance, SE_RoadInfo *data, int lookAheadMode)
 	{
-		if (player == 0 || object_id >= player->scenarioGateway->getNumberOfObjects())
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
+		{
+			return -1;
+		}
+
+		InstanceAccess access(instance);
+
+		return GetRoadInfoAtDistance(instance->player, object_id, lookahead_distance, data, lookAheadMode);
+	}
+
+	SE_DLL_API int SE_GetLaneInfoAtDistanceInstance(void *handle, int object_id, float lookahead_distance, SE_LaneInfo *data, int lookAheadMode)
+	{
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
 		{
 			return -1;
 		}
 
-		if (GetRoadInfoAlongGhostTrail(object_id, lookahead_distance, data, speed_ghost) != 0)
+		InstanceAccess access(instance);
+
+		return GetRoadLaneInfo(instance->player, object_id, lookahead_distance, data, lookAheadMode);
+	}
+
+	SE_DLL_API int SE_GetRoadInfoAlongGhostTrailInstance(void *handle, int object_id, float lookahead_distance, SE_RoadInfo *data, float *speed_ghost)
+	{
+		ScenarioInstance *instance = (ScenarioInstance*)handle;
+
+		if (instance == 0)
 		{
 			return -1;
 		}
 
-//		Set_se_ghost_pos(object_id, data->global_pos_x, data->global_pos_y, data->global_pos_z);
-		//LOG("id %d dist %.2f x %.2f y %.2f z %.2f", object_id, lookahead_distance, data->global_pos_x, data->global_pos_y, data->global_pos_z);
-		return 0;
+		InstanceAccess access(instance);
+
+		return GetRoadInfoAlongGhostTrail(instance->player, object_id, lookahead_distance, data, speed_ghost);
 	}
 }
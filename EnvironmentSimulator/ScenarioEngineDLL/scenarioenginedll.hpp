@@ -40,6 +40,24 @@ typedef struct
 	float speed;         //只声明成员变量，不声明函数
 } SE_ScenarioObjectState;    //SE_ScenariosObjectState是这个结构体的名称
 
+typedef struct
+{
+	int id;                 // Object id, see SE_ScenarioObjectState
+	int pos_type;           // 0=position given by x, y, z, h, p, r 1=given by roadId, laneId, laneOffset, s
+	float timestamp;
+	float x;
+	float y;
+	float z;
+	float h;
+	float p;
+	float r;
+	int roadId;
+	int laneId;
+	float laneOffset;
+	float s;
+	float speed;
+} SE_ObjectReport;
+
 typedef struct
 {
 	float x;                // target position, in global coordinate system
@@ -87,6 +105,13 @@ extern "C"  			//符合c语言的编译，即本本部分按照c语言的规则
 	*/
 	SE_DLL_API int SE_Init(const char *oscFilename, int control, int use_viewer, int threads, int record, float headstart_time);
 
+	/**
+	Set seed of random choices, e.g. at junctions. Call before SE_Init. Same seed gives same choices, default is time.
+	Applies to all instances initialized hereafter.
+	@param seed Any number, e.g. the one logged by a previous run
+	*/
+	SE_DLL_API void SE_SetSeed(unsigned int seed);
+
 	/**
 	Step the simulation forward with specified timestep
 	@param dt time step in seconds
@@ -113,6 +138,22 @@ extern "C"  			//符合c语言的编译，即本本部分按照c语言的规则
 	SE_DLL_API int SE_ReportObjectPos(int id, float timestamp, float x, float y, float z, float h, float p, float r, float speed);
 	SE_DLL_API int SE_ReportObjectRoadPos(int id, float timestamp, int roadId, int laneId, float laneOffset, float s, float speed);
 
+	/**
+	Report states of multiple externally controlled objects in one call, more efficient than one call per object
+	@param nObjects Number of elements in report
+	@param report Array of object states, each object at most once
+	@param status Optional array receiving per object result: 0 if successful, -1 if not (e.g. invalid id or road). May be 0.
+	@return Number of successfully reported objects, -1 on error
+	*/
+	SE_DLL_API int SE_ReportObjectStates(int nObjects, SE_ObjectReport *report, int *status);
+
+	/**
+	Resolve road positions of SE_ReportObjectStates in parallel
+	@param n_threads Number of threads, including the calling one. 1 for sequential resolve.
+	@return 0 if successful, -1 if not
+	*/
+	SE_DLL_API int SE_SetReportThreads(int n_threads);
+
 	SE_DLL_API int SE_GetNumberOfObjects();
 	SE_DLL_API int SE_GetObjectState(int index, SE_ScenarioObjectState *state);
 	SE_DLL_API int SE_GetObjectGhostState(int index, SE_ScenarioObjectState *state);
@@ -141,6 +182,20 @@ extern "C"  			//符合c语言的编译，即本本部分按照c语言的规则
 	*/
 	SE_DLL_API int SE_FetchSensorObjectList(int sensor_id, int *list);
 
+	/**
+	Update sensors in parallel, see also player argument --sensor_threads
+	@param n_threads Number of threads, including the one calling step. 1 for sequential updates.
+	@return 0 if successful, -1 if not
+	*/
+	SE_DLL_API int SE_SetSensorThreads(int n_threads);
+
+	/**
+	Step objects and their init actions in parallel, see also player argument --object_threads
+	@param n_threads Number of threads, including the one calling step. 1 for sequential updates.
+	@return 0 if successful, -1 if not
+	*/
+	SE_DLL_API int SE_SetObjectThreads(int n_threads);
+
 	/**
 	Get information suitable for driver modeling of a point at a specified distance from object along the road ahead
 	@param object_id Id of the object from which to measure
@@ -171,6 +226,74 @@ extern "C"  			//符合c语言的编译，即本本部分按照c语言的规则
 	*/
 	SE_DLL_API int SE_GetRoadInfoAlongGhostTrail(int object_id, float lookahead_distance, SE_RoadInfo *data, float *speed_ghost);
 
+	/*
+	Instance API
+
+	Any number of scenarios can be hosted in parallel, each one identified by the handle returned from
+	SE_InitInstance. An instance owns its scenario engine, gateway, sensors and road network, so instances
+	do not share any data. 
+
+	Thread safety: All instance functions may be called from any thread. Calls on different instances run 
+	concurrently, calls on the same instance are serialized. Exception is SE_CloseInstance, which must not 
+	be called while any other call on the same instance is in progress or may follow, i.e. the application 
+	owns the handle and closes it once all its threads are done with it. Instances are always headless 
+	(no viewer) and do not support the external Ego UDP server. The functions above, operating on the single 
+	default scenario, must not be called concurrently.
+	*/
+
+	/**
+	Create and initialize a scenario instance
+	@param oscFilename Path to the OpenSCEANRIO file
+	@param control Ego control 0=by OSC 1=Internal 2=External 3=Hybrid
+	@param record_filename Create recording for later playback into specified file, 0 or "" for no recording
+	@param headstart_time For hybrid control mode launch ghost vehicle with this headstart time 
+	@return Handle to the instance, 0 if unsuccessful
+	*/
+	SE_DLL_API void *SE_InitInstance(const char *oscFilename, int control, const char *record_filename, float headstart_time);
+
+	/**
+	Stop simulation and release all resources of the instance. The handle is invalid after this call.
+	Must not be called concurrently with any other call on the same instance, see thread safety above.
+	@param handle Handle to the instance
+	*/
+	SE_DLL_API void SE_CloseInstance(void *handle);
+
+	/**
+	Step the simulation of the instance forward with specified timestep
+	@param handle Handle to the instance
+	@param dt time step in seconds
+	@return 0 if successful, -1 if not
+	*/
+	SE_DLL_API int SE_StepInstance(void *handle, float dt);
+
+	/**
+	Check whether the scenario has ended
+	@param handle Handle to the instance
+	@return 1 if ended, 0 if still running, -1 on error
+	*/
+	SE_DLL_API int SE_GetQuitFlagInstance(void *handle);
+
+	SE_DLL_API float SE_GetSimulationTimeInstance(void *handle);
+	SE_DLL_API int SE_ReportObjectPosInstance(void *handle, int id, float timestamp, float x, float y, float z, float h, float p, float r, float speed);
+	SE_DLL_API int SE_ReportObjectRoadPosInstance(void *handle, int id, float timestamp, int roadId, int laneId, float laneOffset, float s, float speed);
+	SE_DLL_API int SE_ReportObjectStatesInstance(void *handle, int nObjects, SE_ObjectReport *report, int *status);
+	SE_DLL_API int SE_SetReportThreadsInstance(void *handle, int n_threads);
+	SE_DLL_API int SE_GetNumberOfObjectsInstance(void *handle);
+	SE_DLL_API int SE_GetObjectStateInstance(void *handle, int index, SE_ScenarioObjectState *state);
+	SE_DLL_API int SE_GetObjectGhostStateInstance(void *handle, int index, SE_ScenarioObjectState *state);
+	SE_DLL_API int SE_GetObjectStatesInstance(void *handle, int *nObjects, SE_ScenarioObjectState* state);
+
+	/**
+	Create an ideal object sensor and attach to specified vehicle, see SE_AddObjectSensor
+	@return Sensor ID (index of sensor within the instance), -1 if unsucessful
+	*/
+	SE_DLL_API int SE_AddObjectSensorInstance(void *handle, int object_id, float x, float y, float z, float h, float rangeNear, float rangeFar, float fovH, int maxObj);
+	SE_DLL_API int SE_FetchSensorObjectListInstance(void *handle, int sensor_id, int *list);
+	SE_DLL_API int SE_SetSensorThreadsInstance(void *handle, int n_threads);
+	SE_DLL_API int SE_SetObjectThreadsInstance(void *handle, int n_threads);
+	SE_DLL_API int SE_GetRoadInfoAtDistanceInstance(void *handle, int object_id, float lookahead_distance, SE_RoadInfo *data, int lookAheadMode);
+	SE_DLL_API int SE_GetLaneInfoAtDistanceInstance(void *handle, int object_id, float lookahead_distance, SE_LaneInfo *data, int lookAheadMode);
+	SE_DLL_API int SE_GetRoadInfoAlongGhostTrailInstance(void *handle, int object_id, float lookahead_distance, SE_RoadInfo *data, float *speed_ghost);
 	
 #ifdef __cplusplus
 }
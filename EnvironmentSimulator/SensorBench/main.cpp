@@ -0,0 +1,164 @@
+/*
+ * esmini - Environment Simulator Minimalistic
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application measures the object sensor update (ObjectSensor::Update). Objects are spread randomly
+  * over a square area, and sensors of varying range and field of view are attached to some of them. All
+  * sensors are updated a number of frames, first checking all objects, then looking up candidates in a
+  * spatial grid built once per frame, as ScenarioPlayer does. Both must identify the same objects, in the
+  * same order and at the same positions. Returns 0 if the results are equal.
+  */
+
+#include <vector>
+#include "IdealSensor.hpp"
+#include "CommonMini.hpp"
+
+using namespace scenarioengine;
+
+#define DEFAULT_N_SENSORS 100
+#define DEFAULT_N_OBJECTS 5000
+#define DEFAULT_AREA_SIZE 2000.0  // m
+#define DEFAULT_N_FRAMES 50
+#define MAX_HITS 1000  // per sensor
+
+typedef struct
+{
+	long long n_hits;
+	double checksum;
+	__int64 time;  // ms
+} Result;
+
+static void Run(std::vector<ObjectSensor*> &sensors, Entities *entities, ObjectGrid *grid, int n_frames, Result &result)
+{
+	__int64 start_time = SE_getSystemTime();
+
+	result.n_hits = 0;
+	result.checksum = 0.0;
+
+	for (int i = 0; i < n_frames; i++)
+	{
+		if (grid)
+		{
+			double max_range = 0.0;
+			for (size_t j = 0; j < sensors.size(); j++)
+			{
+				max_range = MAX(max_range, sensors[j]->far_);
+			}
+			grid->Build(entities, max_range);
+		}
+
+		for (size_t j = 0; j < sensors.size(); j++)
+		{
+			sensors[j]->Update(grid);
+			result.n_hits += sensors[j]->nObj_;
+
+			// Weight by position in hit list, to catch differences in order
+			for (int k = 0; k < sensors[j]->nObj_; k++)
+			{
+				ObjectSensor::ObjectHit &hit = sensors[j]->hitList_[k];
+				result.checksum += (k + 1) * (hit.obj_->id_ + hit.x_ + 2 * hit.y_);
+			}
+		}
+	}
+
+	result.time = SE_getSystemTime() - start_time;
+}
+
+int main(int argc, char *argv[])
+{
+	SE_Options opt;
+	std::string arg_str;
+	int n_sensors = DEFAULT_N_SENSORS;
+	int n_objects = DEFAULT_N_OBJECTS;
+	double area_size = DEFAULT_AREA_SIZE;
+	int n_frames = DEFAULT_N_FRAMES;
+	Entities entities;
+	std::vector<ObjectSensor*> sensors;
+	ObjectGrid grid;
+	Result all_result;
+	Result grid_result;
+	SE_Random rand;
+
+	// use common options parser to manage the program arguments
+	opt.AddOption("sensors", "Number of sensors (default = 100)", "number");
+	opt.AddOption("objects", "Number of objects (default = 5000)", "number");
+	opt.AddOption("area", "Side length of the square area of objects (default = 2000)", "size");
+	opt.AddOption("frames", "Number of frames, i.e. updates per sensor (default = 50)", "number");
+
+	opt.ParseArgs(&argc, argv);
+
+	if (argc > 1)
+	{
+		opt.PrintArgs(argc, argv, "Unrecognized arguments:");
+		opt.PrintUsage();
+		return -1;
+	}
+
+	if ((arg_str = opt.GetOptionArg("sensors")) != "")
+	{
+		n_sensors = MAX(1, atoi(arg_str.c_str()));
+	}
+	if ((arg_str = opt.GetOptionArg("objects")) != "")
+	{
+		n_objects = MAX(1, atoi(arg_str.c_str()));
+	}
+	if ((arg_str = opt.GetOptionArg("area")) != "")
+	{
+		area_size = atof(arg_str.c_str());
+	}
+	if ((arg_str = opt.GetOptionArg("frames")) != "")
+	{
+		n_frames = MAX(1, atoi(arg_str.c_str()));
+	}
+
+	rand.Seed(0, 0);
+
+	for (int i = 0; i < n_objects; i++)
+	{
+		Vehicle *vehicle = new Vehicle();
+		vehicle->id_ = i;
+		vehicle->pos_.SetInertiaPos(area_size * rand.GetReal(), area_size * rand.GetReal(), 0, 2 * M_PI * rand.GetReal(), 0, 0, false);
+		entities.object_.push_back(vehicle);
+	}
+
+	// Front, side and rear sensors of 50 to 125 m range and 30 to 90 deg field of view
+	for (int i = 0; i < n_sensors; i++)
+	{
+		Object *host = entities.object_[rand.GetInt(n_objects)];
+		double heading = (i % 3) * M_PI / 2;
+		double far = 50 + (i % 4) * 25;
+		double fov = (30 + (i % 3) * 30) * M_PI / 180;
+
+		sensors.push_back(new ObjectSensor(&entities, host, 2.0, 0.0, 0.5, heading, 1.0, far, fov, MAX_HITS));
+	}
+
+	Run(sensors, &entities, 0, n_frames, all_result);
+	Run(sensors, &entities, &grid, n_frames, grid_result);
+
+	bool equal = all_result.n_hits == grid_result.n_hits && all_result.checksum == grid_result.checksum;
+
+	printf("%d sensors, %d objects in %.0f x %.0f m, %d frames, %.1f objects identified per sensor update\n", n_sensors, n_objects,
+		area_size, area_size, n_frames, (double)all_result.n_hits / ((double)n_sensors * n_frames));
+	printf("All objects: %.3f ms, grid: %.3f ms per frame (%.1fx), %s results\n", (double)all_result.time / n_frames,
+		(double)grid_result.time / n_frames, (double)all_result.time / MAX(grid_result.time, 1), equal ? "equal" : "differing");
+
+	for (size_t i = 0; i < sensors.size(); i++)
+	{
+		delete sensors[i];
+	}
+	for (size_t i = 0; i < entities.object_.size(); i++)
+	{
+		delete entities.object_[i];
+	}
+
+	return equal ? 0 : -1;
+}
@@ -0,0 +1,271 @@
+/*
+ * esmini - Environment Simulator Minimalistic
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application load tests the UDP server receiving states of externally controlled objects (Server.hpp).
+  * A scenario is loaded, all its objects set to be externally controlled, and the server started. A sender
+  * thread sends datagrams over loopback at a high rate, alternating Ego states and states of all objects of
+  * the scenario plus one unknown object, while the main thread steps the scenario in real time, handing
+  * received states to the gateway each step. After sending stops, each object must have the last state sent.
+  * Returns 0 if all have.
+  */
+
+#include <chrono>
+#include <vector>
+#include "Server.hpp"
+#include "CommonMini.hpp"
+
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <Ws2tcpip.h>
+#else
+	#include <sys/socket.h>
+	#include <arpa/inet.h>
+	#include <unistd.h>
+#endif
+
+using namespace scenarioengine;
+
+#define DEFAULT_OSC_FILENAME "../resources/xosc/cut-in.xosc"
+#define DEFAULT_RATE 10000  // datagrams per second
+#define DEFAULT_DURATION 5.0  // s
+#define DEFAULT_TIMESTEP 0.02  // s
+#define SERVER_START_TIME 200  // ms, for the server to bind its socket
+#define SERVER_DRAIN_TIME 200  // ms, for the server to receive remaining datagrams
+#define MOVE_PER_DATAGRAM 1e-4  // m, longitudinal displacement of the objects for each datagram sent
+
+typedef struct
+{
+	std::vector<ObjectStateBuffer_t> start_state;  // per object id
+	double rate;
+	double duration;
+	int n_datagrams;
+	int n_states;
+	std::vector<ObjectStateBuffer_t> last_state;  // last sent per object id
+} SenderData;
+
+static double GetTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Initial state moved along the heading, proportionally to the datagram counter
+static ObjectStateBuffer_t GetState(SenderData *data, int id, int counter)
+{
+	ObjectStateBuffer_t buf = data->start_state[id];
+
+	buf.x += (float)(counter * MOVE_PER_DATAGRAM * cos(buf.h));
+	buf.y += (float)(counter * MOVE_PER_DATAGRAM * sin(buf.h));
+	buf.speed = (float)(counter * MOVE_PER_DATAGRAM * data->rate);
+
+	return buf;
+}
+
+static void Sender(void *args)
+{
+	SenderData *data = (SenderData*)args;
+	int n_objects = (int)data->start_state.size();
+	std::vector<ObjectStateBuffer_t> buf(n_objects + 1);
+
+#ifdef _WIN32
+	WSADATA wsa_data;
+	WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+
+	int sock = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(DEFAULT_INPORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	data->last_state = data->start_state;
+	data->n_datagrams = 0;
+	data->n_states = 0;
+
+	double start_time = GetTime();
+	double time;
+
+	while ((time = GetTime() - start_time) < data->duration)
+	{
+		if (data->n_datagrams >= time * data->rate)
+		{
+			continue;  // ahead of rate
+		}
+
+		if (data->n_datagrams % 2 == 0)
+		{
+			// Ego state, without object id
+			ObjectStateBuffer_t state = GetState(data, 0, data->n_datagrams);
+			sendto(sock, (char*)&state.x, sizeof(EgoStateBuffer_t), 0, (struct sockaddr*)&addr, sizeof(addr));
+			data->last_state[0] = state;
+			data->n_states++;
+		}
+		else
+		{
+			// All objects, and one not in the scenario which is to be skipped
+			for (int i = 0; i < n_objects; i++)
+			{
+				buf[i] = GetState(data, i, data->n_datagrams);
+				data->last_state[i] = buf[i];
+			}
+			buf[n_objects] = buf[0];
+			buf[n_objects].id = n_objects;
+			sendto(sock, (char*)buf.data(), (int)(buf.size() * sizeof(ObjectStateBuffer_t)), 0, (struct sockaddr*)&addr, sizeof(addr));
+			data->n_states += n_objects + 1;
+		}
+		data->n_datagrams++;
+	}
+
+#ifdef _WIN32
+	closesocket(sock);
+	WSACleanup();
+#else
+	close(sock);
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+	SE_Options opt;
+	std::string arg_str;
+	std::string osc_filename = DEFAULT_OSC_FILENAME;
+	double dt = DEFAULT_TIMESTEP;
+	SenderData data;
+	SE_Thread sender;
+	ScenarioEngine *scenarioEngine = 0;
+
+	data.rate = DEFAULT_RATE;
+	data.duration = DEFAULT_DURATION;
+
+	// use common options parser to manage the program arguments
+	opt.AddOption("osc", "OpenSCENARIO file (default = " DEFAULT_OSC_FILENAME ")", "filename");
+	opt.AddOption("rate", "Datagrams sent per second (default = 10000)", "number");
+	opt.AddOption("duration", "Time of sending, in seconds (default = 5)", "time");
+	opt.AddOption("timestep", "Simulation timestep, run in real time (default = 0.02)", "timestep");
+
+	opt.ParseArgs(&argc, argv);
+
+	if (argc > 1)
+	{
+		opt.PrintArgs(argc, argv, "Unrecognized arguments:");
+		opt.PrintUsage();
+		return -1;
+	}
+
+	if ((arg_str = opt.GetOptionArg("osc")) != "")
+	{
+		osc_filename = arg_str;
+	}
+	if ((arg_str = opt.GetOptionArg("rate")) != "")
+	{
+		data.rate = MAX(1.0, atof(arg_str.c_str()));
+	}
+	if ((arg_str = opt.GetOptionArg("duration")) != "")
+	{
+		data.duration = atof(arg_str.c_str());
+	}
+	if ((arg_str = opt.GetOptionArg("timestep")) != "")
+	{
+		dt = MAX(0.001, atof(arg_str.c_str()));
+	}
+
+	try
+	{
+		scenarioEngine = new ScenarioEngine(osc_filename, 0.0);
+	}
+	catch (const std::exception& e)
+	{
+		printf("Failed to load %s: %s\n", osc_filename.c_str(), e.what());
+		return -1;
+	}
+
+	// All objects driven by the received states, as by an external traffic simulator
+	for (size_t i = 0; i < scenarioEngine->entities.object_.size(); i++)
+	{
+		scenarioEngine->entities.object_[i]->control_ = Object::Control::EXTERNAL;
+	}
+
+	scenarioEngine->step(0.0, true);
+
+	for (size_t i = 0; i < scenarioEngine->entities.object_.size(); i++)
+	{
+		roadmanager::Position *pos = &scenarioEngine->entities.object_[i]->pos_;
+		ObjectStateBuffer_t buf = { (int)i, (float)pos->GetX(), (float)pos->GetY(), (float)pos->GetZ(), (float)pos->GetH(), 0, 0, 0, 0 };
+
+		data.start_state.push_back(buf);
+	}
+
+	if (data.start_state.size() == 0)
+	{
+		printf("No objects in %s\n", osc_filename.c_str());
+		delete scenarioEngine;
+		return -1;
+	}
+
+	StartServer(scenarioEngine, 1.0);
+	SE_sleep(SERVER_START_TIME);
+	sender.Start(Sender, &data);
+
+	// Step in real time while sending
+	double start_time = GetTime();
+	double max_report_time = 0.0;
+	int n_steps = 0;
+	int n_reported = 0;
+
+	while (GetTime() - start_time < data.duration)
+	{
+		double report_start_time = GetTime();
+		n_reported += ReportServerStates();
+		max_report_time = MAX(max_report_time, GetTime() - report_start_time);
+
+		scenarioEngine->step(dt);
+		n_steps++;
+
+		double sleep_time = start_time + n_steps * dt - GetTime();
+		if (sleep_time > 0)
+		{
+			SE_sleep((unsigned int)(1000 * sleep_time));
+		}
+	}
+
+	sender.Wait();
+	SE_sleep(SERVER_DRAIN_TIME);
+	ReportServerStates();
+	scenarioEngine->step(dt);
+	StopServer();
+
+	// Objects must have the last state sent
+	int n_failed = 0;
+
+	for (size_t i = 0; i < data.last_state.size(); i++)
+	{
+		Object *obj = scenarioEngine->entities.object_[i];
+
+		if ((float)obj->pos_.GetX() != data.last_state[i].x || (float)obj->pos_.GetY() != data.last_state[i].y ||
+			(float)obj->speed_ != data.last_state[i].speed)
+		{
+			n_failed++;
+		}
+	}
+
+	printf("Sent %d datagrams, %d object states, in %.2f s (%.0f datagrams/s)\n", data.n_datagrams, data.n_states, data.duration,
+		data.n_datagrams / MAX(data.duration, SMALL_NUMBER));
+	printf("%d steps, %.1f states reported per step, max %.1f us per report\n", n_steps, (double)n_reported / MAX(n_steps, 1),
+		1e6 * max_report_time);
+	printf("%d objects of %d with last sent state\n", (int)data.last_state.size() - n_failed, (int)data.last_state.size());
+
+	delete scenarioEngine;
+
+	return n_failed > 0 ? -1 : 0;
+}
@@ -0,0 +1,358 @@
+/*
+ * esmini - Environment Simulator Minimalistic
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+#include <string.h>
+#include <chrono>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#include "SharedState.hpp"
+
+#define SHARED_STATE_ALIGN 64  // keep slots on separate cache lines
+
+static size_t AlignSize(size_t size)
+{
+	return (size + SHARED_STATE_ALIGN - 1) / SHARED_STATE_ALIGN * SHARED_STATE_ALIGN;
+}
+
+static std::string SharedMemoryName(std::string name)
+{
+#ifdef _WIN32
+	return name;
+#else
+	// POSIX shared memory objects are named like a file in the root folder
+	return name[0] == '/' ? name : "/" + name;
+#endif
+}
+
+static void *CreateSharedMemory(std::string name, size_t size, void *&handle)
+{
+	void *ptr = 0;
+
+#ifdef _WIN32
+	handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32),
+		(DWORD)(size & 0xffffffff), name.c_str());
+	if (handle == NULL)
+	{
+		return 0;
+	}
+	ptr = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (ptr == NULL)
+	{
+		CloseHandle(handle);
+		return 0;
+	}
+#else
+	handle = 0;
+	shm_unlink(name.c_str());
+	int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
+	if (fd < 0)
+	{
+		return 0;
+	}
+	if (ftruncate(fd, (off_t)size) != 0 ||
+		(ptr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+	{
+		close(fd);
+		shm_unlink(name.c_str());
+		return 0;
+	}
+	close(fd);
+#endif
+
+	return ptr;
+}
+
+static void *OpenSharedMemory(std::string name, size_t &size, void *&handle)
+{
+	void *ptr = 0;
+
+#ifdef _WIN32
+	handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+	if (handle == NULL)
+	{
+		return 0;
+	}
+	ptr = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+	MEMORY_BASIC_INFORMATION info;
+	if (ptr == NULL || VirtualQuery(ptr, &info, sizeof(info)) == 0)
+	{
+		CloseHandle(handle);
+		return 0;
+	}
+	size = info.RegionSize;
+#else
+	struct stat st;
+	handle = 0;
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0)
+	{
+		return 0;
+	}
+	if (fstat(fd, &st) != 0 || (ptr = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+	{
+		close(fd);
+		return 0;
+	}
+	size = (size_t)st.st_size;
+	close(fd);
+#endif
+
+	return ptr;
+}
+
+static void UnmapSharedMemory(void *ptr, size_t size, void *handle)
+{
+#ifdef _WIN32
+	(void)size;
+	UnmapViewOfFile(ptr);
+	CloseHandle(handle);
+#else
+	(void)handle;
+	munmap(ptr, size);
+#endif
+}
+
+long long SharedStateClock()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// SharedStateWriter
+
+SharedStateWriter::SharedStateWriter() : header_(0), slot_(0), handle_(0), size_(0)
+{
+}
+
+SharedStateWriter::~SharedStateWriter()
+{
+	Close();
+}
+
+int SharedStateWriter::Create(std::string name, int max_objects, int n_slots)
+{
+	Close();
+
+	if (name.empty() || max_objects < 1 || n_slots < 2)
+	{
+		return -1;
+	}
+
+	size_t slot_size = AlignSize(sizeof(SharedStateSlotHeader) + max_objects * sizeof(SharedObjectState));
+
+	name_ = SharedMemoryName(name);
+	size_ = AlignSize(sizeof(SharedStateHeader)) + n_slots * slot_size;
+
+	// New memory is zeroed, i.e. no frames published and all slots even
+	header_ = (SharedStateHeader*)CreateSharedMemory(name_, size_, handle_);
+	if (header_ == 0)
+	{
+		return -1;
+	}
+
+	header_->version = SHARED_STATE_VERSION;
+	header_->max_objects = max_objects;
+	header_->n_slots = n_slots;
+	header_->slot_size = (int)slot_size;
+	header_->n_frames.store(0);
+
+	// Magic last, marks the area as ready for readers
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(header_->magic, SHARED_STATE_MAGIC, sizeof(header_->magic));
+
+	return 0;
+}
+
+void SharedStateWriter::Close()
+{
+	if (header_ == 0)
+	{
+		return;
+	}
+
+	UnmapSharedMemory(header_, size_, handle_);
+#ifndef _WIN32
+	shm_unlink(name_.c_str());
+#endif
+	header_ = 0;
+	slot_ = 0;
+	handle_ = 0;
+}
+
+SharedObjectState *SharedStateWriter::BeginFrame()
+{
+	if (header_ == 0)
+	{
+		return 0;
+	}
+
+	unsigned long long frame_nr = header_->n_frames.load(std::memory_order_relaxed);
+
+	slot_ = (SharedStateSlotHeader*)((char*)header_ + AlignSize(sizeof(SharedStateHeader)) +
+		(frame_nr % header_->n_slots) * header_->slot_size);
+
+	// Odd sequence number tells readers that the slot is being updated
+	slot_->seq.store(slot_->seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	return (SharedObjectState*)(slot_ + 1);
+}
+
+void SharedStateWriter::EndFrame(double time, int n_objects)
+{
+	if (slot_ == 0)
+	{
+		return;
+	}
+
+	unsigned long long frame_nr = header_->n_frames.load(std::memory_order_relaxed);
+
+	slot_->info.frame_nr = frame_nr;
+	slot_->info.time = time;
+	slot_->info.n_objects = n_objects < header_->max_objects ? n_objects : header_->max_objects;
+	slot_->info.publish_time = SharedStateClock();
+
+	slot_->seq.store(slot_->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	header_->n_frames.store(frame_nr + 1, std::memory_order_release);
+
+	slot_ = 0;
+}
+
+// SharedStateReader
+
+SharedStateReader::SharedStateReader() : header_(0), handle_(0), size_(0)
+{
+}
+
+SharedStateReader::~SharedStateReader()
+{
+	Close();
+}
+
+int SharedStateReader::Open(std::string name)
+{
+	Close();
+
+	header_ = (SharedStateHeader*)OpenSharedMemory(SharedMemoryName(name), size_, handle_);
+	if (header_ == 0)
+	{
+		return -1;
+	}
+
+	if (size_ < sizeof(SharedStateHeader) || memcmp(header_->magic, SHARED_STATE_MAGIC, sizeof(header_->magic)) != 0 ||
+		header_->version != SHARED_STATE_VERSION ||
+		size_ < AlignSize(sizeof(SharedStateHeader)) + (size_t)header_->n_slots * header_->slot_size)
+	{
+		// Not (yet) a valid area
+		Close();
+		return -1;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	return 0;
+}
+
+void SharedStateReader::Close()
+{
+	if (header_ == 0)
+	{
+		return;
+	}
+
+	UnmapSharedMemory(header_, size_, handle_);
+	header_ = 0;
+	handle_ = 0;
+}
+
+unsigned long long SharedStateReader::GetNumberOfFrames()
+{
+	return header_ ? header_->n_frames.load(std::memory_order_acquire) : 0;
+}
+
+SharedStateSlotHeader *SharedStateReader::GetSlot(unsigned long long frame_nr)
+{
+	return (SharedStateSlotHeader*)((char*)header_ + AlignSize(sizeof(SharedStateHeader)) +
+		(frame_nr % header_->n_slots) * header_->slot_size);
+}
+
+int SharedStateReader::ReadFrame(unsigned long long frame_nr, SharedFrameInfo &info, SharedObjectState *objects, int max_objects)
+{
+	if (header_ == 0)
+	{
+		return -1;
+	}
+
+	unsigned long long n_frames = header_->n_frames.load(std::memory_order_acquire);
+
+	if (frame_nr >= n_frames)
+	{
+		return 1;
+	}
+	else if (n_frames - frame_nr > (unsigned long long)header_->n_slots)
+	{
+		return -1;
+	}
+
+	SharedStateSlotHeader *slot = GetSlot(frame_nr);
+	unsigned int seq = slot->seq.load(std::memory_order_acquire);
+
+	if (seq & 1)
+	{
+		// Being overwritten by a newer frame
+		return -1;
+	}
+
+	info = slot->info;
+	int n_copy = info.n_objects;
+	n_copy = n_copy < max_objects ? n_copy : max_objects;
+	n_copy = n_copy < header_->max_objects ? n_copy : header_->max_objects;
+	if (n_copy > 0)
+	{
+		memcpy(objects, slot + 1, n_copy * sizeof(SharedObjectState));
+	}
+
+	// Copy is valid only if the writer did not touch the slot meanwhile
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (slot->seq.load(std::memory_order_relaxed) != seq || info.frame_nr != frame_nr)
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+int SharedStateReader::ReadLatest(SharedFrameInfo &info, SharedObjectState *objects, int max_objects)
+{
+	for (;;)
+	{
+		unsigned long long n_frames = GetNumberOfFrames();
+
+		if (n_frames == 0)
+		{
+			return 1;
+		}
+
+		if (ReadFrame(n_frames - 1, info, objects, max_objects) == 0)
+		{
+			return 0;
+		}
+
+		// Writer lapped the ring while copying, try the new latest frame
+	}
+}
@@ -0,0 +1,176 @@
+/*
+ * esmini - Environment Simulator Minimalistic
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * Object states published into a named shared memory area, for consumers running on the same host.
+  *
+  * The area holds a ring of frame slots. Each slot is guarded by a sequence counter (seqlock): the writer
+  * makes it odd before and even after updating the slot. A reader copies the slot and accepts the copy
+  * only if the counter was even and unchanged during the copy. Hence the simulation never waits for
+  * readers, any number of readers can consume frames in parallel, and a reader falling more than a
+  * ring behind will notice that frames were lost.
+  *
+  * This module depends on nothing but the standard library and the OS, so that consumers only need
+  * to include this header and link SharedState.
+  */
+
+#pragma once
+
+#include <string>
+#include <atomic>
+
+#define SHARED_STATE_MAGIC "ESMINISS"
+#define SHARED_STATE_VERSION 1
+#define SHARED_STATE_NAME_SIZE 32
+#define SHARED_STATE_MAX_OBJECTS 256
+#define SHARED_STATE_N_SLOTS 16
+
+typedef struct
+{
+	int id;
+	int model_id;
+	int control;  // 0= undefined, 1=internal, 2=external, 3=hybrid_external, 4=hybrid_ghost
+	char name[SHARED_STATE_NAME_SIZE];
+	double x;
+	double y;
+	double z;
+	float h;
+	float p;
+	float r;
+	int road_id;
+	int lane_id;
+	float lane_offset;
+	double s;
+	float speed;
+	float wheel_angle;
+	float wheel_rot;
+} SharedObjectState;
+
+typedef struct
+{
+	unsigned long long frame_nr;
+	double time;             // simulation time
+	long long publish_time;  // steady clock at publish, in ns, for latency measurements
+	int n_objects;
+} SharedFrameInfo;
+
+typedef struct
+{
+	char magic[8];
+	int version;
+	int max_objects;
+	int n_slots;
+	int slot_size;  // bytes, including slot header
+	std::atomic<unsigned long long> n_frames;  // published frames, the latest in slot (n_frames - 1) % n_slots
+} SharedStateHeader;
+
+typedef struct
+{
+	std::atomic<unsigned int> seq;  // odd while the slot is being written
+	SharedFrameInfo info;
+} SharedStateSlotHeader;  // followed by max_objects SharedObjectState
+
+/**
+Get time of the steady clock, which is shared by all processes on the host
+@return time in ns
+*/
+long long SharedStateClock();
+
+class SharedStateWriter
+{
+public:
+	SharedStateWriter();
+	~SharedStateWriter();
+
+	/**
+	Create the shared memory area, replacing any existing one with the same name
+	@param name Name of the area, identifying it to the readers
+	@param max_objects Capacity, number of objects per frame
+	@param n_slots Number of frames kept, i.e. how far behind readers may fall without losing frames
+	@return 0 if successful, -1 if not
+	*/
+	int Create(std::string name, int max_objects = SHARED_STATE_MAX_OBJECTS, int n_slots = SHARED_STATE_N_SLOTS);
+
+	/**
+	Release the area. Readers already attached keep their mapping until closing.
+	*/
+	void Close();
+
+	bool IsOpen() { return header_ != 0; }
+	int GetMaxObjects() { return header_ ? header_->max_objects : 0; }
+
+	/**
+	Start writing next frame. Fill in the returned array, then call EndFrame.
+	@return Array of GetMaxObjects() object states, 0 if not open
+	*/
+	SharedObjectState *BeginFrame();
+
+	/**
+	Complete and publish the frame started by BeginFrame
+	@param time Simulation time
+	@param n_objects Number of object states filled in
+	*/
+	void EndFrame(double time, int n_objects);
+
+private:
+	SharedStateHeader *header_;
+	SharedStateSlotHeader *slot_;  // current slot, between BeginFrame and EndFrame
+	std::string name_;
+	void *handle_;
+	size_t size_;
+};
+
+class SharedStateReader
+{
+public:
+	SharedStateReader();
+	~SharedStateReader();
+
+	/**
+	Attach to a shared memory area created by a SharedStateWriter
+	@param name Name of the area
+	@return 0 if successful, -1 if not
+	*/
+	int Open(std::string name);
+	void Close();
+
+	bool IsOpen() { return header_ != 0; }
+	int GetMaxObjects() { return header_ ? header_->max_objects : 0; }
+
+	/**
+	Get number of frames published so far. The latest one has frame_nr GetNumberOfFrames() - 1.
+	*/
+	unsigned long long GetNumberOfFrames();
+
+	/**
+	Copy a specific frame. Readers consuming every frame typically call this with an increasing frame_nr.
+	@param frame_nr Number of the frame
+	@param info Receives frame number, time and number of objects
+	@param objects Array receiving the object states
+	@param max_objects Capacity of objects, any states beyond are skipped
+	@return 0 if successful, 1 if the frame is not yet published, -1 if it has been overwritten
+	*/
+	int ReadFrame(unsigned long long frame_nr, SharedFrameInfo &info, SharedObjectState *objects, int max_objects);
+
+	/**
+	Copy the most recently published frame
+	@return 0 if successful, 1 if no frame is published yet
+	*/
+	int ReadLatest(SharedFrameInfo &info, SharedObjectState *objects, int max_objects);
+
+private:
+	SharedStateHeader *header_;
+	void *handle_;
+	size_t size_;
+
+	SharedStateSlotHeader *GetSlot(unsigned long long frame_nr);
+};
@@ -0,0 +1,150 @@
+/*
+ * esmini - Environment Simulator Minimalistic
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application consumes object states published into shared memory by a simulator started with
+  * the --shm option. It reads every frame in order, reporting lost frames and the latency from publish
+  * to read. Also serves as an example of how to use SharedStateReader.
+  */
+
+#include <vector>
+#include <thread>
+
+#include "SharedState.hpp"
+#include "CommonMini.hpp"
+
+#define DEFAULT_TIMEOUT 5.0  // s without new frames before giving up
+
+int main(int argc, char *argv[])
+{
+	SE_Options opt;
+	std::string arg_str;
+	SharedStateReader reader;
+	int max_frames = 0;
+	int sleep_time = 0;
+	bool print = false;
+
+	// use common options parser to manage the program arguments
+	opt.AddOption("shm", "Name of the shared memory area, as given to the simulator", "name");
+	opt.AddOption("frames", "Quit after reading this number of frames (default = 0, until simulator stops)", "number");
+	opt.AddOption("sleep", "Wait between polls for new frames (default = 0, busy poll for lowest latency)", "ms");
+	opt.AddOption("print", "Print object states of each frame");
+
+	if (argc < 2)
+	{
+		opt.PrintUsage();
+		return -1;
+	}
+
+	opt.ParseArgs(&argc, argv);
+
+	if (argc > 1)
+	{
+		opt.PrintArgs(argc, argv, "Unrecognized arguments:");
+		opt.PrintUsage();
+		return -1;
+	}
+
+	if ((arg_str = opt.GetOptionArg("shm")) == "")
+	{
+		printf("Missing shm argument\n");
+		opt.PrintUsage();
+		return -1;
+	}
+
+	if (reader.Open(arg_str) != 0)
+	{
+		printf("Failed to open shared memory %s\n", arg_str.c_str());
+		return -1;
+	}
+
+	if ((arg_str = opt.GetOptionArg("frames")) != "")
+	{
+		max_frames = atoi(arg_str.c_str());
+	}
+
+	if ((arg_str = opt.GetOptionArg("sleep")) != "")
+	{
+		sleep_time = atoi(arg_str.c_str());
+	}
+
+	print = opt.GetOptionSet("print");
+
+	std::vector<SharedObjectState> objects(reader.GetMaxObjects());
+	SharedFrameInfo info;
+	unsigned long long frame_nr = reader.GetNumberOfFrames();  // start from next frame
+	int n_read = 0;
+	int n_lost = 0;
+	long long latency_min = 0;
+	long long latency_max = 0;
+	long long latency_sum = 0;
+	long long last_frame_time = SharedStateClock();
+
+	while (max_frames == 0 || n_read < max_frames)
+	{
+		int ret = reader.ReadFrame(frame_nr, info, objects.data(), (int)objects.size());
+
+		if (ret == 1)
+		{
+			// Not yet published
+			if (SharedStateClock() - last_frame_time > (long long)(DEFAULT_TIMEOUT * 1e9))
+			{
+				break;
+			}
+			if (sleep_time > 0)
+			{
+				SE_sleep(sleep_time);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+			continue;
+		}
+		else if (ret == -1)
+		{
+			// Overwritten before we got to it, catch up with the latest one
+			unsigned long long latest = reader.GetNumberOfFrames() - 1;
+			n_lost += (int)(latest - frame_nr);
+			frame_nr = latest;
+			continue;
+		}
+
+		long long now = SharedStateClock();
+		long long latency = now - info.publish_time;
+
+		latency_min = n_read == 0 ? latency : MIN(latency_min, latency);
+		latency_max = n_read == 0 ? latency : MAX(latency_max, latency);
+		latency_sum += latency;
+		last_frame_time = now;
+		n_read++;
+		frame_nr++;
+
+		if (print)
+		{
+			printf("frame %llu time %.2f objects %d\n", info.frame_nr, info.time, info.n_objects);
+			for (int i = 0; i < MIN(info.n_objects, (int)objects.size()); i++)
+			{
+				printf("  %d %s pos (%.2f, %.2f, %.2f) road %d lane %d s %.2f speed %.2f\n", objects[i].id, objects[i].name,
+					objects[i].x, objects[i].y, objects[i].z, objects[i].road_id, objects[i].lane_id, objects[i].s, objects[i].speed);
+			}
+		}
+	}
+
+	printf("%d frames read, %d lost\n", n_read, n_lost);
+	if (n_read > 0)
+	{
+		printf("latency min %.1f avg %.1f max %.1f us\n", 1e-3 * latency_min, 1e-3 * latency_sum / n_read, 1e-3 * latency_max);
+	}
+
+	return 0;
+}
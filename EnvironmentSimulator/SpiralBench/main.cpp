@@ -0,0 +1,236 @@
+/*
+ * esmini - Environment Simulator Minimalistic
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application checks spiral sample tables (Spiral::CreateSampleTable) against direct evaluation
+  * of the Fresnel integrals. Random spirals, starting or ending at zero curvature or not, forward and
+  * backward, of either curvature sign, are evaluated at equidistant points with and without table. Alternatively the spirals of
+  * an OpenDRIVE file are checked. Max position and heading errors are reported, as well as the time
+  * per evaluation. Returns 0 if the position error stays within SPIRAL_TABLE_MAX_ERROR.
+  */
+
+#include <chrono>
+#include <vector>
+#include "RoadManager.hpp"
+#include "CommonMini.hpp"
+
+using namespace roadmanager;
+
+#define DEFAULT_N_SPIRALS 1000
+#define DEFAULT_N_POINTS 1000  // per spiral
+#define MAX_CURVATURE 0.2  // 1/m
+#define MIN_LENGTH 5.0  // m
+#define MAX_LENGTH 500.0  // m
+#define MAX_HEADING_CHANGE M_PI  // rad, limits length of high curvature spirals
+#define N_TIMED_EVALUATIONS 1000000
+
+typedef struct
+{
+	double pos;  // m
+	double heading;  // rad
+	int spiral_idx;  // spiral of max position error
+} Error;
+
+static double GetTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Compare tabulated evaluation with direct at n_points along the spiral, the table is left in place.
+// Returns number of samples in the table.
+static int Check(Spiral *spiral, int spiral_idx, int n_points, Error &error)
+{
+	std::vector<double> x(n_points + 1);
+	std::vector<double> y(n_points + 1);
+	std::vector<double> h(n_points + 1);
+
+	spiral->ClearSampleTable();
+	for (int i = 0; i <= n_points; i++)
+	{
+		spiral->EvaluateDS(spiral->GetLength() * i / n_points, &x[i], &y[i], &h[i]);
+	}
+
+	int n_samples = spiral->CreateSampleTable(SPIRAL_TABLE_MAX_ERROR);
+	for (int i = 0; i <= n_points; i++)
+	{
+		double xt, yt, ht;
+
+		spiral->EvaluateDS(spiral->GetLength() * i / n_points, &xt, &yt, &ht);
+
+		double pos_error = PointDistance2D(x[i], y[i], xt, yt);
+		if (pos_error > error.pos)
+		{
+			error.pos = pos_error;
+			error.spiral_idx = spiral_idx;
+		}
+		error.heading = MAX(error.heading, fabs(GetAngleDifference(h[i], ht)));
+	}
+
+	return n_samples;
+}
+
+// Time per evaluation at random points of random spirals, in current mode (table or direct)
+static double TimeEvaluation(std::vector<Spiral*> &spirals)
+{
+	SE_Random rand;
+	std::vector<int> spiral_idx(N_TIMED_EVALUATIONS);
+	std::vector<double> ds(N_TIMED_EVALUATIONS);
+	double checksum = 0;
+
+	rand.Seed(1, 0);
+	for (int i = 0; i < N_TIMED_EVALUATIONS; i++)
+	{
+		spiral_idx[i] = rand.GetInt((int)spirals.size());
+		ds[i] = rand.GetReal() * spirals[spiral_idx[i]]->GetLength();
+	}
+
+	double start_time = GetTime();
+	for (int i = 0; i < N_TIMED_EVALUATIONS; i++)
+	{
+		double x, y, h;
+
+		spirals[spiral_idx[i]]->EvaluateDS(ds[i], &x, &y, &h);
+		checksum += x + y + h;
+	}
+	double time = GetTime() - start_time;
+
+	// Use the result, not to have the evaluations optimized away
+	if (checksum == 0)
+	{
+		printf(" ");
+	}
+
+	return time / N_TIMED_EVALUATIONS;
+}
+
+int main(int argc, char *argv[])
+{
+	SE_Options opt;
+	std::string arg_str;
+	int n_spirals = DEFAULT_N_SPIRALS;
+	int n_points = DEFAULT_N_POINTS;
+	std::vector<Spiral*> spirals;
+	std::vector<Spiral*> created_spirals;
+	Error error = { 0.0, 0.0, -1 };
+
+	// use common options parser to manage the program arguments
+	opt.AddOption("odr", "Check the spirals of this OpenDRIVE file instead of random ones", "filename");
+	opt.AddOption("spirals", "Number of random spirals (default = 1000)", "number");
+	opt.AddOption("points", "Number of points checked per spiral (default = 1000)", "number");
+
+	opt.ParseArgs(&argc, argv);
+
+	if (argc > 1)
+	{
+		opt.PrintArgs(argc, argv, "Unrecognized arguments:");
+		opt.PrintUsage();
+		return -1;
+	}
+
+	if ((arg_str = opt.GetOptionArg("spirals")) != "")
+	{
+		n_spirals = MAX(1, atoi(arg_str.c_str()));
+	}
+	if ((arg_str = opt.GetOptionArg("points")) != "")
+	{
+		n_points = MAX(1, atoi(arg_str.c_str()));
+	}
+
+	std::string odr_filename = opt.GetOptionArg("odr");
+	if (odr_filename != "")
+	{
+		if (!Position::LoadOpenDrive(odr_filename.c_str()))
+		{
+			printf("Failed to load %s\n", odr_filename.c_str());
+			return -1;
+		}
+
+		OpenDrive *odr = Position::GetDefaultOpenDrive();
+		for (int i = 0; i < odr->GetNumOfRoads(); i++)
+		{
+			Road *road = odr->GetRoadByIdx(i);
+			for (int j = 0; j < road->GetNumberOfGeometries(); j++)
+			{
+				if (road->GetGeometry(j)->GetType() == Geometry::GeometryType::GEOMETRY_TYPE_SPIRAL)
+				{
+					spirals.push_back((Spiral*)road->GetGeometry(j));
+				}
+			}
+		}
+		printf("Loaded %s, %d spirals\n", odr_filename.c_str(), (int)spirals.size());
+	}
+	else
+	{
+		SE_Random rand;
+
+		rand.Seed(0, 0);
+		for (int i = 0; i < n_spirals; i++)
+		{
+			// Half of the spirals start or end at zero curvature, the standard case. Curvature keeps its
+			// sign along the spiral, since direct evaluation does not support spirals passing zero curvature.
+			double sign = rand.GetReal() < 0.5 ? -1.0 : 1.0;
+			double curv_start = sign * rand.GetReal() * MAX_CURVATURE;
+			double curv_end = sign * rand.GetReal() * MAX_CURVATURE;
+			if (i % 4 == 0)
+			{
+				curv_start = 0.0;
+			}
+			else if (i % 4 == 1)
+			{
+				curv_end = 0.0;
+			}
+
+			double length = MIN_LENGTH + rand.GetReal() * (MAX_LENGTH - MIN_LENGTH);
+			length = MIN(length, MAX(MIN_LENGTH, 2 * MAX_HEADING_CHANGE / MAX(fabs(curv_start + curv_end), SMALL_NUMBER)));
+
+			Spiral *spiral = new Spiral(0.0, 1000 * rand.GetReal(), 1000 * rand.GetReal(), 2 * M_PI * rand.GetReal(), length,
+				curv_start, curv_end);
+			spirals.push_back(spiral);
+			created_spirals.push_back(spiral);
+		}
+		printf("Created %d random spirals\n", (int)spirals.size());
+	}
+
+	if (spirals.size() == 0)
+	{
+		return 0;
+	}
+
+	int n_samples = 0;
+	for (size_t i = 0; i < spirals.size(); i++)
+	{
+		n_samples += Check(spirals[i], (int)i, n_points, error);
+	}
+
+	Spiral *worst = spirals[MAX(0, error.spiral_idx)];
+	printf("%d points per spiral, %d table samples in total\n", n_points, n_samples);
+	printf("Max position error %.3g m (limit %.3g), spiral curvature %.4f -> %.4f length %.2f\n", error.pos, SPIRAL_TABLE_MAX_ERROR,
+		worst->GetCurvStart(), worst->GetCurvEnd(), worst->GetLength());
+	printf("Max heading error %.3g rad\n", error.heading);
+
+	double table_time = TimeEvaluation(spirals);
+	for (size_t i = 0; i < spirals.size(); i++)
+	{
+		spirals[i]->ClearSampleTable();
+	}
+	double direct_time = TimeEvaluation(spirals);
+
+	printf("EvaluateDS: direct %.1f ns, table %.1f ns per call (%.1fx)\n", 1e9 * direct_time, 1e9 * table_time,
+		direct_time / MAX(table_time, SMALL_NUMBER));
+
+	for (size_t i = 0; i < created_spirals.size(); i++)
+	{
+		delete created_spirals[i];
+	}
+
+	return error.pos > SPIRAL_TABLE_MAX_ERROR ? -1 : 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * esmini - Environment Simulator Minimalistic
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application measures the story evaluation of the ScenarioEngine. A scenario of a number of events,
+  * chained by StoryboardElementStateConditions, is generated and written to storybench.xosc. Each event
+  * changes the speed of the single vehicle and is started by completion of the previous one. The events
+  * are optionally split into sequential acts, each started by completion of the previous act, so that
+  * most events are dormant at any time. The scenario is run until the last event completes, visiting the
+  * complete story tree each step, then event driven (ScenarioEngine::SetEventDriven). Time per step and a
+  * checksum of the vehicle states are reported. Returns 0 if both runs end in time with equal checksums.
+  */
+
+#include <fstream>
+#include "ScenarioEngine.hpp"
+#include "CommonMini.hpp"
+
+using namespace scenarioengine;
+
+#define DEFAULT_N_EVENTS 1000
+#define DEFAULT_N_ACTS 1
+#define DEFAULT_TIMESTEP 0.05
+#define DEFAULT_ODR_FILENAME "../resources/xodr/straight_500m.xodr"
+#define EVENT_DURATION 0.2  // s, duration of the speed change of each event
+#define STEPS_PER_EVENT_MAX 10  // to detect a broken chain, e.g. by a missed trigger
+
+typedef struct
+{
+	bool completed;
+	double sim_time;
+	int n_steps;
+	double checksum;
+	double step_time;  // s
+} Result;
+
+// Events are numbered through all acts, the first one of each act starts with the act
+static void WriteEvent(std::ofstream &file, int idx, bool first_in_act)
+{
+	file << "<Event name=\"Event" << idx << "\" priority=\"overwrite\">\n";
+	file << "<Action name=\"Action" << idx << "\"><PrivateAction><LongitudinalAction><SpeedAction>"
+		"<SpeedActionDynamics dynamicsShape=\"linear\" value=\"" << EVENT_DURATION << "\" dynamicsDimension=\"time\"/>"
+		"<SpeedActionTarget><AbsoluteTargetSpeed value=\"" << idx % 3 << "\"/></SpeedActionTarget>"
+		"</SpeedAction></LongitudinalAction></PrivateAction></Action>\n";
+	file << "<StartTrigger><ConditionGroup><Condition name=\"Start" << idx << "\" delay=\"0\" conditionEdge=\"none\"><ByValueCondition>";
+	if (first_in_act)
+	{
+		file << "<SimulationTimeCondition value=\"0\" rule=\"greaterThan\"/>";
+	}
+	else
+	{
+		file << "<StoryboardElementStateCondition storyboardElementType=\"event\" storyboardElementRef=\"Event" << idx - 1 <<
+			"\" state=\"completeState\"/>";
+	}
+	file << "</ByValueCondition></Condition></ConditionGroup></StartTrigger>\n</Event>\n";
+}
+
+static void WriteAct(std::ofstream &file, int idx, int n_events)
+{
+	int first_event = idx * n_events;
+
+	file << "<Act name=\"Act" << idx << "\"><ManeuverGroup maximumExecutionCount=\"1\" name=\"ManeuverGroup" << idx << "\">"
+		"<Actors selectTriggeringEntities=\"false\"><EntityRef entityRef=\"Ego\"/></Actors>\n<Maneuver name=\"Maneuver" << idx << "\">\n";
+	for (int i = first_event; i < first_event + n_events; i++)
+	{
+		WriteEvent(file, i, i == first_event);
+	}
+	file << "</Maneuver></ManeuverGroup>\n";
+	file << "<StartTrigger><ConditionGroup><Condition name=\"ActStart" << idx << "\" delay=\"0\" conditionEdge=\"none\"><ByValueCondition>";
+	if (idx == 0)
+	{
+		file << "<SimulationTimeCondition value=\"0\" rule=\"greaterThan\"/>";
+	}
+	else
+	{
+		file << "<StoryboardElementStateCondition storyboardElementType=\"act\" storyboardElementRef=\"Act" << idx - 1 <<
+			"\" state=\"completeState\"/>";
+	}
+	file << "</ByValueCondition></Condition></ConditionGroup></StartTrigger>\n";
+	file << "<StopTrigger><ConditionGroup><Condition name=\"ActEnd" << idx << "\" delay=\"0\" conditionEdge=\"none\"><ByValueCondition>"
+		"<StoryboardElementStateCondition storyboardElementType=\"event\" storyboardElementRef=\"Event" << first_event + n_events - 1 <<
+		"\" state=\"completeState\"/></ByValueCondition></Condition></ConditionGroup></StopTrigger>\n";
+	file << "</Act>\n";
+}
+
+static void WriteScenario(std::ofstream &file, std::string odr_filename, int n_acts, int n_events)
+{
+	file << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<OpenSCENARIO>\n";
+	file << "<FileHeader revMajor=\"0\" revMinor=\"9\" date=\"2020-01-01T10:00:00\" description=\"storybench\" author=\"esmini\"/>\n";
+	file << "<ParameterDeclarations/>\n";
+	file << "<RoadNetwork><LogicFile filepath=\"" << odr_filename << "\"/></RoadNetwork>\n";
+	file << "<Entities><ScenarioObject name=\"Ego\"><Vehicle name=\"car\" vehicleCategory=\"car\">"
+		"<BoundingBox><Center x=\"1.4\" y=\"0.0\" z=\"0.9\"/><Dimensions width=\"2.0\" length=\"5.0\" height=\"1.8\"/></BoundingBox>"
+		"<Performance maxSpeed=\"69\" maxDeceleration=\"30\"/>"
+		"<Axles><FrontAxle maxSteering=\"30\" wheelDiameter=\"0.8\" trackWidth=\"1.68\" positionX=\"2.98\" positionZ=\"0.4\"/>"
+		"<RearAxle maxSteering=\"30\" wheelDiameter=\"0.8\" trackWidth=\"1.68\" positionX=\"0\" positionZ=\"0.4\"/></Axles>"
+		"<Properties/></Vehicle></ScenarioObject></Entities>\n";
+	file << "<Storyboard>\n<Init><Actions><Private entityRef=\"Ego\"><PrivateAction><TeleportAction><Position>"
+		"<LanePosition roadId=\"1\" laneId=\"-1\" offset=\"0\" s=\"50\"/></Position></TeleportAction></PrivateAction></Private></Actions></Init>\n";
+	file << "<Story name=\"Story\">\n";
+	for (int i = 0; i < n_acts; i++)
+	{
+		WriteAct(file, i, n_events);
+	}
+	file << "</Story>\n";
+	file << "<StopTrigger><ConditionGroup><Condition name=\"End\" delay=\"0\" conditionEdge=\"none\"><ByValueCondition>"
+		"<StoryboardElementStateCondition storyboardElementType=\"event\" storyboardElementRef=\"Event" << n_acts * n_events - 1 <<
+		"\" state=\"completeState\"/></ByValueCondition></Condition></ConditionGroup></StopTrigger>\n";
+	file << "</Storyboard>\n</OpenSCENARIO>\n";
+}
+
+static int Run(std::string osc_filename, bool event_driven, double dt, double max_time, Result &result)
+{
+	ScenarioEngine *scenarioEngine = 0;
+
+	result.n_steps = 0;
+	result.checksum = 0.0;
+
+	try
+	{
+		scenarioEngine = new ScenarioEngine();
+		scenarioEngine->SetEventDriven(event_driven);
+		scenarioEngine->InitScenario(osc_filename, 0.0);
+
+		scenarioEngine->step(0.0, true);
+
+		__int64 start_time = SE_getSystemTime();
+		while (!scenarioEngine->GetQuitFlag() && scenarioEngine->getSimulationTime() < max_time)
+		{
+			scenarioEngine->step(dt);
+			result.n_steps++;
+
+			Object *obj = scenarioEngine->entities.object_[0];
+			result.checksum += obj->pos_.GetS() + obj->speed_ * result.n_steps;
+		}
+		result.step_time = 1e-3 * (SE_getSystemTime() - start_time) / MAX(result.n_steps, 1);
+	}
+	catch (const std::exception& e)
+	{
+		printf("%s\n", e.what());
+		delete scenarioEngine;
+		return -1;
+	}
+
+	result.completed = scenarioEngine->GetQuitFlag();
+	result.sim_time = scenarioEngine->getSimulationTime();
+
+	delete scenarioEngine;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	SE_Options opt;
+	std::string arg_str;
+	std::string odr_filename = DEFAULT_ODR_FILENAME;
+	std::string osc_filename = "storybench.xosc";
+	int n_events = DEFAULT_N_EVENTS;
+	int n_acts = DEFAULT_N_ACTS;
+	double dt = DEFAULT_TIMESTEP;
+	Result results[2];
+
+	// use common options parser to manage the program arguments
+	opt.AddOption("events", "Number of chained events per act (default = 1000)", "number");
+	opt.AddOption("acts", "Number of sequential acts (default = 1)", "number");
+	opt.AddOption("odr", "OpenDRIVE file, with a road of id 1, relative to current directory (default = " DEFAULT_ODR_FILENAME ")",
+		"filename");
+	opt.AddOption("timestep", "Fixed simulation timestep (default = 0.05)", "timestep");
+
+	opt.ParseArgs(&argc, argv);
+
+	if (argc > 1)
+	{
+		opt.PrintArgs(argc, argv, "Unrecognized arguments:");
+		opt.PrintUsage();
+		return -1;
+	}
+
+	if ((arg_str = opt.GetOptionArg("events")) != "")
+	{
+		n_events = MAX(1, atoi(arg_str.c_str()));
+	}
+	if ((arg_str = opt.GetOptionArg("acts")) != "")
+	{
+		n_acts = MAX(1, atoi(arg_str.c_str()));
+	}
+	if ((arg_str = opt.GetOptionArg("odr")) != "")
+	{
+		odr_filename = arg_str;
+	}
+	if ((arg_str = opt.GetOptionArg("timestep")) != "")
+	{
+		dt = atof(arg_str.c_str());
+	}
+
+	std::ofstream file(osc_filename);
+	WriteScenario(file, odr_filename, n_acts, n_events);
+	file.close();
+
+	int n_total = n_acts * n_events;
+	double max_time = n_total * STEPS_PER_EVENT_MAX * MAX(dt, EVENT_DURATION);
+
+	printf("Generated %s, %d acts of %d events\n", osc_filename.c_str(), n_acts, n_events);
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (Run(osc_filename, i == 1, dt, max_time, results[i]) != 0)
+		{
+			return -1;
+		}
+
+		printf("%-12s %s at %.2f s after %d steps, checksum %.6f, step %.2f us, %.3f us per event\n",
+			i == 1 ? "event driven" : "default", results[i].completed ? "completed" : "timeout", results[i].sim_time,
+			results[i].n_steps, results[i].checksum, 1e6 * results[i].step_time, 1e6 * results[i].step_time / n_total);
+	}
+
+	bool equal = results[0].n_steps == results[1].n_steps && results[0].checksum == results[1].checksum;
+
+	printf("Event driven step %.1fx faster, %s results\n", results[0].step_time / MAX(results[1].step_time, SMALL_NUMBER),
+		equal ? "equal" : "differing");
+
+	return results[0].completed && results[1].completed && equal ? 0 : -1;
+}
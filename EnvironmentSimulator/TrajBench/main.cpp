@@ -0,0 +1,175 @@
+/*
+ * esmini - Environment Simulator Minimalistic
+ * https://github.com/esmini/esmini
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * Copyright (c) partners of Simulation Scenarios
+ * https://sites.google.com/view/simulationscenarios
+ */
+
+ /*
+  * This application measures position lookup along polyline trajectories, as used by FollowTrajectoryAction.
+  * A polyline of a number of vertices, resembling a recorded trajectory, is generated. A position is moved
+  * along it by distance (Position::MoveTrajectoryDS) and by time (Position::SetTrajectoryPosByTime), and
+  * finally set at random distances (Position::SetTrajectoryS). Time per call is reported. Random positions
+  * are compared to a linear search through the vertices. Returns 0 if all positions match.
+  */
+
+#include <chrono>
+#include "RoadManager.hpp"
+#include "CommonMini.hpp"
+
+using namespace roadmanager;
+
+#define DEFAULT_N_VERTICES 50000
+#define VERTEX_TIME_STEP 0.1  // s
+#define MOVE_DIST 1.3  // m, per step along the trajectory, less than the distance between vertices
+#define TIME_STEP 0.037  // s, per step along the trajectory
+#define N_RANDOM_POINTS 100000
+#define MAX_ERROR 1e-9  // m
+
+static double GetTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Interpolate position at distance s, searching all vertices
+static void GetReferencePos(PolyLine *pline, double s, double *x, double *y)
+{
+	size_t i = 0;
+
+	while (i + 1 < pline->vertex_.size() && pline->vertex_[i + 1].s <= s)
+	{
+		i++;
+	}
+
+	PolyLine::Vertex *v0 = &pline->vertex_[i];
+	if (i + 1 == pline->vertex_.size())
+	{
+		*x = v0->x;
+		*y = v0->y;
+		return;
+	}
+
+	PolyLine::Vertex *v1 = &pline->vertex_[i + 1];
+	double dist = v1->s - v0->s;
+	double a = dist > SMALL_NUMBER ? (s - v0->s) / dist : 0.0;
+
+	*x = (1 - a) * v0->x + a * v1->x;
+	*y = (1 - a) * v0->y + a * v1->y;
+}
+
+int main(int argc, char *argv[])
+{
+	SE_Options opt;
+	std::string arg_str;
+	int n_vertices = DEFAULT_N_VERTICES;
+	double checksum = 0.0;
+
+	// use common options parser to manage the program arguments
+	opt.AddOption("vertices", "Number of trajectory vertices (default = 50000)", "number");
+
+	opt.ParseArgs(&argc, argv);
+
+	if (argc > 1)
+	{
+		opt.PrintArgs(argc, argv, "Unrecognized arguments:");
+		opt.PrintUsage();
+		return -1;
+	}
+
+	if ((arg_str = opt.GetOptionArg("vertices")) != "")
+	{
+		n_vertices = MAX(2, atoi(arg_str.c_str()));
+	}
+
+	// Winding trajectory, one vertex per 0.1 s at about 20 m/s
+	PolyLine *pline = new PolyLine();
+	for (int i = 0; i < n_vertices; i++)
+	{
+		Position pos;
+		double time = VERTEX_TIME_STEP * i;
+
+		pos.SetInertiaPos(20 * time, 30 * sin(0.05 * time), 0.01 * time, 0.3 * cos(0.05 * time), 0, 0, false);
+		pline->AddVertex(pos, time);
+	}
+
+	Trajectory trajectory(pline, "trajectory", false);
+	trajectory.Freeze();
+
+	double length = pline->length_;
+	double duration = VERTEX_TIME_STEP * (n_vertices - 1);
+	Position pos;
+
+	printf("Trajectory of %d vertices, length %.1f m, duration %.1f s\n", n_vertices, length, duration);
+
+	// Along the trajectory by distance
+	int n_steps = 0;
+	pos.SetTrajectory(&trajectory);
+	double start_time = GetTime();
+	while (pos.GetTrajectoryS() + MOVE_DIST < length)
+	{
+		pos.MoveTrajectoryDS(MOVE_DIST);
+		checksum += pos.GetX() + pos.GetY();
+		n_steps++;
+	}
+	double move_time = (GetTime() - start_time) / MAX(n_steps, 1);
+
+	// Along the trajectory by time
+	int n_time_steps = 0;
+	start_time = GetTime();
+	for (double time = 0.0; time < duration; time += TIME_STEP)
+	{
+		pos.SetTrajectoryPosByTime(&trajectory, time);
+		checksum += pos.GetX() + pos.GetY();
+		n_time_steps++;
+	}
+	double by_time_time = (GetTime() - start_time) / MAX(n_time_steps, 1);
+
+	// Random distances
+	std::vector<double> random_s(N_RANDOM_POINTS);
+	SE_Random rand;
+
+	rand.Seed(0, 0);
+	for (int i = 0; i < N_RANDOM_POINTS; i++)
+	{
+		random_s[i] = rand.GetReal() * length;
+	}
+
+	start_time = GetTime();
+	for (int i = 0; i < N_RANDOM_POINTS; i++)
+	{
+		pos.SetTrajectoryS(&trajectory, random_s[i]);
+		checksum += pos.GetX() + pos.GetY();
+	}
+	double random_time = (GetTime() - start_time) / N_RANDOM_POINTS;
+
+	printf("MoveTrajectoryDS %.3f us (%d steps), SetTrajectoryPosByTime %.3f us (%d steps), SetTrajectoryS %.3f us (%d random)\n",
+		1e6 * move_time, n_steps, 1e6 * by_time_time, n_time_steps, 1e6 * random_time, N_RANDOM_POINTS);
+	printf("Checksum %.6f\n", checksum);
+
+	// Check random positions, the reference search being slow only a subset
+	int n_checked = MIN(N_RANDOM_POINTS, 1000);
+	int n_diff = 0;
+
+	for (int i = 0; i < n_checked; i++)
+	{
+		double x, y;
+
+		pos.SetTrajectoryS(&trajectory, random_s[i]);
+		GetReferencePos(pline, random_s[i], &x, &y);
+		if (PointDistance2D(x, y, pos.GetX(), pos.GetY()) > MAX_ERROR)
+		{
+			n_diff++;
+		}
+	}
+
+	printf("%d positions of %d differ from linear search\n", n_diff, n_checked);
+
+	delete pline;
+
+	return n_diff > 0 ? -1 : 0;
+}
@@ -979,7 +979,7 @@ bool Viewer::CreateRoadLines(roadmanager::OpenDrive* od, osg::Group* parent)
 {
 	double step_length_target = 1;
 	double z_offset = 0.10;
-	roadmanager::Position* pos = new roadmanager::Position();
+	roadmanager::Position* pos = new roadmanager::Position(od);
 	osg::Vec3 point(0, 0, 0);
 	odrLines_ = new osg::Group;
 